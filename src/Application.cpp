@@ -1,6 +1,15 @@
 #include "Application.hpp"
 #include "filesystem.hpp"
 #include "t64.hpp"
+#include "MortonTree64Builder.hpp"
+#include "SparseTree64.hpp"
+#include "tree64_dag.hpp"
+#include "tree64_hollow.hpp"
+#include "tree64_addressing.hpp"
+#include "tree64_order.hpp"
+#include "tree64_raycast.hpp"
+#include "tree64_leaf_masks.hpp"
+#include "hosek_wilkie_sky.hpp"
 #include "math.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
@@ -9,19 +18,30 @@
 #include <glm/gtx/component_wise.hpp>
 #include <imgui.h>
 #include <misc/cpp/imgui_stdlib.h>
-#include <ArHosekSkyModel.h>
 
 #include <iostream>
 #include <set>
+#include <array>
+#include <algorithm>
 #include <limits>
+#include <cstddef>
 #include <functional>
 #include <optional>
 #include <span>
 #include <filesystem>
 #include <chrono>
+#include <stdexcept>
 
 namespace vp {
 
+[[nodiscard]] static std::filesystem::path get_spirv_shader_path(std::string shader) {
+    return path_from(SPIRV_SHADERS_DIRECTORY "/" + std::move(shader));
+}
+
+[[nodiscard]] static std::filesystem::path get_asset_path(std::string asset) {
+    return path_from(ASSETS_DIRECTORY "/" + std::move(asset));
+}
+
 #pragma pack(push, 1)
 struct PushConstants {
     GpuBeamOptimBuffer beam_optim_buffer;
@@ -30,14 +50,38 @@ struct PushConstants {
     glm::vec3 to_sun_direction;
     glm::vec2 half_attachment_dimensions;
     vk::DeviceAddress hosek_wilkie_sky_rendering_parameters_device_address;
-    GpuTree64 tree64;
+    vk::DeviceAddress tree64_device_address;
 };
+#pragma pack(pop)
 
-struct HosekWilkieSkyRenderingParameters {
-    std::array<glm::vec3, 9u> config;
-    glm::vec3 luminance;
+static constexpr auto RAYTRACING_SPECIALIZATION_MAP_ENTRIES = std::array{
+    vk::SpecializationMapEntry{
+        .constantID = 0u,
+        .offset = offsetof(RaytracingSpecializationConstants, uses_relative_tree64_addressing),
+        .size = sizeof(vk::Bool32),
+    }, vk::SpecializationMapEntry{
+        .constantID = 1u,
+        .offset = offsetof(RaytracingSpecializationConstants, tree64_node_layout),
+        .size = sizeof(uint32_t),
+    }, vk::SpecializationMapEntry{
+        .constantID = 2u,
+        .offset = offsetof(RaytracingSpecializationConstants, inlines_tree64_leaf_masks),
+        .size = sizeof(vk::Bool32),
+    }, vk::SpecializationMapEntry{
+        .constantID = 3u,
+        .offset = offsetof(RaytracingSpecializationConstants, tree64_leaf_mask_index_bit_count),
+        .size = sizeof(uint32_t),
+    }, vk::SpecializationMapEntry{
+        .constantID = 4u,
+        .offset = offsetof(RaytracingSpecializationConstants, tree64_depth),
+        .size = sizeof(uint32_t),
+    },
 };
-#pragma pack(pop)
+
+static constexpr auto TREE64_NODE_LAYOUT_NAMES = std::array{ "Packed 12 bytes", "Aligned 16 bytes", "Split arrays" };
+static_assert(std::size(TREE64_NODE_LAYOUT_NAMES) == TREE64_NODE_LAYOUT_COUNT);
+static constexpr auto TREE64_NODE_ORDER_NAMES = std::array{ "Depth first", "Breadth first top levels", "van Emde Boas", "Profile guided" };
+static_assert(std::size(TREE64_NODE_ORDER_NAMES) == TREE64_NODE_ORDER_COUNT);
 
 Application::Application() {
     // m_model_path_to_import = get_asset_path("models/sponza.vox");
@@ -58,22 +102,16 @@ Application::~Application() {
     }
 }
 
-static std::optional<ContiguousTree64> model_import(std::filesystem::path const& path, uint32_t const max_side_voxel_count) {
+template<typename Tree64Builder>
+static std::optional<ContiguousTree64> build_model(std::filesystem::path const& path, uint32_t const max_side_voxel_count,
+    VoxelizationSettings const& voxelization_settings) {
 #if 1
-    if (path.extension() == ".t64") {
-        auto contiguous_tree64 = import_t64(path);
-        if (!contiguous_tree64.has_value()) {
-            std::cerr << "Cannot import " << string_from(path) << std::endl;
-            return std::nullopt;
-        }
-        return std::move(contiguous_tree64.value());
-    }
     auto const begin_time = std::chrono::high_resolution_clock::now();
-    auto tree64 = std::optional<Tree64>();
+    auto tree64 = std::optional<Tree64Builder>();
     if (path.extension() == ".vox") {
-        tree64 = Tree64::import_vox(path);
+        tree64 = Tree64Builder::import_vox(path);
     } else {
-        tree64 = Tree64::voxelize_model(path, max_side_voxel_count);
+        tree64 = Tree64Builder::voxelize_model(path, max_side_voxel_count, voxelization_settings);
     }
     if (!tree64.has_value()) {
         std::cerr << "Cannot import " << string_from(path) << std::endl;
@@ -81,7 +119,7 @@ static std::optional<ContiguousTree64> model_import(std::filesystem::path const&
     }
 #else
     auto const begin_time = std::chrono::high_resolution_clock::now();
-    auto tree64 = std::make_optional(Tree64(1u));
+    auto tree64 = std::make_optional(Tree64Builder(1u));
     tree64->add_voxel(glm::uvec3(0u, 0u, 0u));
     tree64->add_voxel(glm::uvec3(1u, 1u, 0u));
     tree64->add_voxel(glm::uvec3(0u, 1u, 1u));
@@ -95,19 +133,98 @@ static std::optional<ContiguousTree64> model_import(std::filesystem::path const&
     auto const import_time = import_done_time - begin_time;
     std::cout << "import time " << std::chrono::duration_cast<std::chrono::duration<float>>(import_time) << std::endl;
 
-    auto const nodes = tree64->build_contiguous_nodes();
+    auto nodes = std::vector<Tree64Node>();
+    try {
+        nodes = tree64->build_contiguous_nodes();
+    } catch (std::length_error const& e) {
+        std::cerr << "Cannot build " << string_from(path) << " : " << e.what() << std::endl;
+        return std::nullopt;
+    }
 
     auto const build_contiguous_time = std::chrono::high_resolution_clock::now() - import_done_time;
     auto const full_time = std::chrono::high_resolution_clock::now() - begin_time;
     std::cout << "build contiguous time "
         << std::chrono::duration_cast<std::chrono::duration<float>>(build_contiguous_time) << std::endl;
     std::cout << "full time " << std::chrono::duration_cast<std::chrono::duration<float>>(full_time) << std::endl;
+    std::cout << "peak building memory " << tree64->peak_building_memory_size() / (1u << 20u) << " MiB" << std::endl;
     std::cout << "node count " << nodes.size() << std::endl;
-    return ContiguousTree64{ .depth = tree64->depth(), .nodes = nodes };
+    return ContiguousTree64{ .depth = tree64->depth(), .nodes = std::move(nodes) };
+}
+
+static std::optional<ContiguousTree64> model_import(std::filesystem::path const& path, ModelImportSettings const& settings) {
+    auto contiguous_tree64 = std::optional<ContiguousTree64>();
+    if (path.extension() == ".t64") {
+        contiguous_tree64 = import_t64(path);
+        if (!contiguous_tree64.has_value()) {
+            std::cerr << "Cannot import " << string_from(path) << std::endl;
+            return std::nullopt;
+        }
+        if (!use_absolute_addressing(contiguous_tree64.value())) {
+            std::cout << "relative addressing kept for " << std::size(contiguous_tree64->nodes) << " nodes" << std::endl;
+        }
+    } else {
+        switch (settings.building_backend) {
+        case Tree64BuildingBackend::Morton:
+            contiguous_tree64 = build_model<MortonTree64Builder>(path, settings.max_side_voxel_count,
+                settings.voxelization_settings);
+            break;
+        case Tree64BuildingBackend::Pointer:
+            contiguous_tree64 = build_model<Tree64>(path, settings.max_side_voxel_count,
+                settings.voxelization_settings);
+            break;
+        case Tree64BuildingBackend::Sparse:
+            contiguous_tree64 = build_model<SparseTree64>(path, settings.max_side_voxel_count,
+                settings.voxelization_settings);
+            break;
+        }
+        if (!contiguous_tree64.has_value()) {
+            return std::nullopt;
+        }
+    }
+    if (settings.hollows_hidden_voxels) {
+        auto const node_count = std::size(contiguous_tree64->nodes);
+        auto const begin_time = std::chrono::high_resolution_clock::now();
+        if (hollow_hidden_voxels(contiguous_tree64.value())) {
+            auto const hollowing_time = std::chrono::high_resolution_clock::now() - begin_time;
+            std::cout << "hollow hidden voxels time "
+                << std::chrono::duration_cast<std::chrono::duration<float>>(hollowing_time) << std::endl;
+            std::cout << "hollowed node count " << std::size(contiguous_tree64->nodes) << " instead of " << node_count << " ("
+                << std::size(contiguous_tree64->nodes) * sizeof(Tree64Node) / (1u << 20u) << " MiB of VRAM instead of "
+                << node_count * sizeof(Tree64Node) / (1u << 20u) << " MiB)" << std::endl;
+        } else {
+            std::cout << "hidden voxels not hollowed with the relative addressing, inlined leaf masks or a DAG" << std::endl;
+        }
+    }
+    if (settings.deduplicates_subtrees && contiguous_tree64->addressing == Tree64NodeAddressing::Absolute) {
+        auto const begin_time = std::chrono::high_resolution_clock::now();
+        auto dag_nodes = deduplicate_subtrees(contiguous_tree64->nodes);
+        auto const deduplication_time = std::chrono::high_resolution_clock::now() - begin_time;
+        std::cout << "deduplicate subtrees time "
+            << std::chrono::duration_cast<std::chrono::duration<float>>(deduplication_time) << std::endl;
+        std::cout << "DAG node count " << dag_nodes.size() << " instead of " << contiguous_tree64->nodes.size()
+            << " (" << dag_nodes.size() * sizeof(Tree64Node) / (1u << 20u) << " MiB of VRAM instead of "
+            << contiguous_tree64->nodes.size() * sizeof(Tree64Node) / (1u << 20u) << " MiB)" << std::endl;
+        contiguous_tree64->nodes = std::move(dag_nodes);
+    }
+    if (settings.inlines_leaf_masks) {
+        auto const node_count = std::size(contiguous_tree64->nodes);
+        if (inline_leaf_masks(contiguous_tree64.value())) {
+            std::cout << "inlined leaf masks " << std::size(contiguous_tree64->nodes) << " nodes and "
+                << std::size(contiguous_tree64->leaf_masks) << " leaf masks instead of " << node_count << " nodes ("
+                << (std::size(contiguous_tree64->nodes) * sizeof(Tree64Node) + std::size(contiguous_tree64->leaf_masks) * sizeof(uint64_t)) / (1u << 20u)
+                << " MiB of VRAM instead of " << node_count * sizeof(Tree64Node) / (1u << 20u) << " MiB)" << std::endl;
+        } else {
+            std::cout << "leaf masks not inlined with the relative addressing" << std::endl;
+        }
+    }
+    return contiguous_tree64;
 }
 
 void Application::start_model_import() {
-    m_model_import_future = std::async(model_import, m_model_path_to_import, m_max_side_voxel_count_to_import);
+    m_imports_dag = m_model_import_settings.deduplicates_subtrees;
+    m_imports_hollowed = m_model_import_settings.hollows_hidden_voxels;
+    m_imports_leaf_mask_dictionary = m_model_import_settings.inlines_leaf_masks && m_model_import_settings.uses_leaf_mask_dictionary;
+    m_model_import_future = std::async(model_import, m_model_path_to_import, m_model_import_settings);
 }
 
 void Application::run() {
@@ -175,10 +292,16 @@ void Application::init_vulkan() {
 
     create_command_pool();
     create_command_buffers();
+    create_timestamp_query_pool();
 
     create_sync_objects();
 
     create_hosek_wilkie_sky_rendering_parameters_buffer();
+    m_gpu_tree64_buffer = VmaRaiiBuffer(m_vk_ctx.allocator, sizeof(GpuTree64),
+        vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress, 0u, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+    m_gpu_tree64_device_address = m_vk_ctx.device.getBufferAddress(vk::BufferDeviceAddressInfo{
+        .buffer = m_gpu_tree64_buffer,
+    });
 }
 
 void Application::recreate_swapchain() {
@@ -222,6 +345,13 @@ void Application::create_pipeline_layout() {
 
 void Application::create_graphics_pipeline() {
     auto const shader_module = create_shader_module("raytracing.spv");
+    auto const specialization_constants = raytracing_specialization_constants();
+    auto const specialization_info = vk::SpecializationInfo{
+        .mapEntryCount = static_cast<uint32_t>(std::size(RAYTRACING_SPECIALIZATION_MAP_ENTRIES)),
+        .pMapEntries = std::data(RAYTRACING_SPECIALIZATION_MAP_ENTRIES),
+        .dataSize = sizeof(specialization_constants),
+        .pData = &specialization_constants,
+    };
     auto const shader_stages = std::array{
         vk::PipelineShaderStageCreateInfo{
             .stage = vk::ShaderStageFlagBits::eVertex,
@@ -231,6 +361,7 @@ void Application::create_graphics_pipeline() {
             .stage = vk::ShaderStageFlagBits::eFragment,
             .module = shader_module,
             .pName = "main",
+            .pSpecializationInfo = &specialization_info,
         },
     };
 
@@ -310,16 +441,34 @@ vk::PipelineRenderingCreateInfo Application::pipeline_rendering_create_info() co
 
 void Application::create_compute_pipeline() {
     auto const shader_module = create_shader_module("raytracing.spv");
+    auto const specialization_constants = raytracing_specialization_constants();
+    auto const specialization_info = vk::SpecializationInfo{
+        .mapEntryCount = static_cast<uint32_t>(std::size(RAYTRACING_SPECIALIZATION_MAP_ENTRIES)),
+        .pMapEntries = std::data(RAYTRACING_SPECIALIZATION_MAP_ENTRIES),
+        .dataSize = sizeof(specialization_constants),
+        .pData = &specialization_constants,
+    };
     m_compute_pipeline = vk::raii::Pipeline(m_vk_ctx.device, nullptr, vk::ComputePipelineCreateInfo{
         .stage = vk::PipelineShaderStageCreateInfo{
             .stage = vk::ShaderStageFlagBits::eCompute,
             .module = shader_module,
             .pName = "main",
+            .pSpecializationInfo = &specialization_info,
         },
         .layout = m_pipeline_layout,
     });
 }
 
+RaytracingSpecializationConstants Application::raytracing_specialization_constants() const {
+    return RaytracingSpecializationConstants{
+        .uses_relative_tree64_addressing = m_tree64_addressing == Tree64NodeAddressing::Relative,
+        .tree64_node_layout = static_cast<uint32_t>(m_tree64_node_layout),
+        .inlines_tree64_leaf_masks = m_inlines_tree64_leaf_masks,
+        .tree64_leaf_mask_index_bit_count = m_tree64_leaf_mask_index_bit_count,
+        .tree64_depth = m_specializes_tree64_depth ? m_gpu_tree64.depth : 0u,
+    };
+}
+
 vk::raii::ShaderModule Application::create_shader_module(std::string shader) const {
     auto const spirv_path = get_spirv_shader_path(std::move(shader));
     auto const code = read_binary_file(spirv_path);
@@ -425,10 +574,26 @@ void Application::update_gui() {
 
     if (m_model_path_to_import.extension() != ".t64" && m_model_path_to_import.extension() != ".vox") {
         auto const min = 4u;
-        auto const max = 4096u;
+        auto const max = 1u << (Tree64::MAX_DEPTH * 2u);
         ImGui::DragScalar("Max side voxel count", ImGuiDataType_U32,
-            &m_max_side_voxel_count_to_import, 1.f, &min, &max);
+            &m_model_import_settings.max_side_voxel_count, 1.f, &min, &max);
+        ImGui::Checkbox("Voxelize instanced meshes once", &m_model_import_settings.voxelization_settings.instances_meshes);
+        ImGui::Checkbox("Fill closed surfaces", &m_model_import_settings.voxelization_settings.fills_interiors);
+    }
+    if (m_model_path_to_import.extension() != ".t64") {
+        auto const building_backend_names = std::array{ "Morton sorted", "Pointer tree", "Sparse hash table" };
+        auto building_backend_index = static_cast<int>(m_model_import_settings.building_backend);
+        if (ImGui::Combo("Building backend", &building_backend_index, std::data(building_backend_names),
+            static_cast<int>(std::size(building_backend_names)))) {
+            m_model_import_settings.building_backend = static_cast<Tree64BuildingBackend>(building_backend_index);
+        }
     }
+    ImGui::Checkbox("Hollow the voxels hidden by their neighbors", &m_model_import_settings.hollows_hidden_voxels);
+    ImGui::Checkbox("Deduplicate identical subtrees (DAG)", &m_model_import_settings.deduplicates_subtrees);
+    ImGui::Checkbox("Inline leaf masks in their parents", &m_model_import_settings.inlines_leaf_masks);
+    ImGui::BeginDisabled(!m_model_import_settings.inlines_leaf_masks);
+    ImGui::Checkbox("Index the inlined leaf masks in a dictionary", &m_model_import_settings.uses_leaf_mask_dictionary);
+    ImGui::EndDisabled();
 
     if (m_model_import_future.valid()) {
 #ifndef NDEBUG
@@ -445,6 +610,85 @@ void Application::update_gui() {
             save_acceleration_structure(path.value());
         }
     }
+    if (m_gpu_tree64.nodes_device_address != 0u) {
+        ImGui::SeparatorText("Node layout");
+        auto node_layout_index = static_cast<int>(m_tree64_node_layout);
+        ImGui::BeginDisabled(m_tree64_node_layout_benchmark.has_value());
+        if (ImGui::Combo("Node layout", &node_layout_index, std::data(TREE64_NODE_LAYOUT_NAMES),
+            static_cast<int>(std::size(TREE64_NODE_LAYOUT_NAMES)))) {
+            set_tree64_node_layout(static_cast<Tree64NodeLayout>(node_layout_index));
+        }
+        auto specializes_depth = m_specializes_tree64_depth;
+        if (ImGui::Checkbox("Specialize the pipelines on the depth", &specializes_depth)) {
+            set_specializes_tree64_depth(specializes_depth);
+        }
+        ImGui::EndDisabled();
+        if (*m_timestamp_query_pool != nullptr) {
+            ImGui::Text("GPU raytracing time %.3f ms", m_last_frame_gpu_seconds * 1000.);
+            if (m_tree64_node_layout_benchmark.has_value()) {
+                ImGui::Text("Benchmarking %s%s...", TREE64_NODE_LAYOUT_NAMES[static_cast<size_t>(m_tree64_node_layout)],
+                    m_specializes_tree64_depth ? " specialized on the depth" : "");
+            } else if (ImGui::Button("Benchmark node layouts")) {
+                m_tree64_node_layout_rays_per_second = {};
+                m_tree64_node_layout_benchmark = Tree64NodeLayoutBenchmark{
+                    .restored_layout = m_tree64_node_layout,
+                    .restores_depth_specialization = m_specializes_tree64_depth,
+                };
+                set_specializes_tree64_depth(false);
+                set_tree64_node_layout(m_tree64_node_layout_benchmark->benchmarked_layout);
+            }
+            // The shadow rays are not counted
+            for (auto i = 0u; i < TREE64_NODE_LAYOUT_COUNT; ++i) {
+                auto const& rays_per_second = m_tree64_node_layout_rays_per_second[i];
+                if (rays_per_second[1] > 0.) {
+                    ImGui::Text("%s : %.1f Mrays/s, %.1f specialized on depth %u (%+.1f%%)", TREE64_NODE_LAYOUT_NAMES[i],
+                        rays_per_second[0] / 1e6, rays_per_second[1] / 1e6, m_gpu_tree64.depth,
+                        (rays_per_second[1] / rays_per_second[0] - 1.) * 100.);
+                } else if (rays_per_second[0] > 0.) {
+                    ImGui::Text("%s : %.1f Mrays/s", TREE64_NODE_LAYOUT_NAMES[i], rays_per_second[0] / 1e6);
+                }
+            }
+        }
+    }
+    if (m_gpu_tree64.nodes_device_address != 0u && m_tree64_addressing == Tree64NodeAddressing::Absolute) {
+        ImGui::SeparatorText("Node order");
+        auto node_order_index = static_cast<int>(m_tree64_node_order);
+        if (ImGui::Combo("Node order", &node_order_index, std::data(TREE64_NODE_ORDER_NAMES),
+            static_cast<int>(std::size(TREE64_NODE_ORDER_NAMES)))) {
+            m_tree64_node_order = static_cast<Tree64NodeOrder>(node_order_index);
+        }
+        if (ImGui::Button("Record node visits from the camera")) {
+            record_tree64_node_visits();
+        }
+        ImGui::SameLine();
+        ImGui::Text("%zu rays recorded", m_tree64_node_visits_ray_count);
+        ImGui::BeginDisabled(m_tree64_node_order == Tree64NodeOrder::ProfileGuided && m_tree64_node_visits_ray_count == 0u);
+        if (ImGui::Button("Reorder nodes")) {
+            reorder_tree64_nodes();
+        }
+        ImGui::EndDisabled();
+    }
+    if (m_tree64_editor.has_value()) {
+        ImGui::SeparatorText("Editing");
+        auto const min = 0u;
+        auto const max = (1u << (m_tree64_editor->contiguous_tree64().depth * 2u)) - 1u;
+        ImGui::DragScalarN("Box min", ImGuiDataType_U32, glm::value_ptr(m_edit_box_min), 3, 1.f, &min, &max);
+        ImGui::DragScalarN("Box max", ImGuiDataType_U32, glm::value_ptr(m_edit_box_max), 3, 1.f, &min, &max);
+        auto const fills_box = ImGui::Button("Fill box");
+        ImGui::SameLine();
+        auto const clears_box = ImGui::Button("Clear box");
+        if (fills_box || clears_box) {
+            auto const begin_time = std::chrono::high_resolution_clock::now();
+            try {
+                m_tree64_editor->fill_box(m_edit_box_min, m_edit_box_max, fills_box);
+            } catch (std::length_error const& e) {
+                std::cerr << "Cannot edit the tree : " << e.what() << std::endl;
+            }
+            m_last_tree64_edit_time = std::chrono::high_resolution_clock::now() - begin_time;
+        }
+        ImGui::Text("Last edit time %.3f ms, %zu unused nodes", m_last_tree64_edit_time.count() * 1000.f,
+            m_tree64_editor->unused_node_count());
+    }
     ImGui::SeparatorText("Sky");
     auto sky_changed = false;
     sky_changed |= ImGui::SliderAngle("Sun elevation", &m_sun_elevation, 0.f, 90.f);
@@ -462,15 +706,48 @@ void Application::update_tree64_buffer() {
         && m_model_import_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
         auto contiguous_tree64 = m_model_import_future.get();
         if (contiguous_tree64.has_value()) {
+            auto const specialized_depth_changes = m_specializes_tree64_depth && contiguous_tree64->depth != m_gpu_tree64.depth;
             m_gpu_tree64.depth = contiguous_tree64->depth;
-            create_tree64_buffer(contiguous_tree64->nodes);
+            m_tree64_editor.reset();
+            m_tree64_node_layout_benchmark.reset();
+            m_tree64_node_layout_rays_per_second = {};
+            m_tree64_node_visit_counts = std::vector<uint32_t>();
+            m_tree64_node_visits_ray_count = 0u;
+            auto const inlines_leaf_masks = !std::empty(contiguous_tree64->leaf_masks);
+            if (contiguous_tree64->addressing != m_tree64_addressing || inlines_leaf_masks != m_inlines_tree64_leaf_masks
+                || specialized_depth_changes) {
+                m_tree64_addressing = contiguous_tree64->addressing;
+                m_inlines_tree64_leaf_masks = inlines_leaf_masks;
+                m_vk_ctx.device.waitIdle();
+                create_graphics_pipeline();
+                create_compute_pipeline();
+            }
+            create_tree64_far_offsets_buffer(contiguous_tree64->far_offsets);
+            create_tree64_leaf_masks_buffer(contiguous_tree64->leaf_masks);
+            // A DAG saved to .t64 and imported again shares its subtrees without the deduplication option. A hollowed
+            // tree is not edited either, carving it would open the removed voxels to the rays.
+            if (m_imports_dag || m_imports_hollowed || contiguous_tree64->addressing != Tree64NodeAddressing::Absolute || inlines_leaf_masks
+                || shares_subtrees(contiguous_tree64->nodes)) {
+                create_tree64_buffer(contiguous_tree64->nodes, std::size(contiguous_tree64->nodes));
+            } else {
+                m_tree64_editor.emplace(std::move(contiguous_tree64.value()));
+                auto const& nodes = m_tree64_editor->contiguous_tree64().nodes;
+                // Room for the sibling groups appended by the edits
+                create_tree64_buffer(nodes, std::size(nodes) + std::size(nodes) / 8u);
+            }
         }
+    } else if (m_tree64_editor.has_value() && std::size(m_tree64_editor->contiguous_tree64().nodes) > m_tree64_node_capacity) {
+        // The edits outgrew the buffer, it is uploaded again with everything
+        static_cast<void>(m_tree64_editor->take_changed_node_ranges());
+        auto const& nodes = m_tree64_editor->contiguous_tree64().nodes;
+        create_tree64_buffer(nodes, std::size(nodes) + std::size(nodes) / 8u);
     }
 }
 
 void Application::draw_frame() {
     auto const& in_flight_fence = m_in_flight_fences[m_current_in_flight_frame_index];
     static_cast<void>(m_vk_ctx.device.waitForFences(*in_flight_fence, vk::True, std::numeric_limits<uint64_t>::max()));
+    read_frame_timestamps();
 
     auto const& image_available_semaphore = m_image_available_semaphores[m_current_in_flight_frame_index];
     auto acquired_image_opt = m_swapchain.acquire_next_image(image_available_semaphore);
@@ -515,8 +792,20 @@ void Application::draw_frame() {
 void Application::record_frame(vk::CommandBuffer const command_buffer, Swapchain::AcquiredImage const& acquired_image) {
     command_buffer.begin(vk::CommandBufferBeginInfo{ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
 
+    record_tree64_edits_upload(command_buffer);
+
     auto const swapchain_extent = m_swapchain.extent();
     auto const swapchain_dimensions = glm::uvec2(swapchain_extent.width, swapchain_extent.height);
+    auto const first_timestamp_query = 2u * m_current_in_flight_frame_index;
+    auto const writes_timestamps = m_gpu_tree64.depth > 0u && *m_timestamp_query_pool != nullptr;
+    if (writes_timestamps) {
+        command_buffer.resetQueryPool(m_timestamp_query_pool, first_timestamp_query, 2u);
+        command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eNone, m_timestamp_query_pool, first_timestamp_query);
+        // A beam ray per compute invocation and a primary ray per pixel
+        m_frame_ray_counts[m_current_in_flight_frame_index] = static_cast<double>(glm::compMul(m_gpu_beam_optim_buffer.dimensions))
+            + static_cast<double>(glm::compMul(swapchain_dimensions));
+        m_has_written_frame_timestamps[m_current_in_flight_frame_index] = true;
+    }
     if (m_gpu_tree64.depth > 0u) {
         auto const push_constants = PushConstants{
             .beam_optim_buffer = m_gpu_beam_optim_buffer,
@@ -525,7 +814,7 @@ void Application::record_frame(vk::CommandBuffer const command_buffer, Swapchain
             .to_sun_direction = cartesian_direction_from_spherical(m_sun_elevation, m_sun_rotation),
             .half_attachment_dimensions = glm::vec2(swapchain_dimensions) / 2.f,
             .hosek_wilkie_sky_rendering_parameters_device_address = m_hosek_wilkie_sky_rendering_parameters_device_address,
-            .tree64 = m_gpu_tree64,
+            .tree64_device_address = m_gpu_tree64_device_address,
         };
         command_buffer.pushConstants(m_pipeline_layout, vk::ShaderStageFlagBits::eCompute
             | vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
@@ -580,6 +869,9 @@ void Application::record_frame(vk::CommandBuffer const command_buffer, Swapchain
 
         command_buffer.draw(3u, 1u, 0u, 0u);
     }
+    if (writes_timestamps) {
+        command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, m_timestamp_query_pool, first_timestamp_query + 1u);
+    }
 
     m_imgui->render(command_buffer);
 
@@ -590,6 +882,42 @@ void Application::record_frame(vk::CommandBuffer const command_buffer, Swapchain
     command_buffer.end();
 }
 
+// Only the changed node ranges are copied, in the frame command buffer so that the rendering does not stall
+void Application::record_tree64_edits_upload(vk::CommandBuffer const command_buffer) {
+    if (!m_tree64_editor.has_value()) {
+        return;
+    }
+    auto const changed_node_ranges = m_tree64_editor->take_changed_node_ranges();
+    if (std::empty(changed_node_ranges)) {
+        return;
+    }
+    // The previous use of this staging buffer is over, the in flight fence of the frame was waited
+    auto& staging_buffer = m_tree64_edit_staging_buffers[m_current_in_flight_frame_index];
+    auto const copy_regions = stage_tree64_nodes(m_tree64_editor->contiguous_tree64().nodes, changed_node_ranges, staging_buffer);
+
+    // The previous frames may still be reading the nodes
+    auto const before_copy_memory_barrier = vk::MemoryBarrier2{
+        .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eFragmentShader,
+        .dstStageMask = vk::PipelineStageFlagBits2::eCopy,
+        .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+    };
+    command_buffer.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount = 1u,
+        .pMemoryBarriers = &before_copy_memory_barrier,
+    });
+    command_buffer.copyBuffer(staging_buffer, m_tree64_nodes_buffer, copy_regions);
+    auto const after_copy_memory_barrier = vk::MemoryBarrier2{
+        .srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+        .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+        .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eFragmentShader,
+        .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead,
+    };
+    command_buffer.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount = 1u,
+        .pMemoryBarriers = &after_copy_memory_barrier,
+    });
+}
+
 void Application::copy_buffer(vk::Buffer const src, vk::Buffer const dst, vk::DeviceSize size) const {
     one_time_commands(m_vk_ctx.device, m_command_pool, m_vk_ctx.general_queue, [=](vk::CommandBuffer const command_buffer) {
         auto const copy_region = vk::BufferCopy{ .size = size };
@@ -616,46 +944,365 @@ void Application::copy_buffer_to_image(vk::Buffer const src, vk::Image const dst
     });
 }
 
-void Application::create_tree64_buffer(std::span<Tree64Node const> const nodes) {
-    auto const buffer_size = std::size(nodes) * sizeof(nodes[0]);
+void Application::create_timestamp_query_pool() {
+    auto const queue_families_properties = m_vk_ctx.physical_device.getQueueFamilyProperties();
+    if (queue_families_properties[m_vk_ctx.general_queue_family_index].timestampValidBits == 0u) {
+        return;
+    }
+    m_timestamp_period = static_cast<double>(m_vk_ctx.physical_device.getProperties().limits.timestampPeriod);
+    m_timestamp_query_pool = vk::raii::QueryPool(m_vk_ctx.device, vk::QueryPoolCreateInfo{
+        .queryType = vk::QueryType::eTimestamp,
+        .queryCount = 2u * MAX_FRAMES_IN_FLIGHT,
+    });
+}
 
-    auto staging_buffer = VmaRaiiBuffer(m_vk_ctx.allocator, buffer_size, vk::BufferUsageFlagBits::eTransferSrc,
-        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO);
-    staging_buffer.copy_memory_to_allocation(reinterpret_cast<uint8_t const*>(std::data(nodes)), 0u, buffer_size);
+// The in flight fence of the frame was waited, so its timestamps are available
+void Application::read_frame_timestamps() {
+    auto const frame_index = m_current_in_flight_frame_index;
+    if (!m_has_written_frame_timestamps[frame_index]) {
+        return;
+    }
+    m_has_written_frame_timestamps[frame_index] = false;
+    auto const [result, timestamps] = m_timestamp_query_pool.getResults<uint64_t>(2u * frame_index, 2u,
+        2u * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+    if (result != vk::Result::eSuccess || timestamps[1] < timestamps[0]) {
+        return;
+    }
+    m_last_frame_gpu_seconds = static_cast<double>(timestamps[1] - timestamps[0]) * m_timestamp_period * 1e-9;
+    if (m_tree64_node_layout_benchmark.has_value()) {
+        auto& benchmark = m_tree64_node_layout_benchmark.value();
+        benchmark.frame_count += 1u;
+        if (benchmark.frame_count > Tree64NodeLayoutBenchmark::WARM_UP_FRAME_COUNT) {
+            benchmark.gpu_seconds += m_last_frame_gpu_seconds;
+            benchmark.ray_count += m_frame_ray_counts[frame_index];
+        }
+        update_tree64_node_layout_benchmark();
+    }
+}
 
+void Application::update_tree64_node_layout_benchmark() {
+    auto& benchmark = m_tree64_node_layout_benchmark.value();
+    if (benchmark.frame_count < Tree64NodeLayoutBenchmark::WARM_UP_FRAME_COUNT + Tree64NodeLayoutBenchmark::MEASURED_FRAME_COUNT) {
+        return;
+    }
+    auto const layout_index = static_cast<uint32_t>(benchmark.benchmarked_layout);
+    auto const rays_per_second = benchmark.ray_count / benchmark.gpu_seconds;
+    m_tree64_node_layout_rays_per_second[layout_index][benchmark.specializes_depth ? 1u : 0u] = rays_per_second;
+    std::cout << TREE64_NODE_LAYOUT_NAMES[layout_index] << " node layout"
+        << (benchmark.specializes_depth ? " specialized on depth " + std::to_string(m_gpu_tree64.depth) : std::string())
+        << " : " << rays_per_second / 1e6 << " Mrays/s" << std::endl;
+    auto const restored_layout = benchmark.restored_layout;
+    auto const restores_depth_specialization = benchmark.restores_depth_specialization;
+    if (!benchmark.specializes_depth) {
+        benchmark = Tree64NodeLayoutBenchmark{
+            .benchmarked_layout = benchmark.benchmarked_layout,
+            .restored_layout = restored_layout,
+            .specializes_depth = true,
+            .restores_depth_specialization = restores_depth_specialization,
+        };
+        set_specializes_tree64_depth(true);
+        return;
+    }
+    if (layout_index + 1u == TREE64_NODE_LAYOUT_COUNT) {
+        m_tree64_node_layout_benchmark.reset();
+        set_tree64_node_layout(restored_layout);
+        set_specializes_tree64_depth(restores_depth_specialization);
+        return;
+    }
+    benchmark = Tree64NodeLayoutBenchmark{
+        .benchmarked_layout = static_cast<Tree64NodeLayout>(layout_index + 1u),
+        .restored_layout = restored_layout,
+        .restores_depth_specialization = restores_depth_specialization,
+    };
+    set_specializes_tree64_depth(false);
+    set_tree64_node_layout(benchmark.benchmarked_layout);
+}
+
+void Application::create_tree64_buffer(std::span<Tree64Node const> const nodes, size_t const node_capacity) {
     m_vk_ctx.device.waitIdle();
     m_tree64_nodes_buffer.destroy();
-    m_tree64_nodes_buffer = VmaRaiiBuffer(m_vk_ctx.allocator, buffer_size, vk::BufferUsageFlagBits::eTransferDst
-        | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eTransferSrc,
+    m_tree64_nodes_buffer = VmaRaiiBuffer(m_vk_ctx.allocator, node_capacity * laid_out_node_size(m_tree64_node_layout),
+        vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eTransferSrc,
         0u, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
-    copy_buffer(staging_buffer, m_tree64_nodes_buffer, buffer_size);
+    m_tree64_node_capacity = node_capacity;
+    auto staging_buffer = VmaRaiiBuffer(nullptr);
+    auto const node_range = Tree64NodeRange{ .first_node_index = 0u, .node_count = std::size(nodes) };
+    auto const copy_regions = stage_tree64_nodes(nodes, std::span(&node_range, 1u), staging_buffer);
+    one_time_commands(m_vk_ctx.device, m_command_pool, m_vk_ctx.general_queue, [&](vk::CommandBuffer const command_buffer) {
+        command_buffer.copyBuffer(staging_buffer, m_tree64_nodes_buffer, copy_regions);
+    });
 
     m_gpu_tree64.nodes_device_address = m_vk_ctx.device.getBufferAddress(vk::BufferDeviceAddressInfo{
         .buffer = m_tree64_nodes_buffer,
     });
+    m_gpu_tree64.node_indices_device_address = m_tree64_node_layout == Tree64NodeLayout::Split
+        ? m_gpu_tree64.nodes_device_address + node_array_offset(m_tree64_node_layout, 1u, node_capacity) : 0u;
+    update_gpu_tree64_buffer();
 }
 
-void Application::save_acceleration_structure(std::filesystem::path const& path) {
-    auto const buffer_size = m_tree64_nodes_buffer.size();
+// The node ranges are laid out array by array in the staging buffer, the copy regions go to a buffer of m_tree64_node_capacity nodes
+std::vector<vk::BufferCopy> Application::stage_tree64_nodes(std::span<Tree64Node const> const nodes,
+    std::span<Tree64NodeRange const> const node_ranges, VmaRaiiBuffer& staging_buffer) const {
+    auto node_count = size_t{ 0u };
+    for (auto const& node_range : node_ranges) {
+        node_count += node_range.node_count;
+    }
+    auto const strides = node_array_strides(m_tree64_node_layout);
+    auto laid_out_nodes = std::vector<uint8_t>(node_count * laid_out_node_size(m_tree64_node_layout));
+    auto copy_regions = std::vector<vk::BufferCopy>();
+    copy_regions.reserve(std::size(node_ranges) * std::size(strides));
+    auto staging_offset = size_t{ 0u };
+    for (auto array_index = size_t{ 0u }; array_index < std::size(strides); ++array_index) {
+        auto const array_offset = node_array_offset(m_tree64_node_layout, array_index, m_tree64_node_capacity);
+        for (auto const& node_range : node_ranges) {
+            auto const size = node_range.node_count * strides[array_index];
+            lay_out_nodes(nodes.subspan(node_range.first_node_index, node_range.node_count), m_tree64_node_layout, array_index,
+                std::span(laid_out_nodes).subspan(staging_offset, size));
+            copy_regions.emplace_back(vk::BufferCopy{
+                .srcOffset = staging_offset,
+                .dstOffset = array_offset + node_range.first_node_index * strides[array_index],
+                .size = size,
+            });
+            staging_offset += size;
+        }
+    }
+    staging_buffer = VmaRaiiBuffer(m_vk_ctx.allocator, std::size(laid_out_nodes), vk::BufferUsageFlagBits::eTransferSrc,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO);
+    staging_buffer.copy_memory_to_allocation(std::data(laid_out_nodes), 0u, std::size(laid_out_nodes));
+    return copy_regions;
+}
+
+std::vector<Tree64Node> Application::read_back_tree64_nodes() {
+    auto const buffer_size = m_tree64_node_capacity * laid_out_node_size(m_tree64_node_layout);
     auto dst_buffer = VmaRaiiBuffer(m_vk_ctx.allocator, buffer_size, vk::BufferUsageFlagBits::eTransferDst,
         VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO);
     copy_buffer(m_tree64_nodes_buffer, dst_buffer, buffer_size);
-    auto nodes = std::vector<Tree64Node>(buffer_size / sizeof(Tree64Node));
-    dst_buffer.copy_allocation_to_memory(0u, std::span(reinterpret_cast<uint8_t*>(std::data(nodes)), buffer_size));
-    if (!save_t64(path, ContiguousTree64{ .depth = static_cast<uint8_t>(m_gpu_tree64.depth), .nodes = std::move(nodes) })) {
+    auto laid_out_nodes = std::vector<uint8_t>(buffer_size);
+    dst_buffer.copy_allocation_to_memory(0u, laid_out_nodes);
+    auto nodes = std::vector<Tree64Node>(m_tree64_node_capacity);
+    for (auto array_index = size_t{ 0u }; array_index < std::size(node_array_strides(m_tree64_node_layout)); ++array_index) {
+        gather_laid_out_nodes(std::span(laid_out_nodes).subspan(node_array_offset(m_tree64_node_layout, array_index, m_tree64_node_capacity)),
+            m_tree64_node_layout, array_index, nodes);
+    }
+    return nodes;
+}
+
+// The nodes are uploaded again in the new layout, and the pipelines specialized for it
+void Application::set_tree64_node_layout(Tree64NodeLayout const node_layout) {
+    if (node_layout == m_tree64_node_layout) {
+        return;
+    }
+    auto nodes = std::vector<Tree64Node>();
+    if (!m_tree64_editor.has_value() && m_gpu_tree64.nodes_device_address != 0u) {
+        nodes = read_back_tree64_nodes();
+    }
+    m_tree64_node_layout = node_layout;
+    m_vk_ctx.device.waitIdle();
+    create_graphics_pipeline();
+    create_compute_pipeline();
+    if (m_tree64_editor.has_value()) {
+        // The pending edits are already in the editor nodes
+        static_cast<void>(m_tree64_editor->take_changed_node_ranges());
+        auto const& editor_nodes = m_tree64_editor->contiguous_tree64().nodes;
+        create_tree64_buffer(editor_nodes, std::max(m_tree64_node_capacity, std::size(editor_nodes)));
+    } else if (!std::empty(nodes)) {
+        create_tree64_buffer(nodes, std::size(nodes));
+    }
+}
+
+void Application::set_specializes_tree64_depth(bool const specializes_depth) {
+    if (specializes_depth == m_specializes_tree64_depth) {
+        return;
+    }
+    m_specializes_tree64_depth = specializes_depth;
+    m_vk_ctx.device.waitIdle();
+    create_graphics_pipeline();
+    create_compute_pipeline();
+}
+
+// The tree of the editor, or read back with its leaf masks expanded, as the CPU traversal, the reordering and the
+// saving need the plain nodes
+ContiguousTree64 Application::displayed_contiguous_tree64() {
+    if (m_tree64_editor.has_value()) {
+        return m_tree64_editor->contiguous_tree64();
+    }
+    auto contiguous_tree64 = ContiguousTree64{
+        .depth = static_cast<uint8_t>(m_gpu_tree64.depth),
+        .nodes = read_back_tree64_nodes(),
+        .addressing = m_tree64_addressing,
+        .far_offsets = read_back_tree64_array<uint64_t>(m_tree64_far_offsets_buffer, m_tree64_far_offset_count),
+        .leaf_masks = read_back_tree64_leaf_masks(),
+    };
+    expand_leaf_masks(contiguous_tree64);
+    return contiguous_tree64;
+}
+
+// Traces rays of the current view on the CPU, as the visits of the GPU traversal cannot be counted cheaply
+void Application::record_tree64_node_visits() {
+    auto const begin_time = std::chrono::high_resolution_clock::now();
+    auto const contiguous_tree64 = displayed_contiguous_tree64();
+    if (std::size(m_tree64_node_visit_counts) != std::size(contiguous_tree64.nodes)) {
+        m_tree64_node_visit_counts = std::vector<uint32_t>(std::size(contiguous_tree64.nodes));
+        m_tree64_node_visits_ray_count = 0u;
+    }
+    constexpr auto HALF_VERTICAL_FOV = glm::radians(75.f / 2.f); // This must match the GPU side!
+    constexpr auto NODE_VISITS_RESOLUTION = glm::uvec2(320u, 180u);
+    auto const extent = m_swapchain.extent();
+    auto const aspect_ratio = static_cast<float>(extent.width) / static_cast<float>(extent.height);
+    auto const ray_forward = 1.f / glm::tan(HALF_VERTICAL_FOV);
+    auto rays = std::vector<Tree64Ray>();
+    rays.reserve(glm::compMul(NODE_VISITS_RESOLUTION));
+    for (auto y = 0u; y < NODE_VISITS_RESOLUTION.y; ++y) {
+        for (auto x = 0u; x < NODE_VISITS_RESOLUTION.x; ++x) {
+            auto const ndc = (glm::vec2(x, y) + 0.5f) / glm::vec2(NODE_VISITS_RESOLUTION) * 2.f - 1.f;
+            auto const direction = m_camera.rotation() * glm::vec3(ndc.x * aspect_ratio, -ndc.y, ray_forward);
+            rays.emplace_back(Tree64Ray{ .origin = m_camera.position(), .direction = glm::normalize(direction) });
+        }
+    }
+    static_cast<void>(raycast(contiguous_tree64, rays, 1.e6f, m_tree64_node_visit_counts));
+    m_tree64_node_visits_ray_count += glm::compMul(NODE_VISITS_RESOLUTION);
+    auto const record_time = std::chrono::high_resolution_clock::now() - begin_time;
+    std::cout << "record node visits time " << std::chrono::duration_cast<std::chrono::duration<float>>(record_time) << std::endl;
+}
+
+void Application::reorder_tree64_nodes() {
+    auto const begin_time = std::chrono::high_resolution_clock::now();
+    auto contiguous_tree64 = displayed_contiguous_tree64();
+    if (m_tree64_node_order == Tree64NodeOrder::ProfileGuided
+        && std::size(m_tree64_node_visit_counts) != std::size(contiguous_tree64.nodes)) {
+        std::cerr << "The node visits were recorded before the last edits" << std::endl;
+        return;
+    }
+    contiguous_tree64.nodes = reorder_nodes(contiguous_tree64.nodes, contiguous_tree64.depth, m_tree64_node_order,
+        m_tree64_node_visit_counts);
+    auto const reorder_time = std::chrono::high_resolution_clock::now() - begin_time;
+    std::cout << "reorder nodes time " << std::chrono::duration_cast<std::chrono::duration<float>>(reorder_time) << std::endl;
+    // The visits were counted on the previous indices
+    m_tree64_node_visit_counts = std::vector<uint32_t>();
+    m_tree64_node_visits_ray_count = 0u;
+    if (m_tree64_editor.has_value()) {
+        m_tree64_editor.emplace(std::move(contiguous_tree64));
+        auto const& nodes = m_tree64_editor->contiguous_tree64().nodes;
+        create_tree64_buffer(nodes, std::size(nodes) + std::size(nodes) / 8u);
+        return;
+    }
+    if (m_inlines_tree64_leaf_masks) {
+        static_cast<void>(inline_leaf_masks(contiguous_tree64));
+        create_tree64_leaf_masks_buffer(contiguous_tree64.leaf_masks);
+    }
+    create_tree64_buffer(contiguous_tree64.nodes, std::size(contiguous_tree64.nodes));
+}
+
+// The far offsets and the leaf masks are uploaded the same way
+VmaRaiiBuffer Application::create_tree64_array_buffer(std::span<std::byte const> const data) const {
+    auto const buffer_size = std::size(data);
+    auto staging_buffer = VmaRaiiBuffer(m_vk_ctx.allocator, buffer_size, vk::BufferUsageFlagBits::eTransferSrc,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO);
+    staging_buffer.copy_memory_to_allocation(reinterpret_cast<uint8_t const*>(std::data(data)), 0u, buffer_size);
+    auto buffer = VmaRaiiBuffer(m_vk_ctx.allocator, buffer_size, vk::BufferUsageFlagBits::eTransferDst
+        | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eTransferSrc,
+        0u, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+    copy_buffer(staging_buffer, buffer, buffer_size);
+    return buffer;
+}
+
+void Application::read_back_buffer(vk::Buffer const buffer, std::span<std::byte> const data) const {
+    if (std::empty(data)) {
+        return;
+    }
+    auto dst_buffer = VmaRaiiBuffer(m_vk_ctx.allocator, std::size(data), vk::BufferUsageFlagBits::eTransferDst,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO);
+    copy_buffer(buffer, dst_buffer, std::size(data));
+    dst_buffer.copy_allocation_to_memory(0u, std::span(reinterpret_cast<uint8_t*>(std::data(data)), std::size(data)));
+}
+
+void Application::create_tree64_far_offsets_buffer(std::span<uint64_t const> const far_offsets) {
+    m_vk_ctx.device.waitIdle();
+    m_tree64_far_offsets_buffer.destroy();
+    m_tree64_far_offset_count = std::size(far_offsets);
+    m_gpu_tree64.far_offsets_device_address = 0u;
+    if (std::empty(far_offsets)) {
+        return;
+    }
+    m_tree64_far_offsets_buffer = create_tree64_array_buffer(std::as_bytes(far_offsets));
+    m_gpu_tree64.far_offsets_device_address = m_vk_ctx.device.getBufferAddress(vk::BufferDeviceAddressInfo{
+        .buffer = m_tree64_far_offsets_buffer,
+    });
+}
+
+// With a leaf mask dictionary, the leaf masks buffer holds the packed indices and the pipelines are specialized on their size
+void Application::create_tree64_leaf_masks_buffer(std::span<uint64_t const> const leaf_masks) {
+    m_vk_ctx.device.waitIdle();
+    m_tree64_leaf_masks_buffer.destroy();
+    m_tree64_leaf_mask_dictionary_buffer.destroy();
+    m_tree64_leaf_mask_count = std::size(leaf_masks);
+    m_tree64_unique_leaf_mask_count = 0u;
+    m_gpu_tree64.leaf_masks_device_address = 0u;
+    m_gpu_tree64.leaf_mask_dictionary_device_address = 0u;
+    auto leaf_mask_index_bit_count = 0u;
+    if (!std::empty(leaf_masks) && m_imports_leaf_mask_dictionary) {
+        auto const begin_time = std::chrono::high_resolution_clock::now();
+        auto const dictionary = build_leaf_mask_dictionary(leaf_masks);
+        auto const dictionary_time = std::chrono::high_resolution_clock::now() - begin_time;
+        auto const dictionary_size = dictionary.unique_leaf_masks.size() * sizeof(uint64_t) + dictionary.packed_indices.size() * sizeof(uint32_t);
+        std::cout << "leaf mask dictionary time " << std::chrono::duration_cast<std::chrono::duration<float>>(dictionary_time) << std::endl;
+        std::cout << "leaf mask dictionary " << std::size(dictionary.unique_leaf_masks) << " unique masks, "
+            << dictionary.index_bit_count << " bits indices (" << dictionary_size / (1u << 20u) << " MiB of VRAM instead of "
+            << leaf_masks.size_bytes() / (1u << 20u) << " MiB)" << std::endl;
+        leaf_mask_index_bit_count = dictionary.index_bit_count;
+        m_tree64_unique_leaf_mask_count = std::size(dictionary.unique_leaf_masks);
+        m_tree64_leaf_masks_buffer = create_tree64_array_buffer(std::as_bytes(std::span(dictionary.packed_indices)));
+        m_tree64_leaf_mask_dictionary_buffer = create_tree64_array_buffer(std::as_bytes(std::span(dictionary.unique_leaf_masks)));
+        m_gpu_tree64.leaf_mask_dictionary_device_address = m_vk_ctx.device.getBufferAddress(vk::BufferDeviceAddressInfo{
+            .buffer = m_tree64_leaf_mask_dictionary_buffer,
+        });
+    } else if (!std::empty(leaf_masks)) {
+        m_tree64_leaf_masks_buffer = create_tree64_array_buffer(std::as_bytes(leaf_masks));
+    }
+    if (!std::empty(leaf_masks)) {
+        m_gpu_tree64.leaf_masks_device_address = m_vk_ctx.device.getBufferAddress(vk::BufferDeviceAddressInfo{
+            .buffer = m_tree64_leaf_masks_buffer,
+        });
+    }
+    if (leaf_mask_index_bit_count != m_tree64_leaf_mask_index_bit_count) {
+        m_tree64_leaf_mask_index_bit_count = leaf_mask_index_bit_count;
+        create_graphics_pipeline();
+        create_compute_pipeline();
+    }
+}
+
+std::vector<uint64_t> Application::read_back_tree64_leaf_masks() const {
+    if (m_tree64_leaf_mask_index_bit_count == 0u) {
+        return read_back_tree64_array<uint64_t>(m_tree64_leaf_masks_buffer, m_tree64_leaf_mask_count);
+    }
+    auto dictionary = LeafMaskDictionary{
+        .unique_leaf_masks = read_back_tree64_array<uint64_t>(m_tree64_leaf_mask_dictionary_buffer, m_tree64_unique_leaf_mask_count),
+        .index_bit_count = m_tree64_leaf_mask_index_bit_count,
+        .packed_indices = read_back_tree64_array<uint32_t>(m_tree64_leaf_masks_buffer,
+            (m_tree64_leaf_mask_count * m_tree64_leaf_mask_index_bit_count + 31u) / 32u),
+    };
+    return decode_leaf_masks(dictionary, m_tree64_leaf_mask_count);
+}
+
+// The frames in flight read it, like the sky rendering parameters
+void Application::update_gpu_tree64_buffer() {
+    auto staging_buffer = VmaRaiiBuffer(m_vk_ctx.allocator, sizeof(GpuTree64), vk::BufferUsageFlagBits::eTransferSrc,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO);
+    staging_buffer.copy_memory_to_allocation(reinterpret_cast<uint8_t const*>(&m_gpu_tree64), 0u, sizeof(GpuTree64));
+
+    m_vk_ctx.device.waitIdle();
+    copy_buffer(staging_buffer, m_gpu_tree64_buffer, sizeof(GpuTree64));
+}
+
+void Application::save_acceleration_structure(std::filesystem::path const& path) {
+    if (!save_t64(path, displayed_contiguous_tree64())) {
         std::cerr << "Cannot save acceleration structure to " << string_from(path) << std::endl;
     }
 }
 
 void Application::update_hosek_wilkie_sky_rendering_parameters() {
-    auto* const sky_model = arhosek_rgb_skymodelstate_alloc_init(m_hosek_wilkie_sky_turbidity, m_hosek_wilkie_sky_albedo, m_sun_elevation);
-    auto rendering_params = HosekWilkieSkyRenderingParameters{};
-    for (auto i = 0u; i < std::size(rendering_params.config); ++i) {
-        rendering_params.config[i] = glm::vec3(sky_model->configs[0][i], sky_model->configs[1][i], sky_model->configs[2][i]);
-    }
-    rendering_params.luminance = glm::vec3(sky_model->radiances[0], sky_model->radiances[1], sky_model->radiances[2])
-        * (2.f * glm::pi<float>() / 683.f), // convert from radiance to luminance
-    arhosekskymodelstate_free(sky_model);
+    auto const rendering_params = hosek_wilkie_sky_rendering_parameters(m_hosek_wilkie_sky_turbidity, m_hosek_wilkie_sky_albedo,
+        m_sun_elevation);
 
     auto staging_buffer = VmaRaiiBuffer(m_vk_ctx.allocator, sizeof(HosekWilkieSkyRenderingParameters), vk::BufferUsageFlagBits::eTransferSrc,
         VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO);
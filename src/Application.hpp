@@ -7,19 +7,32 @@
 #include "ImGuiWrapper.hpp"
 #include "Camera.hpp"
 #include "Tree64.hpp"
+#include "Tree64Editor.hpp"
+#include "tree64_layout.hpp"
+#include "tree64_order.hpp"
 
 #include <vulkan/vulkan_raii.hpp>
 #include <glm/glm.hpp>
 
 #include <vector>
+#include <array>
 #include <cstdint>
 #include <future>
+#include <optional>
+#include <chrono>
+#include <span>
+#include <cstddef>
 
 namespace vp {
 
 #pragma pack(push, 1)
 struct GpuTree64 {
     vk::DeviceAddress nodes_device_address = 0u;
+    vk::DeviceAddress far_offsets_device_address = 0u; // only with Tree64NodeAddressing::Relative
+    // Only with Tree64NodeLayout::Split, the nodes one then points to the children masks
+    vk::DeviceAddress node_indices_device_address = 0u;
+    vk::DeviceAddress leaf_masks_device_address = 0u; // only with inlined leaf masks, the packed indices with a dictionary
+    vk::DeviceAddress leaf_mask_dictionary_device_address = 0u; // only with a leaf mask dictionary
     uint32_t depth = 0u;
 };
 
@@ -30,6 +43,46 @@ struct GpuBeamOptimBuffer {
 };
 #pragma pack(pop)
 
+// Must match the specialization constants of the raytracing shader
+struct RaytracingSpecializationConstants {
+    vk::Bool32 uses_relative_tree64_addressing = vk::False;
+    uint32_t tree64_node_layout = 0u;
+    vk::Bool32 inlines_tree64_leaf_masks = vk::False;
+    uint32_t tree64_leaf_mask_index_bit_count = 0u; // 0 without a leaf mask dictionary
+    uint32_t tree64_depth = 0u; // 0 when not specialized on the tree depth
+};
+
+// Renders a number of frames with each node layout, timed with GPU timestamps, first with the pipelines reading the
+// tree depth then with the ones specialized on it
+struct Tree64NodeLayoutBenchmark {
+    static constexpr auto WARM_UP_FRAME_COUNT = 16u; // also covers the frames in flight rendered with the previous layout
+    static constexpr auto MEASURED_FRAME_COUNT = 256u;
+
+    Tree64NodeLayout benchmarked_layout = Tree64NodeLayout::Packed;
+    Tree64NodeLayout restored_layout = Tree64NodeLayout::Packed;
+    bool specializes_depth = false;
+    bool restores_depth_specialization = true;
+    uint32_t frame_count = 0u;
+    double gpu_seconds = 0.;
+    double ray_count = 0.;
+};
+
+enum class Tree64BuildingBackend : uint8_t {
+    Morton, // MortonTree64Builder
+    Pointer, // Tree64
+    Sparse, // SparseTree64
+};
+
+struct ModelImportSettings {
+    uint32_t max_side_voxel_count = 1024u;
+    VoxelizationSettings voxelization_settings;
+    Tree64BuildingBackend building_backend = Tree64BuildingBackend::Morton;
+    bool hollows_hidden_voxels = false;
+    bool deduplicates_subtrees = false;
+    bool inlines_leaf_masks = false;
+    bool uses_leaf_mask_dictionary = false;
+};
+
 class Application {
 public:
     Application();
@@ -56,6 +109,7 @@ private:
     void create_graphics_pipeline();
     vk::PipelineRenderingCreateInfo pipeline_rendering_create_info() const;
     void create_compute_pipeline();
+    RaytracingSpecializationConstants raytracing_specialization_constants() const;
     vk::raii::ShaderModule create_shader_module(std::string shader) const;
 
     void create_command_pool();
@@ -73,10 +127,36 @@ private:
     void draw_frame();
     void record_frame(vk::CommandBuffer command_buffer, Swapchain::AcquiredImage const& acquired_image);
 
+    void record_tree64_edits_upload(vk::CommandBuffer command_buffer);
+
+    void create_timestamp_query_pool();
+    void read_frame_timestamps();
+    void update_tree64_node_layout_benchmark();
+
     void copy_buffer(vk::Buffer src, vk::Buffer dst, vk::DeviceSize size) const;
     void copy_buffer_to_image(vk::Buffer src, vk::Image dst, uint32_t width, uint32_t height) const;
 
-    void create_tree64_buffer(std::span<Tree64Node const> nodes);
+    void create_tree64_buffer(std::span<Tree64Node const> nodes, size_t node_capacity);
+    [[nodiscard]] std::vector<vk::BufferCopy> stage_tree64_nodes(std::span<Tree64Node const> nodes,
+        std::span<Tree64NodeRange const> node_ranges, VmaRaiiBuffer& staging_buffer) const;
+    [[nodiscard]] std::vector<Tree64Node> read_back_tree64_nodes();
+    void set_tree64_node_layout(Tree64NodeLayout node_layout);
+    void set_specializes_tree64_depth(bool specializes_depth);
+    [[nodiscard]] ContiguousTree64 displayed_contiguous_tree64();
+    void record_tree64_node_visits();
+    void reorder_tree64_nodes();
+    [[nodiscard]] VmaRaiiBuffer create_tree64_array_buffer(std::span<std::byte const> data) const;
+    void read_back_buffer(vk::Buffer buffer, std::span<std::byte> data) const;
+    template<typename T>
+    [[nodiscard]] std::vector<T> read_back_tree64_array(vk::Buffer const buffer, size_t const count) const {
+        auto array = std::vector<T>(count);
+        read_back_buffer(buffer, std::as_writable_bytes(std::span(array)));
+        return array;
+    }
+    void create_tree64_far_offsets_buffer(std::span<uint64_t const> far_offsets);
+    void create_tree64_leaf_masks_buffer(std::span<uint64_t const> leaf_masks);
+    [[nodiscard]] std::vector<uint64_t> read_back_tree64_leaf_masks() const;
+    void update_gpu_tree64_buffer();
     void save_acceleration_structure(std::filesystem::path const& path);
 
     void update_hosek_wilkie_sky_rendering_parameters();
@@ -107,11 +187,50 @@ private:
     std::unique_ptr<ImGuiWrapper> m_imgui;
 
     std::filesystem::path m_model_path_to_import;
-    uint32_t m_max_side_voxel_count_to_import = 1024;
+    ModelImportSettings m_model_import_settings;
     std::future<std::optional<ContiguousTree64>> m_model_import_future;
+    bool m_imports_dag = false;
+    bool m_imports_hollowed = false;
+    bool m_imports_leaf_mask_dictionary = false;
 
     VmaRaiiBuffer m_tree64_nodes_buffer = VmaRaiiBuffer(nullptr);
+    size_t m_tree64_node_capacity = 0u;
+    VmaRaiiBuffer m_tree64_far_offsets_buffer = VmaRaiiBuffer(nullptr);
+    size_t m_tree64_far_offset_count = 0u;
+    VmaRaiiBuffer m_tree64_leaf_masks_buffer = VmaRaiiBuffer(nullptr);
+    size_t m_tree64_leaf_mask_count = 0u;
+    VmaRaiiBuffer m_tree64_leaf_mask_dictionary_buffer = VmaRaiiBuffer(nullptr);
+    size_t m_tree64_unique_leaf_mask_count = 0u;
+    // The pipelines are specialized on them
+    Tree64NodeAddressing m_tree64_addressing = Tree64NodeAddressing::Absolute;
+    Tree64NodeLayout m_tree64_node_layout = Tree64NodeLayout::Packed;
+    bool m_inlines_tree64_leaf_masks = false;
+    uint32_t m_tree64_leaf_mask_index_bit_count = 0u;
+    bool m_specializes_tree64_depth = true; // on m_gpu_tree64.depth
     GpuTree64 m_gpu_tree64;
+    VmaRaiiBuffer m_gpu_tree64_buffer = VmaRaiiBuffer(nullptr); // GpuTree64 outgrew the push constants
+    vk::DeviceAddress m_gpu_tree64_device_address = 0u;
+
+    std::optional<Tree64Editor> m_tree64_editor; // only for the trees of plain absolute nodes, not shared by a DAG
+    std::array<VmaRaiiBuffer, MAX_FRAMES_IN_FLIGHT> m_tree64_edit_staging_buffers = {
+        VmaRaiiBuffer(nullptr), VmaRaiiBuffer(nullptr),
+    };
+    glm::uvec3 m_edit_box_min = glm::uvec3(0u);
+    glm::uvec3 m_edit_box_max = glm::uvec3(15u);
+    std::chrono::duration<float> m_last_tree64_edit_time = std::chrono::duration<float>(0.f);
+
+    vk::raii::QueryPool m_timestamp_query_pool = vk::raii::QueryPool(nullptr); // 2 per frame in flight, none if unsupported
+    double m_timestamp_period = 0.; // nanoseconds
+    std::array<bool, MAX_FRAMES_IN_FLIGHT> m_has_written_frame_timestamps = {};
+    std::array<double, MAX_FRAMES_IN_FLIGHT> m_frame_ray_counts = {};
+    double m_last_frame_gpu_seconds = 0.;
+    std::optional<Tree64NodeLayoutBenchmark> m_tree64_node_layout_benchmark;
+    // Without then with the depth specialization
+    std::array<std::array<double, 2u>, TREE64_NODE_LAYOUT_COUNT> m_tree64_node_layout_rays_per_second = {};
+
+    Tree64NodeOrder m_tree64_node_order = Tree64NodeOrder::VanEmdeBoas;
+    std::vector<uint32_t> m_tree64_node_visit_counts; // a count per node, for Tree64NodeOrder::ProfileGuided
+    size_t m_tree64_node_visits_ray_count = 0u;
 
     VmaRaiiBuffer m_beam_optim_distances_buffer = VmaRaiiBuffer(nullptr);
     GpuBeamOptimBuffer m_gpu_beam_optim_buffer;
@@ -53,7 +53,7 @@ public:
     template<typename Type>
     void read_vector(size_t const count, std::vector<Type>& vector) {
         vector.reserve(std::size(vector) + count);
-        for (auto i = 0u; i < count; ++i) {
+        for (auto i = size_t{ 0u }; i < count; ++i) {
             vector.emplace_back(read<Type>());
         }
     }
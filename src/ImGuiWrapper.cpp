@@ -1,5 +1,4 @@
 #include "ImGuiWrapper.hpp"
-#include "math.hpp"
 
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
@@ -7,6 +6,14 @@
 
 namespace vp {
 
+static constexpr glm::vec4 vec4_from(ImVec4 const& vec4) {
+    return glm::vec4(vec4.x, vec4.y, vec4.z, vec4.w);
+}
+
+static constexpr ImVec4 imvec4_from(glm::vec4 const& vec4) {
+    return ImVec4(vec4.x, vec4.y, vec4.z, vec4.w);
+}
+
 ImGuiWrapper::ImGuiWrapper(Window& window, ImGui_ImplVulkan_InitInfo& init_info) {
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -0,0 +1,422 @@
+#include "MortonTree64Builder.hpp"
+#include "tree64_import.hpp"
+#include "tree64_addressing.hpp"
+
+#include <array>
+#include <numeric>
+#include <algorithm>
+#include <bit>
+#include <atomic>
+#include <future>
+#include <thread>
+
+namespace vp {
+
+// Spread the 2 bits of each level at the start of each 6 bits group : 0b11'10 -> 0b000011'000010
+static uint64_t spread_bit_pairs(uint32_t const value) {
+    static_assert(Tree64::MAX_DEPTH <= 10u, "Only 10 bit pairs are spread");
+    auto spread = static_cast<uint64_t>(value & 0xfffffu);
+    spread = (spread | (spread << 32u)) & 0xf00000000ffff_u64;
+    spread = (spread | (spread << 16u)) & 0xf0000ff0000ff_u64;
+    spread = (spread | (spread << 8u)) & 0xf00f00f00f00f_u64;
+    spread = (spread | (spread << 4u)) & 0xc30c30c30c30c3_u64;
+    return spread;
+}
+
+uint64_t MortonTree64Builder::morton_code(glm::uvec3 const& voxel, uint8_t const depth) {
+    // voxels past the end are clamped, like Tree64::add_voxel does
+    auto const clamped_voxel = glm::min(voxel, glm::uvec3((1u << (depth * 2u)) - 1u));
+    return spread_bit_pairs(clamped_voxel.x) | (spread_bit_pairs(clamped_voxel.z) << 2u) | (spread_bit_pairs(clamped_voxel.y) << 4u);
+}
+
+// Only the bit_count least significant bits are sorted, the order of the values equal on them is kept
+static void radix_sort(std::span<uint64_t> const values, uint32_t const bit_count) {
+    constexpr auto DIGIT_BIT_COUNT = 11u;
+    constexpr auto DIGIT_MASK = (1_u64 << DIGIT_BIT_COUNT) - 1_u64;
+    auto const sorted_bits_mask = (1_u64 << bit_count) - 1_u64;
+    auto sorted_values_storage = std::vector<uint64_t>(std::size(values));
+    auto unsorted_values = values;
+    auto sorted_values = std::span(sorted_values_storage);
+    auto offsets = std::array<size_t, 1u << DIGIT_BIT_COUNT>();
+    for (auto shift = 0u; shift < bit_count; shift += DIGIT_BIT_COUNT) {
+        offsets.fill(0u);
+        for (auto const value : unsorted_values) {
+            offsets[((value & sorted_bits_mask) >> shift) & DIGIT_MASK] += 1u;
+        }
+        std::exclusive_scan(std::begin(offsets), std::end(offsets), std::begin(offsets), size_t{ 0u });
+        for (auto const value : unsorted_values) {
+            sorted_values[offsets[((value & sorted_bits_mask) >> shift) & DIGIT_MASK]++] = value;
+        }
+        std::swap(unsorted_values, sorted_values);
+    }
+    if (std::data(unsorted_values) != std::data(values)) {
+        std::ranges::copy(unsorted_values, std::begin(values));
+    }
+}
+
+void MortonTree64Builder::sort_morton_codes(std::span<uint64_t> const morton_codes, uint8_t const depth) {
+    radix_sort(morton_codes, depth * 6u);
+}
+
+static uint32_t full_node_height_of(uint64_t const morton_code) {
+    return static_cast<uint32_t>(morton_code >> MortonTree64Builder::FULL_NODE_HEIGHT_SHIFT);
+}
+
+// The count of morton codes of the voxels of the full node
+static uint64_t full_node_extent_of(uint64_t const morton_code) {
+    return 1_u64 << (full_node_height_of(morton_code) * 6u);
+}
+
+size_t MortonTree64Builder::merge_full_nodes(std::span<uint64_t> const sorted_morton_codes, uint32_t const max_height) {
+    // The kept morton codes never overlap, so only the last one can contain the next morton code
+    auto merged_count = size_t{ 0u };
+    for (auto const morton_code : sorted_morton_codes) {
+        auto const position = morton_code & MORTON_CODE_POSITION_MASK;
+        // The sort keeps the order of the morton codes of a same position, a bigger full node may come after a smaller one
+        while (merged_count > 0u && (sorted_morton_codes[merged_count - 1u] & MORTON_CODE_POSITION_MASK) == position
+            && full_node_extent_of(sorted_morton_codes[merged_count - 1u]) <= full_node_extent_of(morton_code)) {
+            merged_count -= 1u;
+        }
+        if (merged_count > 0u) {
+            auto const last_morton_code = sorted_morton_codes[merged_count - 1u];
+            if (position < (last_morton_code & MORTON_CODE_POSITION_MASK) + full_node_extent_of(last_morton_code)) {
+                continue;
+            }
+        }
+        sorted_morton_codes[merged_count] = morton_code;
+        merged_count += 1u;
+        // The 64 full siblings end on the last one, they are the 64 last kept morton codes when they all have its height
+        while (merged_count >= 64u) {
+            auto const last_morton_code = sorted_morton_codes[merged_count - 1u];
+            auto const height = full_node_height_of(last_morton_code);
+            auto const last_position = last_morton_code & MORTON_CODE_POSITION_MASK;
+            if (height >= max_height || ((last_position >> (height * 6u)) & 63_u64) != 63_u64) {
+                break;
+            }
+            auto const siblings = sorted_morton_codes.subspan(merged_count - 64u, 64u);
+            auto const first_position = siblings[0] & MORTON_CODE_POSITION_MASK;
+            auto const are_siblings = first_position + 63_u64 * full_node_extent_of(last_morton_code) == last_position
+                && std::ranges::all_of(siblings, [&](uint64_t const sibling) { return full_node_height_of(sibling) == height; });
+            if (!are_siblings) {
+                break;
+            }
+            merged_count -= 63u;
+            sorted_morton_codes[merged_count - 1u] = first_position | (static_cast<uint64_t>(height + 1u) << FULL_NODE_HEIGHT_SHIFT);
+        }
+    }
+    return merged_count;
+}
+
+std::vector<Tree64Node> MortonTree64Builder::build_contiguous_nodes_from_sorted(uint8_t const depth,
+    std::span<uint64_t const> const morton_codes) {
+    if (std::empty(morton_codes)) {
+        return std::vector<Tree64Node>(1u);
+    }
+    // levels[i] holds the finished nodes of the level i in morton order,
+    // their first child node index refers to levels[i + 1] until they are emitted
+    auto levels = std::array<std::vector<Tree64Node>, Tree64::MAX_DEPTH>();
+    auto opened_nodes = std::array<Tree64Node, Tree64::MAX_DEPTH>();
+    auto const child_index_at = [&](uint64_t const morton_code, uint32_t const level) {
+        return static_cast<uint32_t>((morton_code >> ((depth - 1u - level) * 6u)) & 63_u64);
+    };
+    // The path stops at the full node of the last morton code
+    auto path_level_count = 0u;
+    auto const open_nodes = [&](uint32_t const first_level, uint32_t const level_count) {
+        path_level_count = level_count;
+        for (auto level = first_level; level < level_count; ++level) {
+            opened_nodes[level] = Tree64Node();
+            if (level + 1u < depth) {
+                opened_nodes[level].set_first_child_node_index(absolute_first_child_node_index(std::size(levels[level + 1u])));
+            }
+        }
+    };
+    auto const close_nodes = [&](uint32_t const first_level) {
+        for (auto level = path_level_count - 1u; level + 1u > first_level; --level) {
+            auto node = opened_nodes[level];
+            if (level + 1u < depth) {
+                auto& children = levels[level + 1u];
+                auto const first_child_node_index = node.first_child_node_index();
+                auto const can_merge = std::all_of(std::begin(children) + first_child_node_index, std::end(children),
+                    [](Tree64Node const& child) {
+                        return child.is_leaf() && child.children_mask == ~0_u64;
+                    });
+                if (can_merge) {
+                    children.resize(first_child_node_index);
+                    node.set_first_child_node_index(0u);
+                } else {
+                    node.set_is_leaf(false);
+                }
+            }
+            levels[level].emplace_back(node);
+        }
+    };
+
+    // The level of the full node of a morton code, depth for a single voxel
+    auto const full_level_of = [&](uint64_t const morton_code) {
+        return depth - std::min(full_node_height_of(morton_code), uint32_t{ depth });
+    };
+    auto const path_level_count_of = [&](uint64_t const morton_code) {
+        return std::min(full_level_of(morton_code) + 1u, uint32_t{ depth });
+    };
+    open_nodes(0u, path_level_count_of(morton_codes[0]));
+    auto previous_position = morton_codes[0] & MORTON_CODE_POSITION_MASK;
+    for (auto const morton_code : morton_codes) {
+        auto const position = morton_code & MORTON_CODE_POSITION_MASK;
+        auto const full_level = full_level_of(morton_code);
+        auto first_changed_level = 0u;
+        if (position != previous_position) {
+            auto const highest_changed_bit = static_cast<uint32_t>(std::bit_width(position ^ previous_position)) - 1u;
+            first_changed_level = depth - 1u - highest_changed_bit / 6u;
+            close_nodes(first_changed_level + 1u);
+            open_nodes(first_changed_level + 1u, path_level_count_of(morton_code));
+            previous_position = position;
+        }
+        for (auto level = first_changed_level; level < full_level; ++level) {
+            opened_nodes[level].children_mask |= 1_u64 << child_index_at(position, level);
+        }
+        if (full_level < depth) {
+            opened_nodes[full_level].children_mask = ~0_u64;
+        }
+    }
+    close_nodes(0u);
+
+    auto node_count = size_t{ 0u };
+    for (auto const& level_nodes : levels) {
+        node_count += std::size(level_nodes);
+    }
+    auto nodes = std::vector<Tree64Node>();
+    nodes.reserve(node_count);
+    nodes.emplace_back(levels[0][0]);
+    // Same depth first order of sibling groups as Tree64::build_contiguous_nodes
+    auto const emit = [&](auto const& self, uint32_t const level, size_t const node_index) -> void {
+        if (nodes[node_index].is_leaf()) {
+            return;
+        }
+        auto const level_first_child_node_index = nodes[node_index].first_child_node_index();
+        auto const child_count = static_cast<uint32_t>(std::popcount(nodes[node_index].children_mask));
+        auto const first_child_node_index = std::size(nodes);
+        nodes[node_index].set_first_child_node_index(absolute_first_child_node_index(first_child_node_index));
+        auto const level_children = std::span(levels[level + 1u]).subspan(level_first_child_node_index, child_count);
+        nodes.insert(std::end(nodes), std::begin(level_children), std::end(level_children));
+        for (auto i = 0u; i < child_count; ++i) {
+            self(self, level + 1u, first_child_node_index + i);
+        }
+    };
+    emit(emit, 0u, 0u);
+    return nodes;
+}
+
+// subtrees_nodes[i] holds the contiguous nodes of the child at the bit index i, root first, or nothing if there is no child
+static std::vector<Tree64Node> stitch_subtrees(std::span<std::vector<Tree64Node>, 64u> const subtrees_nodes) {
+    auto root = Tree64Node();
+    auto node_count = size_t{ 1u };
+    auto can_merge = true;
+    for (auto i = 0_u64; i < 64_u64; ++i) {
+        auto const& subtree_nodes = subtrees_nodes[i];
+        if (std::empty(subtree_nodes)) {
+            continue;
+        }
+        root.children_mask |= 1_u64 << i;
+        node_count += std::size(subtree_nodes);
+        can_merge = can_merge && subtree_nodes[0].is_leaf() && subtree_nodes[0].children_mask == ~0_u64;
+    }
+    if (can_merge) {
+        return std::vector<Tree64Node>{ root };
+    }
+    root.set_is_leaf(false);
+    root.set_first_child_node_index(1u);
+    auto nodes = std::vector<Tree64Node>();
+    nodes.reserve(node_count);
+    nodes.emplace_back(root);
+    nodes.resize(1u + static_cast<size_t>(std::popcount(root.children_mask)));
+    auto child_node_index = size_t{ 1u };
+    for (auto& subtree_nodes : subtrees_nodes) {
+        if (std::empty(subtree_nodes)) {
+            continue;
+        }
+        // The subtree root goes in the children group of the root, the rest of the subtree is appended
+        auto const rest_offset = std::size(nodes) - 1u;
+        for (auto& node : subtree_nodes) {
+            if (!node.is_leaf()) {
+                node.set_first_child_node_index(absolute_first_child_node_index(node.first_child_node_index() + rest_offset));
+            }
+        }
+        nodes[child_node_index] = subtree_nodes[0];
+        nodes.insert(std::end(nodes), std::begin(subtree_nodes) + 1, std::end(subtree_nodes));
+        child_node_index += 1u;
+        subtree_nodes = std::vector<Tree64Node>();
+    }
+    return nodes;
+}
+
+// Partitions the morton codes by the subtrees of the first levels, builds each partition on its own thread,
+// then stitches the partitions back under the root, giving the same nodes as a single threaded build
+static std::vector<Tree64Node> build_contiguous_nodes_from_unsorted(uint8_t const depth, std::span<uint64_t> const morton_codes) {
+    constexpr auto MIN_PARALLEL_MORTON_CODE_COUNT = size_t{ 1u } << 16u;
+    auto const thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    if (depth < 2u || thread_count == 1u || std::size(morton_codes) < MIN_PARALLEL_MORTON_CODE_COUNT) {
+        radix_sort(morton_codes, depth * 6u);
+        auto const merged_count = MortonTree64Builder::merge_full_nodes(morton_codes, depth);
+        return MortonTree64Builder::build_contiguous_nodes_from_sorted(depth, morton_codes.first(merged_count));
+    }
+    // Partition by the first two levels when possible, 64 partitions are too coarse when the model is flat
+    auto const partition_level_count = depth > 2u ? 2u : 1u;
+    auto const partition_shift = (depth - partition_level_count) * 6u;
+    auto const partition_count = size_t{ 1u } << (partition_level_count * 6u);
+    auto const partition_depth = static_cast<uint8_t>(depth - partition_level_count);
+    auto const partition_of = [&](uint64_t const morton_code) {
+        return static_cast<size_t>((morton_code & MortonTree64Builder::MORTON_CODE_POSITION_MASK) >> partition_shift);
+    };
+    // The full nodes bigger than the partitions are split into full partitions, there are at most partition_count of them
+    auto const split_begin = std::partition(std::begin(morton_codes), std::end(morton_codes), [&](uint64_t const morton_code) {
+        return full_node_height_of(morton_code) <= partition_depth;
+    });
+    auto const unsplit_morton_codes = morton_codes.first(static_cast<size_t>(split_begin - std::begin(morton_codes)));
+    auto split_morton_codes = std::vector<uint64_t>();
+    for (auto const morton_code : std::span(split_begin, std::end(morton_codes))) {
+        auto const partition_morton_code_count = full_node_extent_of(morton_code) >> partition_shift;
+        for (auto i = 0_u64; i < partition_morton_code_count; ++i) {
+            split_morton_codes.emplace_back(((morton_code & MortonTree64Builder::MORTON_CODE_POSITION_MASK) + (i << partition_shift))
+                | (uint64_t{ partition_depth } << MortonTree64Builder::FULL_NODE_HEIGHT_SHIFT));
+        }
+    }
+    auto partition_offsets = std::vector<size_t>(partition_count + 1u);
+    for (auto const morton_codes_part : { unsplit_morton_codes, std::span(split_morton_codes) }) {
+        for (auto const morton_code : morton_codes_part) {
+            partition_offsets[partition_of(morton_code) + 1u] += 1u;
+        }
+    }
+    std::inclusive_scan(std::begin(partition_offsets), std::end(partition_offsets), std::begin(partition_offsets));
+    auto partitioned_morton_codes = std::vector<uint64_t>(partition_offsets.back());
+    {
+        auto insert_offsets = partition_offsets;
+        for (auto const morton_codes_part : { unsplit_morton_codes, std::span(split_morton_codes) }) {
+            for (auto const morton_code : morton_codes_part) {
+                partitioned_morton_codes[insert_offsets[partition_of(morton_code)]++] = morton_code;
+            }
+        }
+    }
+    split_morton_codes = std::vector<uint64_t>();
+
+    auto partitions_nodes = std::vector<std::vector<Tree64Node>>(partition_count);
+    auto next_partition_index = std::atomic<size_t>(0u);
+    auto const build_partitions = [&]() {
+        for (auto i = next_partition_index++; i < partition_count; i = next_partition_index++) {
+            auto const partition = std::span(partitioned_morton_codes).subspan(partition_offsets[i],
+                partition_offsets[i + 1u] - partition_offsets[i]);
+            if (std::empty(partition)) {
+                continue;
+            }
+            radix_sort(partition, partition_depth * 6u);
+            auto const merged_count = MortonTree64Builder::merge_full_nodes(partition, partition_depth);
+            partitions_nodes[i] = MortonTree64Builder::build_contiguous_nodes_from_sorted(partition_depth,
+                partition.first(merged_count));
+        }
+    };
+    auto workers = std::vector<std::future<void>>();
+    for (auto i = 1u; i < thread_count; ++i) {
+        workers.emplace_back(std::async(std::launch::async, build_partitions));
+    }
+    build_partitions();
+    for (auto& worker : workers) {
+        worker.get();
+    }
+    partitioned_morton_codes = std::vector<uint64_t>();
+
+    if (partition_level_count == 1u) {
+        return stitch_subtrees(std::span<std::vector<Tree64Node>, 64u>(partitions_nodes));
+    }
+    auto first_level_subtrees_nodes = std::vector<std::vector<Tree64Node>>(64u);
+    for (auto i = 0u; i < 64u; ++i) {
+        auto const second_level_subtrees_nodes = std::span(partitions_nodes).subspan(i * 64u).first<64u>();
+        if (std::ranges::any_of(second_level_subtrees_nodes, [](auto const& nodes) { return !std::empty(nodes); })) {
+            first_level_subtrees_nodes[i] = stitch_subtrees(second_level_subtrees_nodes);
+        }
+    }
+    return stitch_subtrees(std::span<std::vector<Tree64Node>, 64u>(first_level_subtrees_nodes));
+}
+
+std::optional<MortonTree64Builder> MortonTree64Builder::voxelize_model(std::filesystem::path const& path,
+    uint32_t const max_side_voxel_count, VoxelizationSettings const& settings) {
+    return voxelize_model_into<MortonTree64Builder>(path, max_side_voxel_count, settings);
+}
+
+std::optional<MortonTree64Builder> MortonTree64Builder::import_vox(std::filesystem::path const& path) {
+    return import_vox_into<MortonTree64Builder>(path);
+}
+
+std::vector<Tree64Node> MortonTree64Builder::build_contiguous_nodes(uint8_t const depth, std::span<glm::uvec3 const> const voxels) {
+    assert(depth <= Tree64::MAX_DEPTH);
+    auto morton_codes = std::vector<uint64_t>();
+    morton_codes.reserve(std::size(voxels));
+    for (auto const& voxel : voxels) {
+        morton_codes.emplace_back(morton_code(voxel, depth));
+    }
+    return build_contiguous_nodes_from_unsorted(depth, morton_codes);
+}
+
+MortonTree64Builder::MortonTree64Builder(uint8_t const depth) :
+    m_depth{ depth } {
+    assert(depth <= Tree64::MAX_DEPTH);
+}
+
+uint8_t MortonTree64Builder::depth() const {
+    return m_depth;
+}
+
+// Sorting needs as much scratch memory as the morton codes
+size_t MortonTree64Builder::peak_building_memory_size() const {
+    return sizeof(*this) + 2u * m_morton_codes.capacity() * sizeof(uint64_t);
+}
+
+std::vector<Tree64Node> MortonTree64Builder::build_contiguous_nodes() {
+    return build_contiguous_nodes_from_unsorted(m_depth, m_morton_codes);
+}
+
+void MortonTree64Builder::add_voxel(glm::uvec3 const& voxel) {
+    add_morton_code(morton_code(voxel, m_depth));
+}
+
+void MortonTree64Builder::add_voxels(std::span<glm::uvec3 const> const voxels) {
+    for (auto const& voxel : voxels) {
+        auto const code = morton_code(voxel, m_depth);
+        if (!std::empty(m_morton_codes) && m_morton_codes.back() == code) {
+            continue;
+        }
+        add_morton_code(code);
+    }
+}
+
+void MortonTree64Builder::add_brick_runs(std::span<VoxelBrickRun const> const brick_runs) {
+    for (auto const& brick_run : brick_runs) {
+        for (auto i = 0u; i < brick_run.brick_count; ++i) {
+            auto const brick_morton_code = morton_code((brick_run.first_brick + glm::uvec3(0u, i, 0u)) * 4u, m_depth);
+            if (brick_run.mask == ~0_u64) {
+                add_morton_code(brick_morton_code | (1_u64 << FULL_NODE_HEIGHT_SHIFT));
+                continue;
+            }
+            for (auto mask = brick_run.mask; mask != 0_u64; mask &= mask - 1_u64) {
+                add_morton_code(brick_morton_code | static_cast<uint64_t>(std::countr_zero(mask)));
+            }
+        }
+    }
+}
+
+void MortonTree64Builder::add_morton_code(uint64_t const morton_code) {
+    if (std::size(m_morton_codes) == m_morton_codes.capacity()
+        && std::size(m_morton_codes) >= MIN_COMPACTED_MORTON_CODE_COUNT) {
+        compact_morton_codes();
+    }
+    m_morton_codes.emplace_back(morton_code);
+}
+
+// Importers emit a lot of duplicated voxels, remove them and merge the full nodes before growing the storage
+void MortonTree64Builder::compact_morton_codes() {
+    radix_sort(m_morton_codes, m_depth * 6u);
+    m_morton_codes.resize(merge_full_nodes(m_morton_codes, m_depth));
+    if (std::size(m_morton_codes) > m_morton_codes.capacity() / 2u) {
+        m_morton_codes.reserve(m_morton_codes.capacity() * 2u);
+    }
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Tree64.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <span>
+#include <filesystem>
+#include <optional>
+
+namespace vp {
+
+// Produces the same contiguous nodes as Tree64::build_contiguous_nodes, but instead of walking the tree for every
+// voxel, the voxels are radix sorted by 64-ary morton code and the tree is emitted bottom-up in one linear pass
+class MortonTree64Builder {
+public:
+    [[nodiscard]] static std::optional<MortonTree64Builder> voxelize_model(std::filesystem::path const& path, uint32_t max_side_voxel_count,
+        VoxelizationSettings const& settings = {});
+    [[nodiscard]] static std::optional<MortonTree64Builder> import_vox(std::filesystem::path const& path);
+
+    [[nodiscard]] static std::vector<Tree64Node> build_contiguous_nodes(uint8_t depth, std::span<glm::uvec3 const> voxels);
+
+    // Each 6 bits group is a child index in the same layout as Tree64Node::children_mask, the root one being the most significant
+    [[nodiscard]] static uint64_t morton_code(glm::uvec3 const& voxel, uint8_t depth);
+    // The 4 most significant bits of a morton code hold the height of the full node it stands for, 0 for a single voxel,
+    // 1 for a 4x4x4 brick, 2 for 16x16x16 voxels and so on, the other bits being the morton code of its first voxel.
+    // The sorts and the partitions ignore the height.
+    static constexpr auto FULL_NODE_HEIGHT_SHIFT = 60u;
+    static constexpr auto MORTON_CODE_POSITION_MASK = (1_u64 << FULL_NODE_HEIGHT_SHIFT) - 1_u64;
+
+    // The building steps, for the builders that gather the morton codes themselves
+    static void sort_morton_codes(std::span<uint64_t> morton_codes, uint8_t depth);
+    // Removes the duplicates and the morton codes inside a full node, and replaces each 64 full siblings by their full
+    // parent, up to max_height. The kept morton codes are moved to the front of sorted_morton_codes, returns their count.
+    [[nodiscard]] static size_t merge_full_nodes(std::span<uint64_t> sorted_morton_codes, uint32_t max_height);
+    // The morton codes must be merged by merge_full_nodes
+    [[nodiscard]] static std::vector<Tree64Node> build_contiguous_nodes_from_sorted(uint8_t depth,
+        std::span<uint64_t const> sorted_morton_codes);
+
+    MortonTree64Builder(uint8_t depth);
+
+    uint8_t depth() const;
+    std::vector<Tree64Node> build_contiguous_nodes();
+    [[nodiscard]] size_t peak_building_memory_size() const;
+
+    void add_voxel(glm::uvec3 const& voxel);
+    // Consecutive duplicates are skipped
+    void add_voxels(std::span<glm::uvec3 const> voxels);
+    // The full bricks take a single morton code, the others one per voxel, and the full bricks are merged into bigger
+    // full nodes when the morton codes are compacted
+    void add_brick_runs(std::span<VoxelBrickRun const> brick_runs);
+
+private:
+    static constexpr auto MIN_COMPACTED_MORTON_CODE_COUNT = size_t{ 1u } << 20u;
+
+    uint8_t m_depth;
+    std::vector<uint64_t> m_morton_codes;
+
+    void add_morton_code(uint64_t morton_code);
+    void compact_morton_codes();
+};
+
+}
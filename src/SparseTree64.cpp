@@ -0,0 +1,235 @@
+#include "SparseTree64.hpp"
+#include "MortonTree64Builder.hpp"
+#include "tree64_import.hpp"
+#include "tree64_addressing.hpp"
+
+#include <bit>
+#include <utility>
+#include <algorithm>
+
+namespace vp {
+
+std::optional<SparseTree64> SparseTree64::voxelize_model(std::filesystem::path const& path, uint32_t const max_side_voxel_count,
+    VoxelizationSettings const& settings) {
+    return voxelize_model_into<SparseTree64>(path, max_side_voxel_count, settings);
+}
+
+std::optional<SparseTree64> SparseTree64::import_vox(std::filesystem::path const& path) {
+    return import_vox_into<SparseTree64>(path);
+}
+
+SparseTree64::SparseTree64(uint8_t const depth) :
+    m_depth{ depth } {
+    assert(depth <= Tree64::MAX_DEPTH);
+}
+
+uint8_t SparseTree64::depth() const {
+    return m_depth;
+}
+
+std::vector<Tree64Node> SparseTree64::build_contiguous_nodes() const {
+    auto nodes = std::vector<Tree64Node>(1u);
+    auto const build = [&](auto const& self, Entry const& entry, uint64_t const morton_prefix, uint32_t const level,
+        size_t const node_index) -> void {
+        nodes[node_index].children_mask = entry.children_mask;
+        if (is_leaf(entry)) {
+            return;
+        }
+        auto child_index = std::size(nodes);
+        nodes[node_index].set_is_leaf(false);
+        nodes[node_index].set_first_child_node_index(absolute_first_child_node_index(child_index));
+        nodes.resize(child_index + static_cast<size_t>(std::popcount(entry.children_mask)));
+        for (auto children_mask = entry.children_mask; children_mask != 0_u64; children_mask &= children_mask - 1_u64) {
+            auto const child_morton_prefix = (morton_prefix << 6u) | static_cast<uint64_t>(std::countr_zero(children_mask));
+            auto const* const child_entry = find(key_of(child_morton_prefix, level + 1u));
+            assert(child_entry != nullptr);
+            self(self, *child_entry, child_morton_prefix, level + 1u, child_index);
+            child_index += 1u;
+        }
+    };
+    if (auto const* const root_entry = find(key_of(0u, 0u))) {
+        build(build, *root_entry, 0u, 0u, 0u);
+    }
+    return nodes;
+}
+
+size_t SparseTree64::peak_building_memory_size() const {
+    return sizeof(*this) + m_peak_capacity * sizeof(Entry);
+}
+
+void SparseTree64::add_voxel(glm::uvec3 const& voxel) {
+    auto const morton_code = MortonTree64Builder::morton_code(voxel, m_depth);
+    add_morton_code(morton_code, 0u, 1_u64 << (morton_code & 63_u64));
+}
+
+void SparseTree64::add_voxels(std::span<glm::uvec3 const> const voxels) {
+    for (auto const& voxel : voxels) {
+        auto const morton_code = MortonTree64Builder::morton_code(voxel, m_depth);
+        if (m_cached_path_level_count > 0u && morton_code == m_cached_path_morton_code) {
+            continue;
+        }
+        add_morton_code(morton_code, first_level_of(morton_code), 1_u64 << (morton_code & 63_u64));
+    }
+}
+
+void SparseTree64::add_brick_runs(std::span<VoxelBrickRun const> const brick_runs) {
+    for (auto const& brick_run : brick_runs) {
+        for (auto i = 0u; i < brick_run.brick_count; ++i) {
+            auto const brick = brick_run.first_brick + glm::uvec3(0u, i, 0u);
+            auto const morton_code = MortonTree64Builder::morton_code(brick * 4u, m_depth);
+            add_morton_code(morton_code, first_level_of(morton_code), brick_run.mask);
+        }
+    }
+}
+
+// The entries above the lowest common ancestor with the previous morton code already have the right bits
+uint32_t SparseTree64::first_level_of(uint64_t const morton_code) const {
+    if (m_cached_path_level_count == 0u) {
+        return 0u;
+    }
+    if (morton_code == m_cached_path_morton_code) {
+        return m_cached_path_level_count - 1u;
+    }
+    auto const highest_changed_bit = static_cast<uint32_t>(std::bit_width(morton_code ^ m_cached_path_morton_code)) - 1u;
+    return std::min(m_depth - 1u - highest_changed_bit / 6u, m_cached_path_level_count - 1u);
+}
+
+// The entries of the levels before first_level must exist, with their bit of the morton code set. leaf_mask is added to
+// the children of the parent of the leaves.
+void SparseTree64::add_morton_code(uint64_t const morton_code, uint32_t const first_level, uint64_t const leaf_mask) {
+    m_cached_path_morton_code = morton_code;
+    auto level = first_level;
+    while (true) {
+        auto const child_shift = (m_depth - 1u - level) * 6u;
+        auto const child_bit = 1_u64 << ((morton_code >> child_shift) & 63_u64);
+        auto& entry = find_or_insert(key_of(morton_code >> (child_shift + 6u), level));
+        if (level + 1u == m_depth) {
+            entry.children_mask |= leaf_mask;
+            m_cached_path_level_count = m_depth;
+            if (entry.children_mask != ~0_u64) {
+                return;
+            }
+            break;
+        }
+        if (is_leaf(entry) && entry.children_mask != 0_u64) {
+            if ((entry.children_mask & child_bit) != 0_u64) {
+                m_cached_path_level_count = level + 1u;
+                return; // already inside a merged full child
+            }
+            // Split the merged node, its children are full
+            auto const children_mask = entry.children_mask;
+            for (auto mask = children_mask; mask != 0_u64; mask &= mask - 1_u64) {
+                auto const child_morton_prefix = ((morton_code >> (child_shift + 6u)) << 6u) | static_cast<uint64_t>(std::countr_zero(mask));
+                auto& child_entry = find_or_insert(key_of(child_morton_prefix, level + 1u));
+                child_entry.children_mask = ~0_u64;
+                child_entry.full_children_mask = ~0_u64;
+            }
+            // the entry may have been moved by a rehash
+            find_or_insert(key_of(morton_code >> (child_shift + 6u), level)).children_mask |= child_bit;
+            level += 1u;
+            continue;
+        }
+        entry.children_mask |= child_bit;
+        level += 1u;
+    }
+    // Merge the ancestors whose children all became full leaves
+    while (level > 0u) {
+        level -= 1u;
+        auto const child_shift = (m_depth - 1u - level) * 6u;
+        auto const child_bit_index = (morton_code >> child_shift) & 63_u64;
+        auto& parent = find_or_insert(key_of(morton_code >> (child_shift + 6u), level));
+        parent.full_children_mask |= 1_u64 << child_bit_index;
+        if (parent.full_children_mask != parent.children_mask) {
+            break;
+        }
+        auto const parent_children_mask = parent.children_mask;
+        for (auto mask = parent_children_mask; mask != 0_u64; mask &= mask - 1_u64) {
+            erase(key_of(((morton_code >> (child_shift + 6u)) << 6u) | static_cast<uint64_t>(std::countr_zero(mask)), level + 1u));
+        }
+        m_cached_path_level_count = level + 1u;
+        if (parent_children_mask != ~0_u64) {
+            break;
+        }
+    }
+}
+
+uint64_t SparseTree64::key_of(uint64_t const morton_prefix, uint32_t const level) {
+    return (morton_prefix << 4u) | level;
+}
+
+size_t SparseTree64::home_index_of(uint64_t const key) const {
+    // Fibonacci hashing
+    auto const capacity_bit_count = static_cast<uint32_t>(std::countr_zero(std::size(m_entries)));
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15_u64) >> (64u - capacity_bit_count));
+}
+
+bool SparseTree64::is_leaf(Entry const& entry) const {
+    return (entry.key & 15_u64) + 1u == m_depth || entry.full_children_mask == entry.children_mask;
+}
+
+SparseTree64::Entry const* SparseTree64::find(uint64_t const key) const {
+    auto const index_mask = std::size(m_entries) - 1u;
+    for (auto index = home_index_of(key); m_entries[index].key != EMPTY_KEY; index = (index + 1u) & index_mask) {
+        if (m_entries[index].key == key) {
+            return &m_entries[index];
+        }
+    }
+    return nullptr;
+}
+
+SparseTree64::Entry& SparseTree64::find_or_insert(uint64_t const key) {
+    auto const index_mask = std::size(m_entries) - 1u;
+    auto index = home_index_of(key);
+    for (; m_entries[index].key != EMPTY_KEY; index = (index + 1u) & index_mask) {
+        if (m_entries[index].key == key) {
+            return m_entries[index];
+        }
+    }
+    // Keep the load factor under 3/4
+    if ((m_entry_count + 1u) * 4u > std::size(m_entries) * 3u) {
+        rehash(std::size(m_entries) * 2u);
+        return find_or_insert(key);
+    }
+    m_entry_count += 1u;
+    m_entries[index] = Entry{ .key = key };
+    return m_entries[index];
+}
+
+// Backward shift deletion, so that no tombstones are needed
+void SparseTree64::erase(uint64_t const key) {
+    auto const index_mask = std::size(m_entries) - 1u;
+    auto index = home_index_of(key);
+    while (m_entries[index].key != key) {
+        assert(m_entries[index].key != EMPTY_KEY);
+        index = (index + 1u) & index_mask;
+    }
+    for (auto next_index = (index + 1u) & index_mask; m_entries[next_index].key != EMPTY_KEY;
+        next_index = (next_index + 1u) & index_mask) {
+        auto const next_home_index = home_index_of(m_entries[next_index].key);
+        // Move the entry back unless its home is cyclically in ]index, next_index]
+        if (((next_index - next_home_index) & index_mask) >= ((next_index - index) & index_mask)) {
+            m_entries[index] = m_entries[next_index];
+            index = next_index;
+        }
+    }
+    m_entries[index] = Entry();
+    m_entry_count -= 1u;
+}
+
+void SparseTree64::rehash(size_t const capacity) {
+    auto entries = std::exchange(m_entries, std::vector<Entry>(capacity));
+    m_peak_capacity = std::max(m_peak_capacity, capacity + std::size(entries));
+    auto const index_mask = capacity - 1u;
+    for (auto const& entry : entries) {
+        if (entry.key == EMPTY_KEY) {
+            continue;
+        }
+        auto index = home_index_of(entry.key);
+        while (m_entries[index].key != EMPTY_KEY) {
+            index = (index + 1u) & index_mask;
+        }
+        m_entries[index] = entry;
+    }
+}
+
+}
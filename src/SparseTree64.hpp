@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Tree64.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <filesystem>
+#include <optional>
+#include <span>
+
+namespace vp {
+
+// Same interface and contiguous nodes as Tree64, but only the non-empty nodes are stored,
+// in a flat open addressing table keyed by their level and morton prefix
+class SparseTree64 {
+public:
+    [[nodiscard]] static std::optional<SparseTree64> voxelize_model(std::filesystem::path const& path, uint32_t max_side_voxel_count,
+        VoxelizationSettings const& settings = {});
+    [[nodiscard]] static std::optional<SparseTree64> import_vox(std::filesystem::path const& path);
+
+    SparseTree64(uint8_t depth);
+
+    uint8_t depth() const;
+    std::vector<Tree64Node> build_contiguous_nodes() const;
+    [[nodiscard]] size_t peak_building_memory_size() const;
+
+    void add_voxel(glm::uvec3 const& voxel);
+    // Consecutive duplicates are skipped and each voxel is inserted from the lowest common ancestor with the previous one
+    void add_voxels(std::span<glm::uvec3 const> voxels);
+    // Each brick is added to the children of a parent of leaves at once, the consecutive bricks of a run sharing the
+    // descent to their parent
+    void add_brick_runs(std::span<VoxelBrickRun const> brick_runs);
+
+private:
+    static constexpr auto EMPTY_KEY = ~0_u64;
+    static constexpr auto MIN_CAPACITY = size_t{ 1u } << 10u;
+
+    struct Entry {
+        uint64_t key = EMPTY_KEY; // morton prefix << 4 | level
+        uint64_t children_mask = 0u;
+        uint64_t full_children_mask = 0u; // children that are leaves with all their children, the node is merged when it equals children_mask
+    };
+
+    uint8_t m_depth;
+    std::vector<Entry> m_entries = std::vector<Entry>(MIN_CAPACITY);
+    size_t m_entry_count = 0u;
+    size_t m_peak_capacity = MIN_CAPACITY;
+    uint32_t m_cached_path_level_count = 0u; // levels of the previous voxel path from which an insertion can start
+    uint64_t m_cached_path_morton_code = 0u;
+
+    [[nodiscard]] static uint64_t key_of(uint64_t morton_prefix, uint32_t level);
+    [[nodiscard]] size_t home_index_of(uint64_t key) const;
+    [[nodiscard]] bool is_leaf(Entry const& entry) const;
+
+    [[nodiscard]] uint32_t first_level_of(uint64_t morton_code) const;
+    void add_morton_code(uint64_t morton_code, uint32_t first_level, uint64_t leaf_mask);
+
+    [[nodiscard]] Entry const* find(uint64_t key) const;
+    Entry& find_or_insert(uint64_t key);
+    void erase(uint64_t key);
+    void rehash(size_t capacity);
+};
+
+}
@@ -0,0 +1,384 @@
+#include "StreamingTree64Builder.hpp"
+#include "MortonTree64Builder.hpp"
+#include "tree64_import.hpp"
+#include "tree64_addressing.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <bit>
+#include <random>
+#include <string>
+#include <utility>
+#include <limits>
+
+namespace vp {
+
+static std::filesystem::path create_unique_directory(std::filesystem::path const& parent_directory) {
+    auto random_device = std::random_device();
+    while (true) {
+        auto const directory = parent_directory / ("vp_tree64_" + std::to_string(random_device()));
+        if (std::filesystem::create_directories(directory)) {
+            return directory;
+        }
+    }
+}
+
+template<typename Type>
+static void read_values(BinaryFstream& bf, uint64_t const first_value_index, std::span<Type> const values) {
+    bf.seekg(static_cast<std::streamoff>(first_value_index * sizeof(Type)));
+    bf.read(reinterpret_cast<char*>(std::data(values)), static_cast<std::streamsize>(std::size(values) * sizeof(Type)));
+}
+
+template<typename Type>
+static void write_values(BinaryFstream& bf, std::span<Type const> const values) {
+    bf.write(reinterpret_cast<char const*>(std::data(values)), static_cast<std::streamsize>(std::size(values) * sizeof(Type)));
+}
+
+std::optional<StreamingTree64Builder> StreamingTree64Builder::voxelize_model(std::filesystem::path const& path,
+    uint32_t const max_side_voxel_count, size_t const memory_budget, VoxelizationSettings const& settings) {
+    return voxelize_model_into<StreamingTree64Builder>(path, max_side_voxel_count, settings, memory_budget);
+}
+
+std::optional<StreamingTree64Builder> StreamingTree64Builder::import_vox(std::filesystem::path const& path,
+    size_t const memory_budget) {
+    return import_vox_into<StreamingTree64Builder>(path, memory_budget);
+}
+
+StreamingTree64Builder::StreamingTree64Builder(uint8_t const depth, size_t const memory_budget,
+    std::filesystem::path const& temporary_directory) :
+    m_depth{ depth },
+    m_memory_budget{ std::max(memory_budget, MIN_MEMORY_BUDGET) },
+    m_temporary_directory{ create_unique_directory(temporary_directory) },
+    m_morton_codes_file{ m_temporary_directory / "morton_codes.bin", std::ios::trunc },
+    m_nodes_file{ m_temporary_directory / "nodes.bin", std::ios::trunc } {
+    assert(depth <= Tree64::MAX_DEPTH);
+}
+
+StreamingTree64Builder::StreamingTree64Builder(StreamingTree64Builder&& other) noexcept :
+    m_depth{ other.m_depth },
+    m_memory_budget{ other.m_memory_budget },
+    m_peak_memory_size{ other.m_peak_memory_size },
+    m_temporary_directory{ std::exchange(other.m_temporary_directory, std::filesystem::path()) },
+    m_morton_codes_file{ std::move(other.m_morton_codes_file) },
+    m_nodes_file{ std::move(other.m_nodes_file) },
+    m_morton_codes{ std::move(other.m_morton_codes) },
+    m_runs{ std::move(other.m_runs) },
+    m_spilled_morton_code_count{ other.m_spilled_morton_code_count },
+    m_full_nodes_end_morton_code{ other.m_full_nodes_end_morton_code },
+    m_root_subtree{ std::move(other.m_root_subtree) } {
+}
+
+StreamingTree64Builder::~StreamingTree64Builder() {
+    if (m_temporary_directory.empty()) {
+        return;
+    }
+    m_morton_codes_file.close();
+    m_nodes_file.close();
+    auto error_code = std::error_code();
+    std::filesystem::remove_all(m_temporary_directory, error_code);
+}
+
+StreamingTree64Builder& StreamingTree64Builder::operator=(StreamingTree64Builder&& other) noexcept {
+    std::swap(m_depth, other.m_depth);
+    std::swap(m_memory_budget, other.m_memory_budget);
+    std::swap(m_peak_memory_size, other.m_peak_memory_size);
+    std::swap(m_temporary_directory, other.m_temporary_directory);
+    std::swap(m_morton_codes_file, other.m_morton_codes_file);
+    std::swap(m_nodes_file, other.m_nodes_file);
+    std::swap(m_morton_codes, other.m_morton_codes);
+    std::swap(m_runs, other.m_runs);
+    std::swap(m_spilled_morton_code_count, other.m_spilled_morton_code_count);
+    std::swap(m_full_nodes_end_morton_code, other.m_full_nodes_end_morton_code);
+    std::swap(m_root_subtree, other.m_root_subtree);
+    return *this;
+}
+
+uint8_t StreamingTree64Builder::depth() const {
+    return m_depth;
+}
+
+size_t StreamingTree64Builder::peak_building_memory_size() const {
+    return sizeof(*this) + m_peak_memory_size;
+}
+
+void StreamingTree64Builder::add_voxel(glm::uvec3 const& voxel) {
+    add_morton_code(MortonTree64Builder::morton_code(voxel, m_depth));
+}
+
+void StreamingTree64Builder::add_voxels(std::span<glm::uvec3 const> const voxels) {
+    for (auto const& voxel : voxels) {
+        auto const morton_code = MortonTree64Builder::morton_code(voxel, m_depth);
+        if (!std::empty(m_morton_codes) && m_morton_codes.back() == morton_code) {
+            continue;
+        }
+        add_morton_code(morton_code);
+    }
+}
+
+void StreamingTree64Builder::add_brick_runs(std::span<VoxelBrickRun const> const brick_runs) {
+    for (auto const& brick_run : brick_runs) {
+        for (auto i = 0u; i < brick_run.brick_count; ++i) {
+            auto const brick_morton_code = MortonTree64Builder::morton_code((brick_run.first_brick + glm::uvec3(0u, i, 0u)) * 4u,
+                m_depth);
+            if (brick_run.mask == ~0_u64) {
+                add_morton_code(brick_morton_code | (1_u64 << MortonTree64Builder::FULL_NODE_HEIGHT_SHIFT));
+                continue;
+            }
+            for (auto mask = brick_run.mask; mask != 0_u64; mask &= mask - 1_u64) {
+                add_morton_code(brick_morton_code | static_cast<uint64_t>(std::countr_zero(mask)));
+            }
+        }
+    }
+}
+
+bool StreamingTree64Builder::save_t64(std::filesystem::path const& path) {
+    if (!build_regions()) {
+        return false;
+    }
+    // The absolute addressing is kept whenever it fits, its traversal is faster
+    auto const addressing = 1u + m_root_subtree->rest_node_count > MAX_ABSOLUTE_ADDRESSING_NODE_COUNT
+        ? Tree64NodeAddressing::Relative : Tree64NodeAddressing::Absolute;
+    return vp::save_t64(path, m_depth, addressing, [&](Tree64NodesWriter const& nodes_writer, std::vector<uint64_t>& far_offsets) {
+        auto root = m_root_subtree->root;
+        if (!root.is_leaf()) {
+            set_first_child_node_index(root, 0u, 1u, addressing, far_offsets);
+        }
+        nodes_writer(std::span(&root, 1u));
+        m_nodes_file.clear();
+        m_nodes_file.seekg(0);
+        write_rest(*m_root_subtree, 1u, nodes_writer, addressing, far_offsets);
+        return static_cast<bool>(m_nodes_file);
+    });
+}
+
+void StreamingTree64Builder::add_morton_code(uint64_t const morton_code) {
+    assert(!m_root_subtree.has_value());
+    if (std::size(m_morton_codes) == m_morton_codes.capacity()) {
+        if (m_morton_codes.capacity() < max_buffered_morton_code_count()) {
+            m_morton_codes.reserve(std::clamp(m_morton_codes.capacity() * 2u, RUN_BLOCK_MORTON_CODE_COUNT,
+                max_buffered_morton_code_count()));
+        } else {
+            compact_morton_codes();
+        }
+    }
+    m_morton_codes.emplace_back(morton_code);
+}
+
+// Half of the budget is left for the sorting scratch memory
+size_t StreamingTree64Builder::max_buffered_morton_code_count() const {
+    return m_memory_budget / (2u * sizeof(uint64_t));
+}
+
+// Worst case of MortonTree64Builder::build_contiguous_nodes_from_sorted, where every morton code has its own nodes
+size_t StreamingTree64Builder::region_memory_size(uint64_t const morton_code_count, uint32_t const region_depth) const {
+    return static_cast<size_t>(morton_code_count) * (2u * sizeof(uint64_t) + 2u * region_depth * sizeof(Tree64Node));
+}
+
+void StreamingTree64Builder::update_peak_memory_size(size_t const memory_size) {
+    auto runs_memory_size = size_t{ 0u };
+    for (auto const& run : m_runs) {
+        runs_memory_size += (run.block_first_morton_codes.capacity() + run.cached_block.capacity()) * sizeof(uint64_t);
+    }
+    m_peak_memory_size = std::max(m_peak_memory_size, memory_size + runs_memory_size);
+}
+
+// Importers emit a lot of duplicated voxels, remove them and merge the full nodes before spilling
+void StreamingTree64Builder::compact_morton_codes() {
+    update_peak_memory_size(2u * m_morton_codes.capacity() * sizeof(uint64_t));
+    MortonTree64Builder::sort_morton_codes(m_morton_codes, m_depth);
+    m_morton_codes.resize(MortonTree64Builder::merge_full_nodes(m_morton_codes, m_depth));
+    if (std::size(m_morton_codes) > m_morton_codes.capacity() / 2u) {
+        spill_morton_codes();
+    }
+}
+
+// The morton codes must be merged by MortonTree64Builder::merge_full_nodes
+void StreamingTree64Builder::spill_morton_codes() {
+    auto run = SortedRun{
+        .first_morton_code_index = m_spilled_morton_code_count,
+        .morton_code_count = std::size(m_morton_codes),
+    };
+    for (auto i = size_t{ 0u }; i < std::size(m_morton_codes); i += RUN_BLOCK_MORTON_CODE_COUNT) {
+        run.block_first_morton_codes.emplace_back(m_morton_codes[i]);
+    }
+    m_runs.emplace_back(std::move(run));
+    write_values(m_morton_codes_file, std::span<uint64_t const>(m_morton_codes));
+    m_spilled_morton_code_count += std::size(m_morton_codes);
+    m_morton_codes.clear();
+}
+
+// Index in the run of the first morton code not less than morton_code, never before the run cursor. The runs are sorted
+// by the morton codes without their full node height.
+uint64_t StreamingTree64Builder::lower_bound(SortedRun& run, uint64_t const morton_code) {
+    if (run.cursor == run.morton_code_count) {
+        return run.cursor;
+    }
+    auto const position_of = [](uint64_t const code) {
+        return code & MortonTree64Builder::MORTON_CODE_POSITION_MASK;
+    };
+    auto const next_block = std::ranges::upper_bound(run.block_first_morton_codes, morton_code, {}, position_of);
+    if (next_block == std::begin(run.block_first_morton_codes)) {
+        return run.cursor;
+    }
+    auto const block_index = static_cast<uint64_t>(next_block - std::begin(run.block_first_morton_codes)) - 1u;
+    auto const block_first_morton_code_index = block_index * RUN_BLOCK_MORTON_CODE_COUNT;
+    if (run.cached_block_index != block_index) {
+        run.cached_block.resize(static_cast<size_t>(std::min(uint64_t{ RUN_BLOCK_MORTON_CODE_COUNT },
+            run.morton_code_count - block_first_morton_code_index)));
+        read_values(m_morton_codes_file, run.first_morton_code_index + block_first_morton_code_index,
+            std::span(run.cached_block));
+        run.cached_block_index = block_index;
+    }
+    auto const index_in_block = static_cast<uint64_t>(std::ranges::lower_bound(run.cached_block, morton_code, {}, position_of)
+        - std::begin(run.cached_block));
+    return std::max(block_first_morton_code_index + index_in_block, run.cursor);
+}
+
+bool StreamingTree64Builder::build_regions() {
+    if (m_root_subtree.has_value()) {
+        return true;
+    }
+    if (!std::empty(m_morton_codes)) {
+        update_peak_memory_size(2u * m_morton_codes.capacity() * sizeof(uint64_t));
+        MortonTree64Builder::sort_morton_codes(m_morton_codes, m_depth);
+        m_morton_codes.resize(MortonTree64Builder::merge_full_nodes(m_morton_codes, m_depth));
+        spill_morton_codes();
+    }
+    m_morton_codes = std::vector<uint64_t>();
+    m_morton_codes_file.flush();
+    m_root_subtree = build_region(0u, 0u);
+    if (!m_root_subtree.has_value()) {
+        m_root_subtree = Subtree();
+    }
+    m_nodes_file.flush();
+    if (!m_morton_codes_file || !m_nodes_file) {
+        std::cerr << "Cannot write the temporary files in " << m_temporary_directory << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// The regions are built in increasing morton order, so each run is read forward from its cursor
+std::optional<StreamingTree64Builder::Subtree> StreamingTree64Builder::build_region(uint32_t const level,
+    uint64_t const morton_prefix) {
+    auto const region_depth = m_depth - level;
+    auto const region_shift = region_depth * 6u;
+    auto const end_morton_code = (morton_prefix + 1u) << region_shift;
+    auto subtree = Subtree();
+    // The full nodes are aligned on their size, one that started in the previous regions covers the whole region
+    if ((morton_prefix << region_shift) < m_full_nodes_end_morton_code) {
+        for (auto& run : m_runs) {
+            run.cursor = lower_bound(run, end_morton_code);
+        }
+        subtree.root.children_mask = ~0_u64;
+        return subtree;
+    }
+    // Upper bound, the runs may share morton codes
+    auto morton_code_count = 0_u64;
+    for (auto& run : m_runs) {
+        morton_code_count += lower_bound(run, end_morton_code) - run.cursor;
+    }
+    if (morton_code_count == 0u) {
+        return std::nullopt;
+    }
+
+    if (region_depth > 1u && region_memory_size(morton_code_count, region_depth) > m_memory_budget) {
+        // Too big to be built at once, split it in the regions of its children
+        for (auto i = 0_u64; i < 64_u64; ++i) {
+            auto child_subtree = build_region(level + 1u, (morton_prefix << 6u) | i);
+            if (!child_subtree.has_value()) {
+                continue;
+            }
+            subtree.root.children_mask |= 1_u64 << i;
+            subtree.children.emplace_back(std::move(child_subtree.value()));
+        }
+        auto const can_merge = std::ranges::all_of(subtree.children, [](Subtree const& child_subtree) {
+            return child_subtree.root.is_leaf() && child_subtree.root.children_mask == ~0_u64;
+        });
+        if (can_merge) {
+            subtree.children.clear();
+            return subtree;
+        }
+        subtree.root.set_is_leaf(false);
+        subtree.rest_node_count = std::size(subtree.children);
+        for (auto const& child_subtree : subtree.children) {
+            subtree.rest_node_count += child_subtree.rest_node_count;
+        }
+        return subtree;
+    }
+
+    auto morton_codes = std::vector<uint64_t>();
+    morton_codes.reserve(static_cast<size_t>(morton_code_count));
+    for (auto& run : m_runs) {
+        auto const end = lower_bound(run, end_morton_code);
+        auto const first_index = std::size(morton_codes);
+        morton_codes.resize(first_index + static_cast<size_t>(end - run.cursor));
+        read_values(m_morton_codes_file, run.first_morton_code_index + run.cursor,
+            std::span(morton_codes).subspan(first_index));
+        run.cursor = end;
+    }
+    // The full nodes bigger than the region are cut to the region
+    auto const region_mask = (1_u64 << region_shift) - 1_u64;
+    for (auto& morton_code : morton_codes) {
+        auto const position = morton_code & MortonTree64Builder::MORTON_CODE_POSITION_MASK;
+        auto const height = static_cast<uint32_t>(morton_code >> MortonTree64Builder::FULL_NODE_HEIGHT_SHIFT);
+        if (height > 0u) {
+            m_full_nodes_end_morton_code = std::max(m_full_nodes_end_morton_code, position + (1_u64 << (height * 6u)));
+        }
+        morton_code = (position & region_mask)
+            | (static_cast<uint64_t>(std::min(height, region_depth)) << MortonTree64Builder::FULL_NODE_HEIGHT_SHIFT);
+    }
+    MortonTree64Builder::sort_morton_codes(morton_codes, static_cast<uint8_t>(region_depth));
+    morton_codes.resize(MortonTree64Builder::merge_full_nodes(morton_codes, region_depth));
+    auto const nodes = MortonTree64Builder::build_contiguous_nodes_from_sorted(static_cast<uint8_t>(region_depth), morton_codes);
+    update_peak_memory_size(region_memory_size(morton_code_count, region_depth));
+
+    // The rest keeps the node indices of the region, where it starts at 1
+    subtree.root = nodes[0];
+    subtree.rest_node_count = std::size(nodes) - 1u;
+    write_values(m_nodes_file, std::span(nodes).subspan(1u));
+    return subtree;
+}
+
+// The nodes file is read forward, since the regions were flushed in the same depth first order
+void StreamingTree64Builder::write_rest(Subtree const& subtree, uint64_t const rest_first_node_index,
+    Tree64NodesWriter const& nodes_writer, Tree64NodeAddressing const addressing, std::vector<uint64_t>& far_offsets) {
+    if (std::empty(subtree.children)) {
+        auto nodes = std::vector<Tree64Node>(static_cast<size_t>(std::min(uint64_t{ COPY_NODE_COUNT }, subtree.rest_node_count)));
+        for (auto node_index = 0_u64; node_index < subtree.rest_node_count; node_index += std::size(nodes)) {
+            auto const chunk_nodes = std::span(nodes).first(static_cast<size_t>(
+                std::min(uint64_t{ std::size(nodes) }, subtree.rest_node_count - node_index)));
+            m_nodes_file.read(reinterpret_cast<char*>(std::data(chunk_nodes)),
+                static_cast<std::streamsize>(chunk_nodes.size_bytes()));
+            for (auto i = size_t{ 0u }; i < std::size(chunk_nodes); ++i) {
+                auto& node = chunk_nodes[i];
+                if (!node.is_leaf()) {
+                    set_first_child_node_index(node, rest_first_node_index + node_index + i,
+                        node.first_child_node_index() - 1u + rest_first_node_index, addressing, far_offsets);
+                }
+            }
+            nodes_writer(chunk_nodes);
+        }
+        return;
+    }
+    auto children_roots = std::vector<Tree64Node>();
+    children_roots.reserve(std::size(subtree.children));
+    auto child_rest_first_node_index = rest_first_node_index + std::size(subtree.children);
+    for (auto const& child_subtree : subtree.children) {
+        auto child_root = child_subtree.root;
+        if (!child_root.is_leaf()) {
+            set_first_child_node_index(child_root, rest_first_node_index + std::size(children_roots),
+                child_rest_first_node_index, addressing, far_offsets);
+        }
+        children_roots.emplace_back(child_root);
+        child_rest_first_node_index += child_subtree.rest_node_count;
+    }
+    nodes_writer(children_roots);
+    child_rest_first_node_index = rest_first_node_index + std::size(subtree.children);
+    for (auto const& child_subtree : subtree.children) {
+        write_rest(child_subtree, child_rest_first_node_index, nodes_writer, addressing, far_offsets);
+        child_rest_first_node_index += child_subtree.rest_node_count;
+    }
+}
+
+}
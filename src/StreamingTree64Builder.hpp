@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Tree64.hpp"
+#include "t64.hpp"
+#include "BinaryFstream.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <filesystem>
+#include <optional>
+#include <span>
+
+namespace vp {
+
+// Produces the same nodes as MortonTree64Builder while keeping its memory usage under a budget, for the models that
+// do not fit in memory. The morton codes are spilled to sorted runs in a temporary file, the tree is then built one
+// region at a time, each region being flushed to a temporary nodes file, and the .t64 is assembled with index fix-ups.
+// The trees of more than 2^31 nodes are saved with Tree64NodeAddressing::Relative.
+class StreamingTree64Builder {
+public:
+    static constexpr auto MIN_MEMORY_BUDGET = size_t{ 1u } << 20u;
+
+    [[nodiscard]] static std::optional<StreamingTree64Builder> voxelize_model(std::filesystem::path const& path,
+        uint32_t max_side_voxel_count, size_t memory_budget, VoxelizationSettings const& settings = {});
+    [[nodiscard]] static std::optional<StreamingTree64Builder> import_vox(std::filesystem::path const& path, size_t memory_budget);
+
+    StreamingTree64Builder(uint8_t depth, size_t memory_budget,
+        std::filesystem::path const& temporary_directory = std::filesystem::temp_directory_path());
+    StreamingTree64Builder(StreamingTree64Builder&& other) noexcept;
+    StreamingTree64Builder(StreamingTree64Builder const& other) = delete;
+    ~StreamingTree64Builder();
+
+    StreamingTree64Builder& operator=(StreamingTree64Builder&& other) noexcept;
+    StreamingTree64Builder& operator=(StreamingTree64Builder const& other) = delete;
+
+    uint8_t depth() const;
+    [[nodiscard]] size_t peak_building_memory_size() const;
+
+    void add_voxel(glm::uvec3 const& voxel);
+    // Consecutive duplicates are skipped
+    void add_voxels(std::span<glm::uvec3 const> voxels);
+    // The full bricks take a single morton code, the others one per voxel, and the full bricks are merged into bigger
+    // full nodes before being spilled
+    void add_brick_runs(std::span<VoxelBrickRun const> brick_runs);
+
+    // The nodes are streamed to the file, they never are all in memory
+    [[nodiscard]] bool save_t64(std::filesystem::path const& path);
+
+private:
+    static constexpr auto RUN_BLOCK_MORTON_CODE_COUNT = size_t{ 512u };
+    static constexpr auto COPY_NODE_COUNT = size_t{ 1u } << 14u;
+
+    // Sorted and deduplicated morton codes stored in the morton codes file
+    struct SortedRun {
+        uint64_t first_morton_code_index;
+        uint64_t morton_code_count;
+        std::vector<uint64_t> block_first_morton_codes; // to find a morton code reading a single block
+        uint64_t cursor = 0u; // the morton codes before it belong to the regions already built
+        uint64_t cached_block_index = ~0_u64;
+        std::vector<uint64_t> cached_block;
+    };
+
+    // The rest of a subtree is its nodes after its root, in the contiguous order. It is in the nodes file when the
+    // subtree was built at once, otherwise it is made of the children roots followed by the rest of each child
+    struct Subtree {
+        Tree64Node root;
+        uint64_t rest_node_count = 0u;
+        std::vector<Subtree> children;
+    };
+
+    uint8_t m_depth;
+    size_t m_memory_budget;
+    size_t m_peak_memory_size = 0u;
+    std::filesystem::path m_temporary_directory;
+    BinaryFstream m_morton_codes_file;
+    BinaryFstream m_nodes_file;
+    std::vector<uint64_t> m_morton_codes;
+    std::vector<SortedRun> m_runs;
+    uint64_t m_spilled_morton_code_count = 0u;
+    // The end of the full nodes read by the regions built so far, a full node may cover the next regions
+    uint64_t m_full_nodes_end_morton_code = 0u;
+    std::optional<Subtree> m_root_subtree;
+
+    [[nodiscard]] size_t max_buffered_morton_code_count() const;
+    [[nodiscard]] size_t region_memory_size(uint64_t morton_code_count, uint32_t region_depth) const;
+    void update_peak_memory_size(size_t memory_size);
+
+    void add_morton_code(uint64_t morton_code);
+    void compact_morton_codes();
+    void spill_morton_codes();
+    [[nodiscard]] uint64_t lower_bound(SortedRun& run, uint64_t morton_code);
+
+    [[nodiscard]] bool build_regions();
+    [[nodiscard]] std::optional<Subtree> build_region(uint32_t level, uint64_t morton_prefix);
+    void write_rest(Subtree const& subtree, uint64_t rest_first_node_index, Tree64NodesWriter const& nodes_writer,
+        Tree64NodeAddressing addressing, std::vector<uint64_t>& far_offsets);
+};
+
+}
@@ -1,55 +1,69 @@
 #include "Tree64.hpp"
-#include "math.hpp"
-#include "filesystem.hpp"
-#include "vox.hpp"
-#include "voxelizer.hpp"
-
-#include <glm/gtx/component_wise.hpp>
+#include "MortonTree64Builder.hpp"
+#include "tree64_import.hpp"
+#include "tree64_addressing.hpp"
 
 #include <array>
-#include <iostream>
+#include <bit>
 #include <algorithm>
+#include <utility>
 
 namespace vp {
 
-std::optional<Tree64> Tree64::voxelize_model(std::filesystem::path const& path, uint32_t const max_side_voxel_count) {
-    auto const depth = divide_ceil(static_cast<uint8_t>(std::bit_width(max_side_voxel_count - 1u)), uint8_t{ 2u });
-    if (depth > MAX_DEPTH) {
-        std::cerr << "Exceeded the max voxel size " << 1u << (MAX_DEPTH * 2u) << std::endl;
-        return std::nullopt;
+BuildingTree64NodePool::BuildingTree64NodePool(BuildingTree64NodePool&& other) noexcept :
+    m_chunks{ std::move(other.m_chunks) },
+    m_next_chunk_block_index{ std::exchange(other.m_next_chunk_block_index, CHUNK_BLOCK_COUNT) },
+    m_first_free_block{ std::exchange(other.m_first_free_block, nullptr) },
+    m_used_block_count{ std::exchange(other.m_used_block_count, 0u) } {
+}
+
+BuildingTree64NodePool& BuildingTree64NodePool::operator=(BuildingTree64NodePool&& other) noexcept {
+    m_chunks = std::move(other.m_chunks);
+    m_next_chunk_block_index = std::exchange(other.m_next_chunk_block_index, CHUNK_BLOCK_COUNT);
+    m_first_free_block = std::exchange(other.m_first_free_block, nullptr);
+    m_used_block_count = std::exchange(other.m_used_block_count, 0u);
+    return *this;
+}
+
+BuildingTree64Node* BuildingTree64NodePool::allocate_block() {
+    m_used_block_count += 1u;
+    if (m_first_free_block != nullptr) {
+        return std::exchange(m_first_free_block, m_first_free_block->children);
     }
-    auto tree64 = Tree64(depth);
-    auto const success = ::voxelize_model(path, max_side_voxel_count, [&](glm::uvec3 const& voxel) {
-        tree64.add_voxel(voxel);
-    });
-    if (!success) {
-        return std::nullopt;
+    if (m_next_chunk_block_index == CHUNK_BLOCK_COUNT) {
+        m_chunks.emplace_back(std::make_unique<BuildingTree64Node[]>(CHUNK_BLOCK_COUNT * BLOCK_NODE_COUNT));
+        m_next_chunk_block_index = 0u;
     }
-    return tree64;
+    auto* const block = &m_chunks.back()[m_next_chunk_block_index * BLOCK_NODE_COUNT];
+    m_next_chunk_block_index += 1u;
+    return block;
+}
+
+void BuildingTree64NodePool::free_block(BuildingTree64Node* const block) {
+    m_used_block_count -= 1u;
+    block->children = std::exchange(m_first_free_block, block);
+}
+
+size_t BuildingTree64NodePool::used_block_count() const {
+    return m_used_block_count;
+}
+
+// Chunks are never released before destruction, so the allocated size is the peak size
+size_t BuildingTree64NodePool::peak_memory_size() const {
+    return std::size(m_chunks) * CHUNK_BLOCK_COUNT * BLOCK_NODE_COUNT * sizeof(BuildingTree64Node);
+}
+
+std::optional<Tree64> Tree64::voxelize_model(std::filesystem::path const& path, uint32_t const max_side_voxel_count,
+    VoxelizationSettings const& settings) {
+    return voxelize_model_into<Tree64>(path, max_side_voxel_count, settings);
 }
 
 std::optional<Tree64> Tree64::import_vox(std::filesystem::path const& path) {
-    std::optional<Tree64> tree64;
-    auto const success = ::import_vox(path, [&](glm::uvec3 const& vox_full_size) {
-        auto const max = glm::max(4u, glm::compMax(vox_full_size));
-        auto depth = divide_ceil(static_cast<uint8_t>(std::bit_width(max - 1u)), uint8_t{ 2u });
-        if (depth > Tree64::MAX_DEPTH) {
-            std::cerr << "Vox \"" << string_from(path) << "\" exceeds the max voxel size " << 1u << (MAX_DEPTH * 2u) << std::endl;
-            return false;
-        }
-        tree64 = Tree64(depth);
-        return true;
-    }, [&](glm::uvec3 const& voxel) {
-        tree64->add_voxel(voxel);
-    });
-    if (!success) {
-        return std::nullopt;
-    }
-    return tree64;
+    return import_vox_into<Tree64>(path);
 }
 
-Tree64::Tree64(uint8_t depth) :
-    m_depth{ depth } {
+Tree64::Tree64(uint8_t depth, bool const merges_incrementally) :
+    m_depth{ depth }, m_merges_incrementally{ merges_incrementally } {
     assert(depth <= MAX_DEPTH);
 }
 
@@ -57,17 +71,24 @@ uint8_t Tree64::depth() const {
     return m_depth;
 }
 
-std::vector<Tree64Node> Tree64::build_contiguous_nodes() const {
+size_t Tree64::peak_building_memory_size() const {
+    return sizeof(*this) + m_building_node_pool.peak_memory_size();
+}
+
+std::vector<Tree64Node> Tree64::build_contiguous_nodes() {
+    if (!m_merges_incrementally) {
+        merge_uniform_subtrees();
+    }
     auto nodes = std::vector<Tree64Node>(1u);
     auto const build = [&](auto const& self, BuildingTree64Node const& building_node, Tree64Node& node) -> void {
         node.children_mask = building_node.children_mask;
         node.set_is_leaf(building_node.is_leaf());
         auto child_index = std::size(nodes);
         if (!node.is_leaf()) {
-            node.set_first_child_node_index(static_cast<uint32_t>(child_index));
+            node.set_first_child_node_index(absolute_first_child_node_index(child_index));
             nodes.resize(child_index + static_cast<size_t>(std::popcount(building_node.children_mask)));
         }
-        for (auto const& building_child : building_node.children) {
+        for (auto const& building_child : building_node.children_span()) {
             if (building_child.children_mask == 0u) {
                 continue;
             }
@@ -80,52 +101,98 @@ std::vector<Tree64Node> Tree64::build_contiguous_nodes() const {
 }
 
 void Tree64::add_voxel(glm::uvec3 const& voxel) {
-    auto half_size = (1u << (m_depth * 2u)) / 2u;
-    auto post_center = glm::uvec3(half_size);
-    auto hierarchy_index = 0u;
-    auto nodes_hierarchy = std::array<BuildingTree64Node*, MAX_DEPTH>{ { &m_root_building_node } };
+    add_voxels(std::span(&voxel, 1u));
+}
+
+void Tree64::add_voxels(std::span<glm::uvec3 const> const voxels) {
+    for (auto const& voxel : voxels) {
+        auto const morton_code = MortonTree64Builder::morton_code(voxel, m_depth);
+        if (m_cached_path_node_count > 0u && morton_code == m_cached_path_morton_code) {
+            continue;
+        }
+        add_leaf_mask(morton_code, 1_u64 << (morton_code & 63_u64));
+    }
+}
+
+void Tree64::add_brick_runs(std::span<VoxelBrickRun const> const brick_runs) {
+    for (auto const& brick_run : brick_runs) {
+        for (auto i = 0u; i < brick_run.brick_count; ++i) {
+            auto const brick = brick_run.first_brick + glm::uvec3(0u, i, 0u);
+            add_leaf_mask(MortonTree64Builder::morton_code(brick * 4u, m_depth), brick_run.mask);
+        }
+    }
+}
+
+// Adds leaf_mask to the children of the parent of the leaves on the path of morton_code
+void Tree64::add_leaf_mask(uint64_t const morton_code, uint64_t const leaf_mask) {
+    auto level = 0u;
+    if (m_cached_path_node_count > 0u) {
+        // Descend from the lowest common ancestor with the previous morton code
+        auto const highest_changed_bit = static_cast<uint32_t>(std::bit_width(morton_code ^ m_cached_path_morton_code)) - 1u;
+        level = morton_code == m_cached_path_morton_code ? m_cached_path_node_count - 1u
+            : std::min(m_depth - 1u - highest_changed_bit / 6u, m_cached_path_node_count - 1u);
+    }
+    m_cached_path_morton_code = morton_code;
     while (true) {
-        auto& node = *nodes_hierarchy[hierarchy_index];
-        auto child_index = 0u
-            | static_cast<uint32_t>(voxel.x >= post_center.x) * 2u
-            | static_cast<uint32_t>(voxel.y >= post_center.y) * 32u
-            | static_cast<uint32_t>(voxel.z >= post_center.z) * 8u;
-        half_size /= 2u;
-        post_center += half_size * (glm::uvec3(child_index & 2u, (child_index & 32u) >> 4u, (child_index & 8u) >> 2u) - 1u);
-        child_index |= 0u
-            | static_cast<uint32_t>(voxel.x >= post_center.x) * 1u
-            | static_cast<uint32_t>(voxel.y >= post_center.y) * 16u
-            | static_cast<uint32_t>(voxel.z >= post_center.z) * 4u;
-        if (half_size == 1u) {
-            node.children_mask |= (1_u64 << child_index);
+        auto& node = level == 0u ? m_root_building_node : *m_cached_path[level];
+        auto const child_index = (morton_code >> ((m_depth - 1u - level) * 6u)) & 63_u64;
+        if (level + 1u == m_depth) {
+            node.children_mask |= leaf_mask;
             break;
         }
-        half_size /= 2u;
-        post_center += half_size * (glm::uvec3((child_index & 1u) * 2u, (child_index & 16u) >> 3u, (child_index & 4u) >> 1u) - 1u);
         if (node.is_leaf()) {
-            node.children.resize(64u);
+            node.children = m_building_node_pool.allocate_block();
             for (auto i = 0_u64; i < 64_u64; ++i) {
-                node.children[i].children_mask = (node.children_mask & (1_u64 << i)) != 0_u64 ? ~0_u64 : 0_u64;
+                node.children[i] = BuildingTree64Node{
+                    .children_mask = (node.children_mask & (1_u64 << i)) != 0_u64 ? ~0_u64 : 0_u64,
+                };
             }
         }
         node.children_mask |= (1_u64 << child_index);
-        hierarchy_index += 1u;
-        nodes_hierarchy[hierarchy_index] = &node.children[child_index];
+        level += 1u;
+        m_cached_path[level] = &node.children[child_index];
     }
-    if (nodes_hierarchy[hierarchy_index]->children_mask != ~0_u64) {
+    m_cached_path_node_count = level + 1u;
+    // The full bricks are merged even without m_merges_incrementally, so that the filled interiors keep few nodes
+    if (!(m_merges_incrementally || leaf_mask == ~0_u64)
+        || (level == 0u ? m_root_building_node : *m_cached_path[level]).children_mask != ~0_u64) {
         return;
     }
-    while (hierarchy_index > 0u) {
-        hierarchy_index -= 1u;
-        auto& parent = *nodes_hierarchy[hierarchy_index];
-        auto const can_merge = std::ranges::all_of(parent.children, [](BuildingTree64Node const& node) {
+    while (level > 0u) {
+        level -= 1u;
+        auto& parent = level == 0u ? m_root_building_node : *m_cached_path[level];
+        // Without m_merges_incrementally, a parent is only merged once full, the next brick would split it again otherwise
+        if (!m_merges_incrementally && parent.children_mask != ~0_u64) {
+            break;
+        }
+        auto const can_merge = std::ranges::all_of(parent.children_span(), [](BuildingTree64Node const& node) {
             return node.is_leaf() && (node.children_mask == 0_u64 || node.children_mask == ~0_u64);
         });
         if (!can_merge) {
             break;
         }
-        parent.children = std::vector<BuildingTree64Node>();
+        m_building_node_pool.free_block(std::exchange(parent.children, nullptr));
+        m_cached_path_node_count = level + 1u;
     }
 }
 
+void Tree64::merge_uniform_subtrees() {
+    auto const merge = [&](auto const& self, BuildingTree64Node& node) -> void {
+        if (node.is_leaf()) {
+            return;
+        }
+        for (auto& child : std::span(node.children, BuildingTree64NodePool::BLOCK_NODE_COUNT)) {
+            self(self, child);
+        }
+        auto const can_merge = std::ranges::all_of(node.children_span(), [](BuildingTree64Node const& child) {
+            return child.is_leaf() && (child.children_mask == 0_u64 || child.children_mask == ~0_u64);
+        });
+        if (can_merge) {
+            m_building_node_pool.free_block(std::exchange(node.children, nullptr));
+        }
+    };
+    merge(merge, m_root_building_node);
+    m_cached_path_node_count = 0u;
+}
+
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "voxelizer.hpp"
+
 #include <glm/glm.hpp>
 
 #include <cstdint>
@@ -7,6 +9,8 @@
 #include <span>
 #include <filesystem>
 #include <optional>
+#include <memory>
+#include <array>
 
 namespace vp {
 
@@ -17,7 +21,8 @@ consteval uint64_t operator""_u64(unsigned long long const value) {
 #pragma pack(push, 1)
 struct Tree64Node {
     uint64_t children_mask = 0u; // (1 0 0) -> 0b1, (0 0 1) -> 0b10000, (0 1 0) -> 0b1'00000000'00000000
-    uint32_t is_leaf_and_first_child_node_index = 1u; // least significant bit -> is_leaf, 31 other bits -> first_child_node_index
+    // least significant bit -> is_leaf, 31 other bits -> first_child_node_index, or see Tree64NodeAddressing::Relative
+    uint32_t is_leaf_and_first_child_node_index = 1u;
 
     [[nodiscard]] bool is_leaf() const {
         return (is_leaf_and_first_child_node_index & 1u) == 1u;
@@ -37,37 +42,96 @@ struct Tree64Node {
 };
 #pragma pack(pop)
 
+enum class Tree64NodeAddressing : uint8_t {
+    Absolute, // first_child_node_index, for the trees of at most 2^31 nodes
+    // The 31 bits after is_leaf are a far bit followed by 30 bits holding the offset from the node to its first child,
+    // or when the far bit is set the index of the 64 bits offset in the far offsets
+    Relative,
+};
+
 struct ContiguousTree64 {
     uint8_t depth;
     std::vector<Tree64Node> nodes;
+    Tree64NodeAddressing addressing = Tree64NodeAddressing::Absolute;
+    std::vector<uint64_t> far_offsets; // only with Tree64NodeAddressing::Relative
+    std::vector<uint64_t> leaf_masks; // only with inlined leaf masks, see inline_leaf_masks
 };
 
 struct BuildingTree64Node {
     uint64_t children_mask = 0u; // (1 0 0) -> 0b1, (0 0 1) -> 0b10000, (0 1 0) -> 0b1'00000000'00000000
-    std::vector<BuildingTree64Node> children;
+    BuildingTree64Node* children = nullptr; // block of 64 children allocated by a BuildingTree64NodePool
 
     [[nodiscard]] bool is_leaf() const {
-        return std::empty(children);
+        return children == nullptr;
+    }
+
+    [[nodiscard]] std::span<BuildingTree64Node const> children_span() const {
+        return is_leaf() ? std::span<BuildingTree64Node const>() : std::span<BuildingTree64Node const>(children, 64u);
     }
 };
 
+// Hands out fixed blocks of 64 building nodes carved out of big chunks, the chunks are only released on destruction
+class BuildingTree64NodePool {
+public:
+    static constexpr auto BLOCK_NODE_COUNT = 64u;
+
+    BuildingTree64NodePool() = default;
+    BuildingTree64NodePool(BuildingTree64NodePool const& other) = delete;
+    BuildingTree64NodePool(BuildingTree64NodePool&& other) noexcept;
+
+    BuildingTree64NodePool& operator=(BuildingTree64NodePool const& other) = delete;
+    BuildingTree64NodePool& operator=(BuildingTree64NodePool&& other) noexcept;
+
+    [[nodiscard]] BuildingTree64Node* allocate_block();
+    void free_block(BuildingTree64Node* block);
+
+    [[nodiscard]] size_t used_block_count() const;
+    [[nodiscard]] size_t peak_memory_size() const;
+
+private:
+    static constexpr auto CHUNK_BLOCK_COUNT = 1024u;
+
+    std::vector<std::unique_ptr<BuildingTree64Node[]>> m_chunks;
+    size_t m_next_chunk_block_index = CHUNK_BLOCK_COUNT;
+    BuildingTree64Node* m_first_free_block = nullptr; // free blocks are linked through the children of their first node
+    size_t m_used_block_count = 0u;
+};
+
 class Tree64 {
 public:
-    static constexpr auto MAX_DEPTH = uint8_t{ 11u - 4u }; // must match traversal shaders
+    // 60 bits morton codes, and the traversal shaders use 20 of the 23 mantissa bits of the positions, must match them
+    static constexpr auto MAX_DEPTH = uint8_t{ 10u };
 
-    [[nodiscard]] static std::optional<Tree64> voxelize_model(std::filesystem::path const& path, uint32_t max_side_voxel_count);
+    [[nodiscard]] static std::optional<Tree64> voxelize_model(std::filesystem::path const& path, uint32_t max_side_voxel_count,
+        VoxelizationSettings const& settings = {});
     [[nodiscard]] static std::optional<Tree64> import_vox(std::filesystem::path const& path);
 
-    Tree64(uint8_t depth);
+    // Uniform subtrees are merged once before flattening, unless merging incrementally on every add_voxel for editing
+    Tree64(uint8_t depth, bool merges_incrementally = false);
 
     uint8_t depth() const;
-    std::vector<Tree64Node> build_contiguous_nodes() const;
+    std::vector<Tree64Node> build_contiguous_nodes();
+    [[nodiscard]] size_t peak_building_memory_size() const;
 
     void add_voxel(glm::uvec3 const& voxel);
+    // Consecutive duplicates are skipped and each voxel is inserted from the lowest common ancestor with the previous one
+    void add_voxels(std::span<glm::uvec3 const> voxels);
+    // Each brick is added to the children of a parent of leaves at once, the consecutive bricks of a run sharing the
+    // descent to their parent. The subtrees filled by the full bricks are merged as they complete.
+    void add_brick_runs(std::span<VoxelBrickRun const> brick_runs);
+    void merge_uniform_subtrees();
 
 private:
     uint8_t m_depth;
+    bool m_merges_incrementally;
+    BuildingTree64NodePool m_building_node_pool;
     BuildingTree64Node m_root_building_node;
+    // Nodes from the root to the previous voxel, the root one is m_root_building_node which moves with the tree
+    std::array<BuildingTree64Node*, MAX_DEPTH> m_cached_path = {};
+    uint32_t m_cached_path_node_count = 0u;
+    uint64_t m_cached_path_morton_code = 0u;
+
+    void add_leaf_mask(uint64_t morton_code, uint64_t leaf_mask);
 };
 
 }
@@ -0,0 +1,238 @@
+#include "Tree64Editor.hpp"
+#include "tree64_addressing.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <utility>
+
+namespace vp {
+
+static constexpr auto FULL_LEAF_NODE = Tree64Node{ .children_mask = ~0_u64 };
+
+Tree64Editor::Tree64Editor(ContiguousTree64 contiguous_tree64) :
+    m_contiguous_tree64{ std::move(contiguous_tree64) } {
+}
+
+ContiguousTree64 const& Tree64Editor::contiguous_tree64() const {
+    return m_contiguous_tree64;
+}
+
+size_t Tree64Editor::unused_node_count() const {
+    return m_unused_node_count;
+}
+
+void Tree64Editor::set_voxel(glm::uvec3 const& voxel) {
+    fill_box(voxel, voxel, true);
+}
+
+void Tree64Editor::clear_voxel(glm::uvec3 const& voxel) {
+    fill_box(voxel, voxel, false);
+}
+
+void Tree64Editor::fill_box(glm::uvec3 const& min, glm::uvec3 const& max, bool const is_solid) {
+    auto const clamped_max = glm::min(max, glm::uvec3((1u << (m_contiguous_tree64.depth * 2u)) - 1u));
+    if (glm::any(glm::greaterThan(min, clamped_max))) {
+        return;
+    }
+    auto& nodes = m_contiguous_tree64.nodes;
+    auto const node_count = std::size(nodes);
+    auto const changed_node_index_count = std::size(m_changed_node_indices);
+    auto const unused_node_count = m_unused_node_count;
+    m_overwritten_nodes.clear();
+    m_sibling_group_changes.clear();
+    try {
+        auto root = nodes[0];
+        fill(root, 0u, glm::uvec3(0u), min, clamped_max, is_solid);
+        write_node(0u, root);
+    } catch (std::length_error const&) {
+        for (auto it = std::rbegin(m_overwritten_nodes); it != std::rend(m_overwritten_nodes); ++it) {
+            nodes[it->first] = it->second;
+        }
+        for (auto it = std::rbegin(m_sibling_group_changes); it != std::rend(m_sibling_group_changes); ++it) {
+            auto& free_sibling_groups = m_free_sibling_groups[it->node_count - 1u];
+            if (it->is_freed) {
+                free_sibling_groups.pop_back();
+            } else {
+                free_sibling_groups.emplace_back(it->first_node_index);
+            }
+        }
+        nodes.resize(node_count);
+        m_changed_node_indices.resize(changed_node_index_count);
+        m_unused_node_count = unused_node_count;
+        throw;
+    }
+}
+
+std::vector<Tree64NodeRange> Tree64Editor::take_changed_node_ranges() {
+    std::ranges::sort(m_changed_node_indices);
+    auto const duplicates = std::ranges::unique(m_changed_node_indices);
+    m_changed_node_indices.erase(std::begin(duplicates), std::end(duplicates));
+    auto changed_node_ranges = std::vector<Tree64NodeRange>();
+    for (auto const node_index : m_changed_node_indices) {
+        if (!std::empty(changed_node_ranges)
+            && changed_node_ranges.back().first_node_index + changed_node_ranges.back().node_count == node_index) {
+            changed_node_ranges.back().node_count += 1u;
+        } else {
+            changed_node_ranges.emplace_back(Tree64NodeRange{ .first_node_index = node_index, .node_count = 1u });
+        }
+    }
+    m_changed_node_indices.clear();
+    return changed_node_ranges;
+}
+
+// node is a copy, written back by the caller once its children group is updated
+void Tree64Editor::fill(Tree64Node& node, uint32_t const level, glm::uvec3 const& node_min,
+    glm::uvec3 const& min, glm::uvec3 const& max, bool const is_solid) {
+    auto const child_side = 1u << ((m_contiguous_tree64.depth - 1u - level) * 2u);
+    auto const child_min_of = [&](uint32_t const bit_index) {
+        return node_min + glm::uvec3(bit_index & 3u, bit_index >> 4u, (bit_index >> 2u) & 3u) * child_side;
+    };
+    auto const first_child = (glm::max(min, node_min) - node_min) / child_side;
+    auto const last_child = (glm::min(max, node_min + (child_side * 4u - 1u)) - node_min) / child_side;
+    auto covered_mask = 0_u64;
+    auto partial_mask = 0_u64;
+    for (auto y = first_child.y; y <= last_child.y; ++y) {
+        for (auto z = first_child.z; z <= last_child.z; ++z) {
+            for (auto x = first_child.x; x <= last_child.x; ++x) {
+                auto const bit_index = x + 4u * z + 16u * y;
+                auto const child_min = child_min_of(bit_index);
+                auto const is_covered = glm::all(glm::greaterThanEqual(child_min, min))
+                    && glm::all(glm::lessThanEqual(child_min + (child_side - 1u), max));
+                (is_covered ? covered_mask : partial_mask) |= 1_u64 << bit_index;
+            }
+        }
+    }
+    if (level + 1u == m_contiguous_tree64.depth) {
+        node.children_mask = is_solid ? node.children_mask | covered_mask : node.children_mask & ~covered_mask;
+        return;
+    }
+
+    // The bits of a leaf are full children
+    auto const& nodes = m_contiguous_tree64.nodes;
+    auto const previous_first_child_node_index = node.first_child_node_index();
+    auto const previous_child_count = node.is_leaf() ? 0u : static_cast<uint32_t>(std::popcount(node.children_mask));
+    auto children = std::array<Tree64Node, 64u>();
+    auto child_index = 0u;
+    for (auto mask = node.children_mask; mask != 0_u64; mask &= mask - 1_u64) {
+        children[std::countr_zero(mask)] = node.is_leaf() ? FULL_LEAF_NODE : nodes[previous_first_child_node_index + child_index];
+        child_index += 1u;
+    }
+
+    auto children_mask = node.children_mask;
+    for (auto mask = covered_mask; mask != 0_u64; mask &= mask - 1_u64) {
+        auto const bit_index = static_cast<uint32_t>(std::countr_zero(mask));
+        if ((children_mask & (1_u64 << bit_index)) != 0_u64) {
+            free_subtree(children[bit_index]);
+        }
+        if (is_solid) {
+            children[bit_index] = FULL_LEAF_NODE;
+            children_mask |= 1_u64 << bit_index;
+        } else {
+            children_mask &= ~(1_u64 << bit_index);
+        }
+    }
+    for (auto mask = partial_mask; mask != 0_u64; mask &= mask - 1_u64) {
+        auto const bit_index = static_cast<uint32_t>(std::countr_zero(mask));
+        auto& child = children[bit_index];
+        if ((children_mask & (1_u64 << bit_index)) == 0_u64) {
+            if (!is_solid) {
+                continue;
+            }
+            child = Tree64Node();
+            children_mask |= 1_u64 << bit_index;
+        } else if (is_solid && child.is_leaf() && child.children_mask == ~0_u64) {
+            continue;
+        }
+        fill(child, level + 1u, child_min_of(bit_index), min, max, is_solid);
+        if (child.children_mask == 0_u64) {
+            children_mask &= ~(1_u64 << bit_index);
+        }
+    }
+
+    // Same merging rule as the builders : a node whose children all are full leaves becomes a leaf
+    auto can_merge = true;
+    for (auto mask = children_mask; mask != 0_u64; mask &= mask - 1_u64) {
+        auto const& child = children[std::countr_zero(mask)];
+        can_merge = can_merge && child.is_leaf() && child.children_mask == ~0_u64;
+    }
+    if (can_merge) {
+        if (previous_child_count > 0u) {
+            free_sibling_group(previous_first_child_node_index, previous_child_count);
+        }
+        node = Tree64Node{ .children_mask = children_mask };
+        return;
+    }
+    auto const child_count = static_cast<uint32_t>(std::popcount(children_mask));
+    auto first_child_node_index = previous_first_child_node_index;
+    if (child_count > previous_child_count) {
+        if (previous_child_count > 0u) {
+            free_sibling_group(previous_first_child_node_index, previous_child_count);
+        }
+        first_child_node_index = allocate_sibling_group(child_count);
+    } else if (child_count < previous_child_count) {
+        free_sibling_group(previous_first_child_node_index + child_count, previous_child_count - child_count);
+    }
+    child_index = 0u;
+    for (auto mask = children_mask; mask != 0_u64; mask &= mask - 1_u64) {
+        write_node(first_child_node_index + child_index, children[std::countr_zero(mask)]);
+        child_index += 1u;
+    }
+    node.children_mask = children_mask;
+    node.set_is_leaf(false);
+    node.set_first_child_node_index(first_child_node_index);
+}
+
+uint32_t Tree64Editor::allocate_sibling_group(uint32_t const node_count) {
+    auto& free_sibling_groups = m_free_sibling_groups[node_count - 1u];
+    if (!std::empty(free_sibling_groups)) {
+        auto const first_node_index = free_sibling_groups.back();
+        free_sibling_groups.pop_back();
+        m_sibling_group_changes.emplace_back(SiblingGroupChange{ .first_node_index = first_node_index,
+            .node_count = node_count, .is_freed = false });
+        m_unused_node_count -= node_count;
+        return first_node_index;
+    }
+    auto& nodes = m_contiguous_tree64.nodes;
+    if (std::size(nodes) + node_count > MAX_ABSOLUTE_ADDRESSING_NODE_COUNT) {
+        throw std::length_error("the edit needs more than 2^31 Tree64 nodes");
+    }
+    auto const first_node_index = static_cast<uint32_t>(std::size(nodes));
+    nodes.resize(std::size(nodes) + node_count);
+    // the appended nodes are not on the GPU yet, even if they are written with the default node
+    for (auto i = 0u; i < node_count; ++i) {
+        m_changed_node_indices.emplace_back(first_node_index + i);
+    }
+    return first_node_index;
+}
+
+void Tree64Editor::free_sibling_group(uint32_t const first_node_index, uint32_t const node_count) {
+    m_free_sibling_groups[node_count - 1u].emplace_back(first_node_index);
+    m_sibling_group_changes.emplace_back(SiblingGroupChange{ .first_node_index = first_node_index,
+        .node_count = node_count, .is_freed = true });
+    m_unused_node_count += node_count;
+}
+
+void Tree64Editor::free_subtree(Tree64Node const& node) {
+    if (node.is_leaf()) {
+        return;
+    }
+    auto const child_count = static_cast<uint32_t>(std::popcount(node.children_mask));
+    for (auto i = 0u; i < child_count; ++i) {
+        free_subtree(m_contiguous_tree64.nodes[node.first_child_node_index() + i]);
+    }
+    free_sibling_group(node.first_child_node_index(), child_count);
+}
+
+void Tree64Editor::write_node(uint32_t const node_index, Tree64Node const& node) {
+    auto& destination = m_contiguous_tree64.nodes[node_index];
+    if (destination.children_mask == node.children_mask
+        && destination.is_leaf_and_first_child_node_index == node.is_leaf_and_first_child_node_index) {
+        return;
+    }
+    m_overwritten_nodes.emplace_back(node_index, destination);
+    destination = node;
+    m_changed_node_indices.emplace_back(node_index);
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Tree64.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <array>
+#include <utility>
+#include <vector>
+
+namespace vp {
+
+struct Tree64NodeRange {
+    size_t first_node_index;
+    size_t node_count;
+};
+
+// Edits a contiguous tree in place, the nodes stay the ones of a tree built from the edited voxels, but the sibling
+// groups are no longer in depth first order : the resized groups are moved to unused nodes or appended at the end.
+// The tree must not be a DAG, its subtrees must not be shared.
+class Tree64Editor {
+public:
+    Tree64Editor(ContiguousTree64 contiguous_tree64);
+
+    [[nodiscard]] ContiguousTree64 const& contiguous_tree64() const;
+    // Nodes freed by the edits, waiting to be reused by sibling groups of the same size
+    [[nodiscard]] size_t unused_node_count() const;
+
+    void set_voxel(glm::uvec3 const& voxel);
+    void clear_voxel(glm::uvec3 const& voxel);
+    // min and max are inclusive, the box is clamped to the tree. Throws std::length_error when the edited tree needs more
+    // than MAX_ABSOLUTE_ADDRESSING_NODE_COUNT nodes, the edit is then undone.
+    void fill_box(glm::uvec3 const& min, glm::uvec3 const& max, bool is_solid);
+
+    // Sorted and disjoint ranges of the nodes changed since the last call
+    [[nodiscard]] std::vector<Tree64NodeRange> take_changed_node_ranges();
+
+private:
+    struct SiblingGroupChange {
+        uint32_t first_node_index;
+        uint32_t node_count;
+        bool is_freed;
+    };
+
+    ContiguousTree64 m_contiguous_tree64;
+    std::array<std::vector<uint32_t>, 64u> m_free_sibling_groups; // first node indices by node count - 1
+    size_t m_unused_node_count = 0u;
+    std::vector<uint32_t> m_changed_node_indices;
+    // The nodes overwritten and the free sibling groups taken or added by the edit in progress, to undo it
+    std::vector<std::pair<uint32_t, Tree64Node>> m_overwritten_nodes;
+    std::vector<SiblingGroupChange> m_sibling_group_changes;
+
+    void fill(Tree64Node& node, uint32_t level, glm::uvec3 const& node_min,
+        glm::uvec3 const& min, glm::uvec3 const& max, bool is_solid);
+
+    [[nodiscard]] uint32_t allocate_sibling_group(uint32_t node_count);
+    void free_sibling_group(uint32_t first_node_index, uint32_t node_count);
+    void free_subtree(Tree64Node const& node);
+    void write_node(uint32_t node_index, Tree64Node const& node);
+};
+
+}
@@ -27,14 +27,6 @@
     return std::string(reinterpret_cast<char const*>(std::data(u8string)), std::size(u8string));
 }
 
-[[nodiscard]] inline std::filesystem::path get_spirv_shader_path(std::string shader) {
-    return path_from(SPIRV_SHADERS_DIRECTORY "/" + std::move(shader));
-}
-
-[[nodiscard]] inline std::filesystem::path get_asset_path(std::string asset) {
-    return path_from(ASSETS_DIRECTORY "/" + std::move(asset));
-}
-
 [[nodiscard]] inline std::optional<std::vector<uint8_t>> read_binary_file(std::filesystem::path const& path) {
     auto ifstream = std::ifstream(path, std::ios::ate | std::ios::binary);
     if (ifstream.fail()) {
@@ -0,0 +1,37 @@
+#include "hosek_wilkie_sky.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <ArHosekSkyModel.h>
+
+namespace vp {
+
+HosekWilkieSkyRenderingParameters hosek_wilkie_sky_rendering_parameters(float const turbidity, float const albedo,
+    float const sun_elevation) {
+    auto* const sky_model = arhosek_rgb_skymodelstate_alloc_init(turbidity, albedo, sun_elevation);
+    auto parameters = HosekWilkieSkyRenderingParameters{};
+    for (auto i = 0u; i < std::size(parameters.config); ++i) {
+        parameters.config[i] = glm::vec3(sky_model->configs[0][i], sky_model->configs[1][i], sky_model->configs[2][i]);
+    }
+    parameters.luminance = glm::vec3(sky_model->radiances[0], sky_model->radiances[1], sky_model->radiances[2])
+        * (2.f * glm::pi<float>() / 683.f); // convert from radiance to luminance
+    arhosekskymodelstate_free(sky_model);
+    return parameters;
+}
+
+glm::vec3 sky_color(HosekWilkieSkyRenderingParameters const& parameters, glm::vec3 const& ray_direction,
+    glm::vec3 const& to_sun_direction) {
+    auto const& config = parameters.config;
+    auto const cos_theta = glm::clamp(ray_direction.y, 0.f, 1.f);
+    auto const cos_gamma = glm::clamp(glm::dot(ray_direction, to_sun_direction), 0.f, 1.f);
+    auto const gamma = glm::acos(cos_gamma);
+    auto const expM = glm::exp(config[4] * gamma);
+    auto const rayM = cos_gamma * cos_gamma;
+    auto const mieM = (1.f + rayM) / glm::pow(1.f + config[8] * config[8] - 2.f * config[8] * cos_gamma, glm::vec3(1.5f));
+    auto const zenith = glm::sqrt(cos_theta);
+    auto const radiance = (1.f + config[0] * glm::exp(config[1] / (cos_theta + 0.01f)))
+        * (config[2] + config[3] * expM + config[5] * rayM + config[6] * mieM + config[7] * zenith);
+    return radiance * parameters.luminance;
+}
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+
+namespace vp {
+
+#pragma pack(push, 1)
+struct HosekWilkieSkyRenderingParameters {
+    std::array<glm::vec3, 9u> config;
+    glm::vec3 luminance;
+};
+#pragma pack(pop)
+
+[[nodiscard]] HosekWilkieSkyRenderingParameters hosek_wilkie_sky_rendering_parameters(float turbidity, float albedo,
+    float sun_elevation);
+
+// Port of HosekWilkieSkyRenderingParameters::get_sky_color of the raytracing shader
+[[nodiscard]] glm::vec3 sky_color(HosekWilkieSkyRenderingParameters const& parameters, glm::vec3 const& ray_direction,
+    glm::vec3 const& to_sun_direction);
+
+}
@@ -1,15 +1,25 @@
 #include "Application.hpp"
+#include "t64_commands.hpp"
 
 #include <iostream>
+#include <span>
+#include <string_view>
 #ifdef _WIN32
 #include <Windows.h>
 #endif
 
-int main() {
+int main(int argc, char* argv[]) {
 #ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
 #endif
     try {
+        auto const args = std::span(argv, static_cast<size_t>(argc));
+        if (std::size(args) > 1u && std::string_view(args[1]) == "--convert") {
+            return vp::convert_model_command("VulkanPlayground", args.subspan(2u));
+        }
+        if (std::size(args) > 1u && std::string_view(args[1]) == "--reorder") {
+            return vp::reorder_t64_command("VulkanPlayground", args.subspan(2u));
+        }
         auto application = vp::Application();
         application.run();
     } catch (std::exception const& e) {
@@ -1,6 +1,8 @@
 #include "t64.hpp"
 #include "BinaryFstream.hpp"
 
+#include <iostream>
+
 namespace vp {
 
 #pragma pack(push, 1)
@@ -16,6 +18,13 @@ struct Header {
     uint8_t depth;
 };
 
+// Since 0.2, follows the header, the far offsets follow the nodes
+struct NodesHeader {
+    Tree64NodeAddressing addressing;
+    uint64_t node_count;
+    uint64_t far_offset_count;
+};
+
 #pragma pack(pop)
 
 }
@@ -39,6 +48,21 @@ struct BinaryFstreamIO<vp::Header> {
     }
 };
 
+template<>
+struct BinaryFstreamIO<vp::NodesHeader> {
+    static void read(BinaryFstream& bf, vp::NodesHeader& value) {
+        value.addressing = static_cast<vp::Tree64NodeAddressing>(bf.read<uint8_t>());
+        bf.read(value.node_count);
+        bf.read(value.far_offset_count);
+    }
+
+    static void write(BinaryFstream& bf, vp::NodesHeader const& value) {
+        bf.write(static_cast<uint8_t>(value.addressing));
+        bf.write(value.node_count);
+        bf.write(value.far_offset_count);
+    }
+};
+
 template<>
 struct BinaryFstreamIO<vp::Tree64Node> {
     static void read(BinaryFstream& bf, vp::Tree64Node& value) {
@@ -55,6 +79,7 @@ struct BinaryFstreamIO<vp::Tree64Node> {
 namespace vp {
 
 constexpr auto FILE_SIGNATURE = std::array<uint8_t, 3u>{{ 'T', '6', '4' }};
+constexpr auto FILE_VERSION = Version{ .major = 0u, .minor = 2u, .patch = 0u };
 
 std::optional<ContiguousTree64> import_t64(std::filesystem::path const& path) {
     auto bf = BinaryFstream(path, std::ios::ate);
@@ -67,21 +92,65 @@ std::optional<ContiguousTree64> import_t64(std::filesystem::path const& path) {
     if (header.signature != FILE_SIGNATURE) {
         return std::nullopt;
     }
-    auto const node_count = (file_size - sizeof(Header)) / sizeof(Tree64Node);
-    auto nodes = bf.read_vector<Tree64Node>(node_count);
-    return ContiguousTree64{ .depth = header.depth, .nodes = std::move(nodes) };
+    if (header.version.major != FILE_VERSION.major || header.version.minor > FILE_VERSION.minor) {
+        std::cerr << "Unsupported .t64 version " << +header.version.major << '.' << +header.version.minor << std::endl;
+        return std::nullopt;
+    }
+    auto contiguous_tree64 = ContiguousTree64{ .depth = header.depth };
+    if (header.version.minor < 2u) {
+        // 0.1 has only the absolute addressing and the nodes till the end of the file
+        auto const node_count = (file_size - sizeof(Header)) / sizeof(Tree64Node);
+        contiguous_tree64.nodes = bf.read_vector<Tree64Node>(node_count);
+        return contiguous_tree64;
+    }
+    auto const nodes_header = bf.read<NodesHeader>();
+    if (!bf || nodes_header.addressing > Tree64NodeAddressing::Relative
+        || nodes_header.node_count > file_size / sizeof(Tree64Node) || nodes_header.far_offset_count > file_size / sizeof(uint64_t)
+        || sizeof(Header) + sizeof(NodesHeader) + nodes_header.node_count * sizeof(Tree64Node)
+            + nodes_header.far_offset_count * sizeof(uint64_t) != file_size) {
+        return std::nullopt;
+    }
+    contiguous_tree64.addressing = nodes_header.addressing;
+    contiguous_tree64.nodes = bf.read_vector<Tree64Node>(nodes_header.node_count);
+    contiguous_tree64.far_offsets = bf.read_vector<uint64_t>(nodes_header.far_offset_count);
+    if (!bf) {
+        return std::nullopt;
+    }
+    return contiguous_tree64;
 }
 
 bool save_t64(std::filesystem::path const& path, ContiguousTree64 const& contiguous_tree64) {
+    return save_t64(path, contiguous_tree64.depth, contiguous_tree64.addressing,
+        [&](Tree64NodesWriter const& nodes_writer, std::vector<uint64_t>& far_offsets) {
+            nodes_writer(contiguous_tree64.nodes);
+            far_offsets = contiguous_tree64.far_offsets;
+            return true;
+        });
+}
+
+bool save_t64(std::filesystem::path const& path, uint8_t const depth, Tree64NodeAddressing const addressing,
+    std::function<bool(Tree64NodesWriter const& nodes_writer, std::vector<uint64_t>& far_offsets)> const& nodes_streamer) {
     auto bf = BinaryFstream(path, std::ios::trunc);
     auto const header = Header{
         .signature = FILE_SIGNATURE,
-        .version = Version{ .major = 0u, .minor = 1u, .patch = 0u },
-        .depth = contiguous_tree64.depth,
+        .version = FILE_VERSION,
+        .depth = depth,
     };
     bf.write(header);
-    bf.write_range(contiguous_tree64.nodes);
-    return static_cast<bool>(bf);
+    // The counts are only known once the nodes are streamed
+    auto const nodes_header_position = bf.tellp();
+    auto nodes_header = NodesHeader{ .addressing = addressing, .node_count = 0u, .far_offset_count = 0u };
+    bf.write(nodes_header);
+    auto far_offsets = std::vector<uint64_t>();
+    auto const success = nodes_streamer([&](std::span<Tree64Node const> const nodes) {
+        bf.write_range(nodes);
+        nodes_header.node_count += std::size(nodes);
+    }, far_offsets);
+    bf.write_range(far_offsets);
+    nodes_header.far_offset_count = std::size(far_offsets);
+    bf.seekp(nodes_header_position);
+    bf.write(nodes_header);
+    return success && static_cast<bool>(bf);
 }
 
 }
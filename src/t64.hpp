@@ -4,10 +4,20 @@
 
 #include <filesystem>
 #include <optional>
+#include <functional>
+#include <span>
+#include <vector>
 
 namespace vp {
 
 [[nodiscard]] std::optional<ContiguousTree64> import_t64(std::filesystem::path const& path);
 [[nodiscard]] bool save_t64(std::filesystem::path const& path, ContiguousTree64 const& contiguous_tree64);
 
+using Tree64NodesWriter = std::function<void(std::span<Tree64Node const> nodes)>;
+
+// For the trees that do not fit in memory, nodes_streamer writes the nodes in order, fills the far offsets of
+// Tree64NodeAddressing::Relative and returns whether it succeeded
+[[nodiscard]] bool save_t64(std::filesystem::path const& path, uint8_t depth, Tree64NodeAddressing addressing,
+    std::function<bool(Tree64NodesWriter const& nodes_writer, std::vector<uint64_t>& far_offsets)> const& nodes_streamer);
+
 }
@@ -0,0 +1,95 @@
+#include "t64_commands.hpp"
+#include "StreamingTree64Builder.hpp"
+#include "filesystem.hpp"
+#include "t64.hpp"
+#include "tree64_addressing.hpp"
+#include "tree64_order.hpp"
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <array>
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <cstdlib>
+
+namespace vp {
+
+int convert_model_command(std::string_view const program, std::span<char* const> args) {
+    auto voxelization_settings = VoxelizationSettings();
+    while (!std::empty(args)) {
+        auto const option = std::string_view(args.back());
+        if (option == "--instance-meshes") {
+            voxelization_settings.instances_meshes = true;
+        } else if (option == "--fill-interiors") {
+            voxelization_settings.fills_interiors = true;
+        } else {
+            break;
+        }
+        args = args.first(std::size(args) - 1u);
+    }
+    if (std::size(args) < 2u || std::size(args) > 4u) {
+        std::cerr << "Usage : " << program
+            << " --convert <model> <output.t64> [max side voxel count] [memory budget MiB] [--instance-meshes]"
+            << " [--fill-interiors]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto const model_path = path_from(args[0]);
+    auto const t64_path = path_from(args[1]);
+    auto const max_side_voxel_count = std::size(args) > 2u ? static_cast<uint32_t>(std::stoul(args[2])) : 1024u;
+    auto const memory_budget = static_cast<size_t>(std::size(args) > 3u ? std::stoull(args[3]) : 1024u) << 20u;
+    auto const begin_time = std::chrono::high_resolution_clock::now();
+    auto builder = std::optional<StreamingTree64Builder>();
+    if (model_path.extension() == ".vox") {
+        builder = StreamingTree64Builder::import_vox(model_path, memory_budget);
+    } else {
+        builder = StreamingTree64Builder::voxelize_model(model_path, max_side_voxel_count, memory_budget,
+            voxelization_settings);
+    }
+    if (!builder.has_value()) {
+        std::cerr << "Cannot import " << string_from(model_path) << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!builder->save_t64(t64_path)) {
+        std::cerr << "Cannot save " << string_from(t64_path) << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto const full_time = std::chrono::high_resolution_clock::now() - begin_time;
+    std::cout << "full time " << std::chrono::duration_cast<std::chrono::duration<float>>(full_time) << std::endl;
+    std::cout << "peak building memory " << builder->peak_building_memory_size() / (1u << 20u) << " MiB" << std::endl;
+    return EXIT_SUCCESS;
+}
+
+int reorder_t64_command(std::string_view const program, std::span<char* const> const args) {
+    auto const order_names = std::array{ "depth-first", "breadth-first", "van-emde-boas" };
+    auto const order = std::size(args) == 3u ? std::ranges::find(order_names, std::string_view(args[2])) : std::end(order_names);
+    if (order == std::end(order_names)) {
+        std::cerr << "Usage : " << program << " --reorder <input.t64> <output.t64> <depth-first|breadth-first|van-emde-boas>"
+            << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto const input_path = path_from(args[0]);
+    auto const output_path = path_from(args[1]);
+    auto contiguous_tree64 = import_t64(input_path);
+    if (!contiguous_tree64.has_value()) {
+        std::cerr << "Cannot import " << string_from(input_path) << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!use_absolute_addressing(contiguous_tree64.value())) {
+        std::cerr << "Cannot reorder more than 2^31 nodes" << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto const begin_time = std::chrono::high_resolution_clock::now();
+    contiguous_tree64->nodes = reorder_nodes(contiguous_tree64->nodes, contiguous_tree64->depth,
+        static_cast<Tree64NodeOrder>(std::distance(std::begin(order_names), order)));
+    auto const reorder_time = std::chrono::high_resolution_clock::now() - begin_time;
+    std::cout << "reorder time " << std::chrono::duration_cast<std::chrono::duration<float>>(reorder_time) << std::endl;
+    if (!save_t64(output_path, contiguous_tree64.value())) {
+        std::cerr << "Cannot save " << string_from(output_path) << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+}
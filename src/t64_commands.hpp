@@ -0,0 +1,17 @@
+#pragma once
+
+#include <span>
+#include <string_view>
+
+namespace vp {
+
+// The command line modes that convert models to .t64 and rewrite .t64 without any window, shared by the application
+// and VulkanPlaygroundConvert. They return the exit code, program is only used in the usage.
+
+// Converts a model to .t64 with a bounded building memory
+[[nodiscard]] int convert_model_command(std::string_view program, std::span<char* const> args);
+
+// Rewrites a .t64 with its sibling groups in another order
+[[nodiscard]] int reorder_t64_command(std::string_view program, std::span<char* const> args);
+
+}
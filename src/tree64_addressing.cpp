@@ -0,0 +1,61 @@
+#include "tree64_addressing.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace vp {
+
+// The offsets wrap around, so a first child before its node is stored as a far offset
+void set_first_child_node_index(Tree64Node& node, uint64_t const node_index, uint64_t const first_child_node_index,
+    Tree64NodeAddressing const addressing, std::vector<uint64_t>& far_offsets) {
+    if (addressing == Tree64NodeAddressing::Absolute) {
+        assert(first_child_node_index < MAX_ABSOLUTE_ADDRESSING_NODE_COUNT);
+        node.set_first_child_node_index(static_cast<uint32_t>(first_child_node_index));
+        return;
+    }
+    auto const offset = first_child_node_index - node_index;
+    if (offset <= MAX_NEAR_FIRST_CHILD_OFFSET) {
+        node.set_first_child_node_index(static_cast<uint32_t>(offset << 1u));
+        return;
+    }
+    assert(std::size(far_offsets) <= MAX_NEAR_FIRST_CHILD_OFFSET);
+    node.set_first_child_node_index(static_cast<uint32_t>((std::size(far_offsets) << 1u) | 1u));
+    far_offsets.emplace_back(offset);
+}
+
+uint64_t first_child_node_index(ContiguousTree64 const& contiguous_tree64, uint64_t const node_index) {
+    auto const bits = contiguous_tree64.nodes[node_index].first_child_node_index();
+    if (contiguous_tree64.addressing == Tree64NodeAddressing::Absolute) {
+        return bits;
+    }
+    auto const offset = (bits & 1u) == 0u ? uint64_t{ bits >> 1u } : contiguous_tree64.far_offsets[bits >> 1u];
+    return node_index + offset;
+}
+
+uint32_t absolute_first_child_node_index(uint64_t const first_child_node_index) {
+    if (first_child_node_index >= MAX_ABSOLUTE_ADDRESSING_NODE_COUNT) {
+        throw std::length_error("more than 2^31 Tree64 nodes, only the streaming builder saves them with the relative addressing");
+    }
+    return static_cast<uint32_t>(first_child_node_index);
+}
+
+bool use_absolute_addressing(ContiguousTree64& contiguous_tree64) {
+    if (contiguous_tree64.addressing == Tree64NodeAddressing::Absolute) {
+        return true;
+    }
+    auto& nodes = contiguous_tree64.nodes;
+    if (std::size(nodes) > MAX_ABSOLUTE_ADDRESSING_NODE_COUNT) {
+        return false;
+    }
+    // Each node only reads its own offset, so the nodes can be converted in place
+    for (auto node_index = size_t{ 0u }; node_index < std::size(nodes); ++node_index) {
+        if (!nodes[node_index].is_leaf()) {
+            nodes[node_index].set_first_child_node_index(static_cast<uint32_t>(first_child_node_index(contiguous_tree64, node_index)));
+        }
+    }
+    contiguous_tree64.addressing = Tree64NodeAddressing::Absolute;
+    contiguous_tree64.far_offsets = std::vector<uint64_t>();
+    return true;
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Tree64.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace vp {
+
+constexpr auto MAX_ABSOLUTE_ADDRESSING_NODE_COUNT = 1_u64 << 31u;
+constexpr auto MAX_NEAR_FIRST_CHILD_OFFSET = (1_u64 << 30u) - 1_u64;
+
+// With Tree64NodeAddressing::Relative, the offsets that do not fit in 30 bits are appended to far_offsets
+void set_first_child_node_index(Tree64Node& node, uint64_t node_index, uint64_t first_child_node_index,
+    Tree64NodeAddressing addressing, std::vector<uint64_t>& far_offsets);
+[[nodiscard]] uint64_t first_child_node_index(ContiguousTree64 const& contiguous_tree64, uint64_t node_index);
+
+// The first child node index of the in-memory builders, which only emit Tree64NodeAddressing::Absolute. Throws
+// std::length_error past MAX_ABSOLUTE_ADDRESSING_NODE_COUNT nodes, where StreamingTree64Builder is needed.
+[[nodiscard]] uint32_t absolute_first_child_node_index(uint64_t first_child_node_index);
+
+// Switches a relative tree to the absolute addressing, which the editing and the faster traversal need.
+// Returns false when the tree has too many nodes for it.
+[[nodiscard]] bool use_absolute_addressing(ContiguousTree64& contiguous_tree64);
+
+}
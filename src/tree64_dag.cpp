@@ -0,0 +1,97 @@
+#include "tree64_dag.hpp"
+
+#include <unordered_set>
+#include <algorithm>
+#include <bit>
+
+namespace vp {
+
+namespace {
+
+struct SiblingGroup {
+    uint32_t first_node_index;
+    uint32_t node_count;
+};
+
+struct SiblingGroupHash {
+    std::vector<Tree64Node> const* nodes;
+
+    size_t operator()(SiblingGroup const& group) const {
+        auto hash = 0xcbf29ce484222325_u64;
+        for (auto const& node : std::span(*nodes).subspan(group.first_node_index, group.node_count)) {
+            hash = (hash ^ node.children_mask) * 0x100000001b3_u64;
+            hash = (hash ^ node.is_leaf_and_first_child_node_index) * 0x100000001b3_u64;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+struct SiblingGroupEqual {
+    std::vector<Tree64Node> const* nodes;
+
+    bool operator()(SiblingGroup const& a, SiblingGroup const& b) const {
+        return std::ranges::equal(std::span(*nodes).subspan(a.first_node_index, a.node_count),
+            std::span(*nodes).subspan(b.first_node_index, b.node_count), [](Tree64Node const& node_a, Tree64Node const& node_b) {
+                return node_a.children_mask == node_b.children_mask
+                    && node_a.is_leaf_and_first_child_node_index == node_b.is_leaf_and_first_child_node_index;
+            });
+    }
+};
+
+}
+
+std::vector<Tree64Node> deduplicate_subtrees(std::span<Tree64Node const> const nodes) {
+    // The root is written last, children groups are emitted in post-order so they are already deduplicated when hashing
+    auto dag_nodes = std::vector<Tree64Node>(1u);
+    auto sibling_groups = std::unordered_set<SiblingGroup, SiblingGroupHash, SiblingGroupEqual>(0u,
+        SiblingGroupHash{ &dag_nodes }, SiblingGroupEqual{ &dag_nodes });
+    auto const deduplicate = [&](auto const& self, uint32_t const first_node_index, uint32_t const node_count) -> uint32_t {
+        auto group_nodes = std::vector<Tree64Node>(std::begin(nodes) + first_node_index,
+            std::begin(nodes) + first_node_index + node_count);
+        for (auto& node : group_nodes) {
+            if (!node.is_leaf()) {
+                node.set_first_child_node_index(self(self, node.first_child_node_index(),
+                    static_cast<uint32_t>(std::popcount(node.children_mask))));
+            }
+        }
+        auto const group = SiblingGroup{ .first_node_index = static_cast<uint32_t>(std::size(dag_nodes)), .node_count = node_count };
+        dag_nodes.insert(std::end(dag_nodes), std::begin(group_nodes), std::end(group_nodes));
+        auto const [it, inserted] = sibling_groups.insert(group);
+        if (!inserted) {
+            dag_nodes.resize(group.first_node_index);
+        }
+        return it->first_node_index;
+    };
+    auto root = nodes[0];
+    if (!root.is_leaf()) {
+        root.set_first_child_node_index(deduplicate(deduplicate, root.first_child_node_index(),
+            static_cast<uint32_t>(std::popcount(root.children_mask))));
+    }
+    dag_nodes[0] = root;
+    return dag_nodes;
+}
+
+// The unused nodes left by the edits are not reached, so only the nodes reached twice tell a DAG
+bool shares_subtrees(std::span<Tree64Node const> const nodes) {
+    auto is_reached = std::vector<bool>(std::size(nodes));
+    auto const shares = [&](auto const& self, Tree64Node const& node) -> bool {
+        if (node.is_leaf()) {
+            return false;
+        }
+        auto const first_child_node_index = node.first_child_node_index();
+        auto const child_count = static_cast<uint32_t>(std::popcount(node.children_mask));
+        for (auto i = first_child_node_index; i < first_child_node_index + child_count; ++i) {
+            if (is_reached[i]) {
+                return true;
+            }
+            is_reached[i] = true;
+            if (self(self, nodes[i])) {
+                return true;
+            }
+        }
+        return false;
+    };
+    return shares(shares, nodes[0]);
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Tree64.hpp"
+
+#include <vector>
+#include <span>
+
+namespace vp {
+
+// Turns the tree into a DAG where identical sibling groups, and so identical subtrees, are stored once.
+// The nodes keep the same format so the traversal is unchanged, the root stays at index 0.
+[[nodiscard]] std::vector<Tree64Node> deduplicate_subtrees(std::span<Tree64Node const> nodes);
+
+// Whether a node is reached from the root through more than one parent, as in the DAGs saved to .t64 and imported again.
+// The nodes must use Tree64NodeAddressing::Absolute.
+[[nodiscard]] bool shares_subtrees(std::span<Tree64Node const> nodes);
+
+}
@@ -0,0 +1,166 @@
+#include "tree64_hollow.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <bit>
+#include <unordered_map>
+#include <vector>
+
+namespace vp {
+
+// The children on the low face of their parent along x, z and y, in the Tree64Node::children_mask layout
+static constexpr auto LOW_FACE_CHILDREN = std::array{ 0x1111'1111'1111'1111_u64, 0x000F'000F'000F'000F_u64, 0x0000'0000'0000'FFFF_u64 };
+static constexpr auto CHILD_INDEX_STEPS = std::array{ 1u, 4u, 16u };
+static constexpr auto AXIS_OFFSETS = std::array{ glm::ivec3(1, 0, 0), glm::ivec3(0, 0, 1), glm::ivec3(0, 1, 0) };
+
+static uint64_t position_key(glm::uvec3 const& position) {
+    return uint64_t{ position.x } | (uint64_t{ position.y } << 21u) | (uint64_t{ position.z } << 42u);
+}
+
+static uint64_t full_children_mask(std::span<Tree64Node const> const nodes, Tree64Node const& node) {
+    if (node.is_leaf()) {
+        return node.children_mask;
+    }
+    auto full_mask = 0_u64;
+    auto child_index = node.first_child_node_index();
+    for (auto mask = node.children_mask; mask != 0_u64; mask &= mask - 1u) {
+        if (nodes[child_index].is_leaf() && nodes[child_index].children_mask == ~0_u64) {
+            full_mask |= 1_u64 << std::countr_zero(mask);
+        }
+        child_index += 1u;
+    }
+    return full_mask;
+}
+
+// Each level is walked once, the full children of a node being shifted against themselves inside the node and against
+// the face of the neighbor node in the 6 directions, the neighbor full children masks being found in the levels above
+// when the neighbor is merged into a coarser node or empty
+bool hollow_hidden_voxels(ContiguousTree64& contiguous_tree64) {
+    if (contiguous_tree64.addressing != Tree64NodeAddressing::Absolute || !std::empty(contiguous_tree64.leaf_masks)) {
+        return false;
+    }
+    auto const& nodes = contiguous_tree64.nodes;
+    auto const depth = contiguous_tree64.depth;
+    auto referenced_node_count = size_t{ 1u };
+    for (auto const& node : nodes) {
+        referenced_node_count += node.is_leaf() ? 0u : static_cast<size_t>(std::popcount(node.children_mask));
+    }
+    if (referenced_node_count != std::size(nodes)) {
+        return false;
+    }
+
+    struct LevelNode {
+        uint32_t node_index;
+        glm::uvec3 position;
+    };
+    auto levels = std::vector<std::vector<LevelNode>>(depth);
+    auto level_node_indices = std::vector<std::unordered_map<uint64_t, uint32_t>>(depth);
+    levels[0].emplace_back(LevelNode{ .node_index = 0u, .position = glm::uvec3(0u) });
+    for (auto level = 0u; level < depth; ++level) {
+        level_node_indices[level].reserve(std::size(levels[level]));
+        for (auto const& [node_index, position] : levels[level]) {
+            level_node_indices[level].emplace(position_key(position), node_index);
+            auto const& node = nodes[node_index];
+            if (node.is_leaf() || level + 1u == depth) {
+                continue;
+            }
+            auto child_index = node.first_child_node_index();
+            for (auto mask = node.children_mask; mask != 0_u64; mask &= mask - 1u) {
+                auto const bit = static_cast<uint32_t>(std::countr_zero(mask));
+                levels[level + 1u].emplace_back(LevelNode{
+                    .node_index = child_index,
+                    .position = position * 4u + glm::uvec3(bit % 4u, bit / 16u, bit / 4u % 4u),
+                });
+                child_index += 1u;
+            }
+        }
+    }
+    auto full_children_masks = std::vector<uint64_t>(std::size(nodes));
+    for (auto node_index = size_t{ 0u }; node_index < std::size(nodes); ++node_index) {
+        full_children_masks[node_index] = full_children_mask(nodes, nodes[node_index]);
+    }
+
+    auto const neighbor_full_children_mask = [&](uint32_t const level, glm::ivec3 const& position) {
+        auto const side_node_count = 1 << (level * 2u);
+        if (glm::any(glm::lessThan(position, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(position, glm::ivec3(side_node_count)))) {
+            return 0_u64;
+        }
+        auto ancestor_position = glm::uvec3(position);
+        for (auto ancestor_level = level; true; --ancestor_level) {
+            auto const it = level_node_indices[ancestor_level].find(position_key(ancestor_position));
+            if (it != std::end(level_node_indices[ancestor_level])) {
+                if (ancestor_level == level) {
+                    return full_children_masks[it->second];
+                }
+                // The node below would have been found unless this bit is empty or a full merged child
+                auto const& ancestor = nodes[it->second];
+                auto const child_position = glm::uvec3(position) >> ((level - ancestor_level - 1u) * 2u) & 3u;
+                auto const bit = child_position.x + child_position.z * 4u + child_position.y * 16u;
+                return ancestor.is_leaf() && (ancestor.children_mask & (1_u64 << bit)) != 0_u64 ? ~0_u64 : 0_u64;
+            }
+            ancestor_position >>= 2u;
+        }
+    };
+
+    // From the deepest level, so that the non leaf nodes drop the children left empty
+    auto new_children_masks = std::vector<uint64_t>(std::size(nodes));
+    for (auto level = uint32_t{ depth }; level-- > 0u;) {
+        for (auto const& [node_index, position] : levels[level]) {
+            auto const& node = nodes[node_index];
+            auto const full_mask = full_children_masks[node_index];
+            auto hidden_mask = node.is_leaf() && node.children_mask == ~0_u64 ? 0_u64 : full_mask;
+            for (auto axis = 0u; axis < 3u && hidden_mask != 0_u64; ++axis) {
+                auto const step = CHILD_INDEX_STEPS[axis];
+                auto const low_face = LOW_FACE_CHILDREN[axis];
+                auto const high_face = low_face << (3u * step);
+                auto const high_neighbor = neighbor_full_children_mask(level, glm::ivec3(position) + AXIS_OFFSETS[axis]);
+                hidden_mask &= ((full_mask >> step) & ~high_face) | ((high_neighbor & low_face) << (3u * step));
+                if (hidden_mask == 0_u64) {
+                    break;
+                }
+                auto const low_neighbor = neighbor_full_children_mask(level, glm::ivec3(position) - AXIS_OFFSETS[axis]);
+                hidden_mask &= ((full_mask << step) & ~low_face) | ((low_neighbor & high_face) >> (3u * step));
+            }
+            auto new_children_mask = node.children_mask & ~hidden_mask;
+            if (!node.is_leaf()) {
+                auto child_index = node.first_child_node_index();
+                for (auto mask = node.children_mask; mask != 0_u64; mask &= mask - 1u) {
+                    if (new_children_masks[child_index] == 0_u64) {
+                        new_children_mask &= ~(1_u64 << std::countr_zero(mask));
+                    }
+                    child_index += 1u;
+                }
+            }
+            new_children_masks[node_index] = new_children_mask;
+        }
+    }
+    levels = {};
+    level_node_indices = {};
+
+    auto hollowed_nodes = std::vector<Tree64Node>(1u);
+    auto const build = [&](auto const& self, uint32_t const node_index, size_t const hollowed_node_index) -> void {
+        auto const& node = nodes[node_index];
+        auto hollowed_node = Tree64Node{ .children_mask = new_children_masks[node_index] };
+        hollowed_node.set_is_leaf(node.is_leaf());
+        if (!node.is_leaf()) {
+            auto hollowed_child_index = std::size(hollowed_nodes);
+            hollowed_node.set_first_child_node_index(static_cast<uint32_t>(hollowed_child_index));
+            hollowed_nodes.resize(hollowed_child_index + static_cast<size_t>(std::popcount(hollowed_node.children_mask)));
+            auto child_index = node.first_child_node_index();
+            for (auto mask = node.children_mask; mask != 0_u64; mask &= mask - 1u) {
+                if ((hollowed_node.children_mask & (1_u64 << std::countr_zero(mask))) != 0_u64) {
+                    self(self, child_index, hollowed_child_index);
+                    hollowed_child_index += 1u;
+                }
+                child_index += 1u;
+            }
+        }
+        hollowed_nodes[hollowed_node_index] = hollowed_node;
+    };
+    build(build, 0u, 0u);
+    contiguous_tree64.nodes = std::move(hollowed_nodes);
+    return true;
+}
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "Tree64.hpp"
+
+namespace vp {
+
+// Removes the voxels whose 6 neighbors are all filled, which no ray coming from an empty voxel or from outside the grid
+// can hit. The children full of voxels are compared to their full neighbors of the same size, so the uniform full
+// nodes are either removed whole or kept whole, and the pass never adds nodes. The nodes are rebuilt in depth first
+// order. The tree must use Tree64NodeAddressing::Absolute and no inlined leaf masks, and must not be a DAG.
+// Returns false otherwise. The removed voxels are lost, a hollowed tree saved to .t64 stays hollow.
+[[nodiscard]] bool hollow_hidden_voxels(ContiguousTree64& contiguous_tree64);
+
+}
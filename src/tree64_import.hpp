@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Tree64.hpp"
+#include "math.hpp"
+#include "filesystem.hpp"
+#include "vox.hpp"
+#include "voxelizer.hpp"
+
+#include <glm/gtx/component_wise.hpp>
+
+#include <iostream>
+#include <optional>
+#include <filesystem>
+#include <bit>
+#include <span>
+
+namespace vp {
+
+// Tree64Builder must be constructible from a depth followed by builder_args and provide add_voxels(std::span<glm::uvec3 const>)
+// and add_brick_runs(std::span<VoxelBrickRun const>)
+template<typename Tree64Builder, typename... BuilderArgs>
+[[nodiscard]] std::optional<Tree64Builder> voxelize_model_into(std::filesystem::path const& path,
+    uint32_t const max_side_voxel_count, VoxelizationSettings const& settings, BuilderArgs const&... builder_args) {
+    auto const depth = divide_ceil(static_cast<uint8_t>(std::bit_width(max_side_voxel_count - 1u)), uint8_t{ 2u });
+    if (depth > Tree64::MAX_DEPTH) {
+        std::cerr << "Exceeded the max voxel size " << (1u << (Tree64::MAX_DEPTH * 2u)) << std::endl;
+        return std::nullopt;
+    }
+    auto builder = Tree64Builder(depth, builder_args...);
+    auto const success = ::voxelize_model(path, max_side_voxel_count, [&](std::span<glm::uvec3 const> const voxels) {
+        builder.add_voxels(voxels);
+    }, [&](std::span<VoxelBrickRun const> const brick_runs) {
+        builder.add_brick_runs(brick_runs);
+    }, settings);
+    if (!success) {
+        return std::nullopt;
+    }
+    return builder;
+}
+
+template<typename Tree64Builder, typename... BuilderArgs>
+[[nodiscard]] std::optional<Tree64Builder> import_vox_into(std::filesystem::path const& path, BuilderArgs const&... builder_args) {
+    std::optional<Tree64Builder> builder;
+    auto const success = ::import_vox(path, [&](glm::uvec3 const& vox_full_size) {
+        auto const max = glm::max(4u, glm::compMax(vox_full_size));
+        auto depth = divide_ceil(static_cast<uint8_t>(std::bit_width(max - 1u)), uint8_t{ 2u });
+        if (depth > Tree64::MAX_DEPTH) {
+            std::cerr << "Vox \"" << string_from(path) << "\" exceeds the max voxel size " << (1u << (Tree64::MAX_DEPTH * 2u)) << std::endl;
+            return false;
+        }
+        builder.emplace(depth, builder_args...);
+        return true;
+    }, [&](std::span<glm::uvec3 const> const voxels) {
+        builder->add_voxels(voxels);
+    });
+    if (!success) {
+        return std::nullopt;
+    }
+    return builder;
+}
+
+}
@@ -0,0 +1,77 @@
+#include "tree64_layout.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <numeric>
+
+namespace vp {
+
+static constexpr auto PACKED_NODE_ARRAY_STRIDES = std::array{ sizeof(Tree64Node) };
+static constexpr auto ALIGNED_NODE_ARRAY_STRIDES = std::array{ size_t{ 16u } };
+static constexpr auto SPLIT_NODE_ARRAY_STRIDES = std::array{ sizeof(uint64_t), sizeof(uint32_t) };
+
+std::span<size_t const> node_array_strides(Tree64NodeLayout const layout) {
+    switch (layout) {
+    case Tree64NodeLayout::Packed:
+        return PACKED_NODE_ARRAY_STRIDES;
+    case Tree64NodeLayout::Aligned:
+        return ALIGNED_NODE_ARRAY_STRIDES;
+    case Tree64NodeLayout::Split:
+        return SPLIT_NODE_ARRAY_STRIDES;
+    }
+    return PACKED_NODE_ARRAY_STRIDES;
+}
+
+size_t laid_out_node_size(Tree64NodeLayout const layout) {
+    auto const strides = node_array_strides(layout);
+    return std::reduce(std::begin(strides), std::end(strides));
+}
+
+size_t node_array_offset(Tree64NodeLayout const layout, size_t const array_index, size_t const node_capacity) {
+    auto const strides = node_array_strides(layout).first(array_index);
+    return std::reduce(std::begin(strides), std::end(strides)) * node_capacity;
+}
+
+void lay_out_nodes(std::span<Tree64Node const> const nodes, Tree64NodeLayout const layout, size_t const array_index,
+    std::span<uint8_t> const destination) {
+    auto const stride = node_array_strides(layout)[array_index];
+    assert(std::size(destination) >= std::size(nodes) * stride);
+    if (layout == Tree64NodeLayout::Packed) {
+        std::memcpy(std::data(destination), std::data(nodes), std::size(nodes) * stride);
+        return;
+    }
+    for (auto i = size_t{ 0u }; i < std::size(nodes); ++i) {
+        auto* const laid_out_node = &destination[i * stride];
+        if (layout == Tree64NodeLayout::Aligned) {
+            std::memcpy(laid_out_node, &nodes[i], sizeof(Tree64Node));
+            std::memset(laid_out_node + sizeof(Tree64Node), 0, stride - sizeof(Tree64Node));
+        } else if (array_index == 0u) {
+            std::memcpy(laid_out_node, &nodes[i].children_mask, stride);
+        } else {
+            std::memcpy(laid_out_node, &nodes[i].is_leaf_and_first_child_node_index, stride);
+        }
+    }
+}
+
+void gather_laid_out_nodes(std::span<uint8_t const> const source, Tree64NodeLayout const layout, size_t const array_index,
+    std::span<Tree64Node> const nodes) {
+    auto const stride = node_array_strides(layout)[array_index];
+    assert(std::size(source) >= std::size(nodes) * stride);
+    if (layout == Tree64NodeLayout::Packed) {
+        std::memcpy(std::data(nodes), std::data(source), std::size(nodes) * stride);
+        return;
+    }
+    for (auto i = size_t{ 0u }; i < std::size(nodes); ++i) {
+        auto const* const laid_out_node = &source[i * stride];
+        if (layout == Tree64NodeLayout::Aligned) {
+            std::memcpy(&nodes[i], laid_out_node, sizeof(Tree64Node));
+        } else if (array_index == 0u) {
+            std::memcpy(&nodes[i].children_mask, laid_out_node, stride);
+        } else {
+            std::memcpy(&nodes[i].is_leaf_and_first_child_node_index, laid_out_node, stride);
+        }
+    }
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Tree64.hpp"
+
+#include <cstdint>
+#include <span>
+
+namespace vp {
+
+// How the nodes are stored on the GPU, the traversal shaders are specialized on it
+enum class Tree64NodeLayout : uint8_t {
+    Packed, // Tree64Node as is, its 12 bytes can straddle the 16 bytes loads and the cache lines
+    Aligned, // Tree64Node padded to 16 bytes, loaded at once
+    Split, // the children masks then the is_leaf_and_first_child_node_index, in two arrays
+};
+
+constexpr auto TREE64_NODE_LAYOUT_COUNT = 3u;
+
+// A buffer of node_capacity nodes stores the arrays of its layout one after the other, with these bytes per node
+[[nodiscard]] std::span<size_t const> node_array_strides(Tree64NodeLayout layout);
+[[nodiscard]] size_t laid_out_node_size(Tree64NodeLayout layout);
+[[nodiscard]] size_t node_array_offset(Tree64NodeLayout layout, size_t array_index, size_t node_capacity);
+
+// destination and source hold the nodes in the array_index array of the layout
+void lay_out_nodes(std::span<Tree64Node const> nodes, Tree64NodeLayout layout, size_t array_index, std::span<uint8_t> destination);
+void gather_laid_out_nodes(std::span<uint8_t const> source, Tree64NodeLayout layout, size_t array_index, std::span<Tree64Node> nodes);
+
+}
@@ -0,0 +1,151 @@
+#include "tree64_leaf_masks.hpp"
+
+#include <unordered_map>
+#include <algorithm>
+#include <bit>
+
+namespace vp {
+
+static constexpr auto DROPPED_NODE_INDEX = ~0u;
+
+bool inline_leaf_masks(ContiguousTree64& contiguous_tree64) {
+    if (contiguous_tree64.addressing != Tree64NodeAddressing::Absolute) {
+        return false;
+    }
+    if (!std::empty(contiguous_tree64.leaf_masks)) {
+        return true;
+    }
+    auto const& nodes = contiguous_tree64.nodes;
+    // A DAG can point to the same leaves from several parents
+    auto new_node_indices = std::vector<uint32_t>(std::size(nodes), 0u);
+    for (auto const& node : nodes) {
+        if (node.is_leaf()) {
+            continue;
+        }
+        auto const first_child_node_index = node.first_child_node_index();
+        auto const child_count = static_cast<uint32_t>(std::popcount(node.children_mask));
+        auto children_are_leaves = true;
+        for (auto i = 0u; i < child_count && children_are_leaves; ++i) {
+            children_are_leaves = nodes[first_child_node_index + i].is_leaf();
+        }
+        if (children_are_leaves) {
+            for (auto i = 0u; i < child_count; ++i) {
+                new_node_indices[first_child_node_index + i] = DROPPED_NODE_INDEX;
+            }
+        }
+    }
+    // The leaf masks follow the order of the dropped leaves
+    auto leaf_masks = std::vector<uint64_t>(1u, 0_u64);
+    auto new_node_count = uint32_t{ 0u };
+    for (auto node_index = size_t{ 0u }; node_index < std::size(nodes); ++node_index) {
+        if (new_node_indices[node_index] == DROPPED_NODE_INDEX) {
+            new_node_indices[node_index] = DROPPED_NODE_INDEX - static_cast<uint32_t>(std::size(leaf_masks));
+            leaf_masks.emplace_back(nodes[node_index].children_mask);
+        } else {
+            new_node_indices[node_index] = new_node_count;
+            new_node_count += 1u;
+        }
+    }
+    auto new_nodes = std::vector<Tree64Node>();
+    new_nodes.reserve(new_node_count);
+    for (auto node_index = size_t{ 0u }; node_index < std::size(nodes); ++node_index) {
+        auto const new_node_index = new_node_indices[node_index];
+        if (new_node_index >= new_node_count) {
+            continue;
+        }
+        auto node = nodes[node_index];
+        if (!node.is_leaf()) {
+            auto const new_first_child_node_index = new_node_indices[node.first_child_node_index()];
+            if (new_first_child_node_index >= new_node_count) {
+                node.set_is_leaf(true);
+                node.set_first_child_node_index(DROPPED_NODE_INDEX - new_first_child_node_index);
+            } else {
+                node.set_first_child_node_index(new_first_child_node_index);
+            }
+        }
+        new_nodes.emplace_back(node);
+    }
+    contiguous_tree64.nodes = std::move(new_nodes);
+    contiguous_tree64.leaf_masks = std::move(leaf_masks);
+    return true;
+}
+
+void expand_leaf_masks(ContiguousTree64& contiguous_tree64) {
+    if (std::empty(contiguous_tree64.leaf_masks)) {
+        return;
+    }
+    auto const& nodes = contiguous_tree64.nodes;
+    auto const& leaf_masks = contiguous_tree64.leaf_masks;
+    auto expanded_nodes = std::vector<Tree64Node>(1u);
+    // Keyed by the previous first child index, with the leaf masks ones flagged in the high bits
+    auto expanded_first_child_node_indices = std::unordered_map<uint64_t, uint32_t>();
+    auto const expand = [&](auto const& self, Tree64Node node) -> Tree64Node {
+        auto const is_inlined = has_inlined_leaf_masks(node);
+        if (node.is_leaf() && !is_inlined) {
+            return node;
+        }
+        auto const key = uint64_t{ node.first_child_node_index() } | (is_inlined ? 1_u64 << 32u : 0_u64);
+        auto const child_count = static_cast<uint32_t>(std::popcount(node.children_mask));
+        node.set_is_leaf(false);
+        if (auto const it = expanded_first_child_node_indices.find(key); it != std::end(expanded_first_child_node_indices)) {
+            node.set_first_child_node_index(it->second);
+            return node;
+        }
+        auto const first_child_node_index = static_cast<uint32_t>(std::size(expanded_nodes));
+        expanded_first_child_node_indices.emplace(key, first_child_node_index);
+        expanded_nodes.resize(std::size(expanded_nodes) + child_count);
+        for (auto i = 0u; i < child_count; ++i) {
+            auto const child_index = static_cast<uint32_t>(key) + i;
+            // Expanded before indexing, as expanding the child resizes the nodes
+            auto const child = is_inlined ? Tree64Node{ .children_mask = leaf_masks[child_index] } : self(self, nodes[child_index]);
+            expanded_nodes[first_child_node_index + i] = child;
+        }
+        node.set_first_child_node_index(first_child_node_index);
+        return node;
+    };
+    expanded_nodes[0] = expand(expand, nodes[0]);
+    contiguous_tree64.nodes = std::move(expanded_nodes);
+    contiguous_tree64.leaf_masks = std::vector<uint64_t>();
+}
+
+uint32_t LeafMaskDictionary::index_at(size_t const leaf_mask_index) const {
+    auto const bit_offset = leaf_mask_index * index_bit_count;
+    auto const index_mask = index_bit_count == 32u ? ~0u : (1u << index_bit_count) - 1u;
+    return (packed_indices[bit_offset / 32u] >> (bit_offset % 32u)) & index_mask;
+}
+
+LeafMaskDictionary build_leaf_mask_dictionary(std::span<uint64_t const> const leaf_masks) {
+    auto leaf_mask_counts = std::unordered_map<uint64_t, uint64_t>();
+    for (auto const leaf_mask : leaf_masks) {
+        leaf_mask_counts[leaf_mask] += 1u;
+    }
+    auto sorted_leaf_mask_counts = std::vector<std::pair<uint64_t, uint64_t>>(std::begin(leaf_mask_counts), std::end(leaf_mask_counts));
+    std::ranges::sort(sorted_leaf_mask_counts, [](auto const& a, auto const& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    auto dictionary = LeafMaskDictionary();
+    dictionary.unique_leaf_masks.reserve(std::size(sorted_leaf_mask_counts));
+    // The counts are replaced by the indices
+    for (auto const& [leaf_mask, count] : sorted_leaf_mask_counts) {
+        leaf_mask_counts[leaf_mask] = std::size(dictionary.unique_leaf_masks);
+        dictionary.unique_leaf_masks.emplace_back(leaf_mask);
+    }
+    auto const unique_leaf_mask_count = std::size(dictionary.unique_leaf_masks);
+    dictionary.index_bit_count = unique_leaf_mask_count <= (1u << 8u) ? 8u : unique_leaf_mask_count <= (1u << 16u) ? 16u : 32u;
+    dictionary.packed_indices.resize((std::size(leaf_masks) * dictionary.index_bit_count + 31u) / 32u);
+    for (auto i = size_t{ 0u }; i < std::size(leaf_masks); ++i) {
+        auto const bit_offset = i * dictionary.index_bit_count;
+        dictionary.packed_indices[bit_offset / 32u] |= static_cast<uint32_t>(leaf_mask_counts[leaf_masks[i]]) << (bit_offset % 32u);
+    }
+    return dictionary;
+}
+
+std::vector<uint64_t> decode_leaf_masks(LeafMaskDictionary const& dictionary, size_t const leaf_mask_count) {
+    auto leaf_masks = std::vector<uint64_t>(leaf_mask_count);
+    for (auto i = size_t{ 0u }; i < leaf_mask_count; ++i) {
+        leaf_masks[i] = dictionary.unique_leaf_masks[dictionary.index_at(i)];
+    }
+    return leaf_masks;
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Tree64.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <span>
+
+namespace vp {
+
+// With inlined leaf masks, a parent whose children all are leaves is flagged as a leaf with a non zero
+// first_child_node_index, which is then the index of the children masks in the leaf masks. The leaf nodes are dropped.
+// The first leaf mask is unused so that the plain leaves keep a zero index.
+[[nodiscard]] inline bool has_inlined_leaf_masks(Tree64Node const& node) {
+    return node.is_leaf() && node.first_child_node_index() != 0u;
+}
+
+// The nodes keep their order, the tree must use Tree64NodeAddressing::Absolute. Returns false otherwise.
+[[nodiscard]] bool inline_leaf_masks(ContiguousTree64& contiguous_tree64);
+// The nodes are rebuilt in depth first order, as the position of the dropped leaf nodes is lost
+void expand_leaf_masks(ContiguousTree64& contiguous_tree64);
+
+// The unique leaf masks, which the leaf masks are replaced by indices into. The indices are packed in 32 bits words,
+// with the fewest bits among 8, 16 and 32 that index all the unique masks.
+struct LeafMaskDictionary {
+    std::vector<uint64_t> unique_leaf_masks; // the most frequent first, so that they share the cache lines
+    uint32_t index_bit_count = 32u;
+    std::vector<uint32_t> packed_indices;
+
+    [[nodiscard]] uint32_t index_at(size_t leaf_mask_index) const;
+};
+
+[[nodiscard]] LeafMaskDictionary build_leaf_mask_dictionary(std::span<uint64_t const> leaf_masks);
+[[nodiscard]] std::vector<uint64_t> decode_leaf_masks(LeafMaskDictionary const& dictionary, size_t leaf_mask_count);
+
+}
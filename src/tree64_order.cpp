@@ -0,0 +1,215 @@
+#include "tree64_order.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <bit>
+
+namespace vp {
+
+namespace {
+
+struct SiblingGroup {
+    uint32_t first_node_index;
+    uint32_t node_count;
+};
+
+class SiblingGroupOrder {
+public:
+    explicit SiblingGroupOrder(std::span<Tree64Node const> const nodes) :
+        m_nodes{ nodes },
+        m_new_node_indices(std::size(nodes), UNPLACED_NODE_INDEX),
+        m_walk_indices(std::size(nodes), 0u),
+        m_placed_node_count{ 1u } {
+        m_new_node_indices[0] = 0u;
+    }
+
+    [[nodiscard]] std::vector<SiblingGroup> children_groups(SiblingGroup const& group) const {
+        auto groups = std::vector<SiblingGroup>();
+        for (auto const& node : m_nodes.subspan(group.first_node_index, group.node_count)) {
+            if (!node.is_leaf()) {
+                groups.emplace_back(SiblingGroup{
+                    .first_node_index = node.first_child_node_index(),
+                    .node_count = static_cast<uint32_t>(std::popcount(node.children_mask)),
+                });
+            }
+        }
+        return groups;
+    }
+
+    [[nodiscard]] bool is_placed(SiblingGroup const& group) const {
+        return m_new_node_indices[group.first_node_index] != UNPLACED_NODE_INDEX;
+    }
+
+    // The groups shared by a DAG are only placed the first time
+    void place(SiblingGroup const& group) {
+        if (is_placed(group)) {
+            return;
+        }
+        for (auto i = 0u; i < group.node_count; ++i) {
+            m_new_node_indices[group.first_node_index + i] = m_placed_node_count + i;
+        }
+        m_placed_node_count += group.node_count;
+    }
+
+    // Each walk reaches the groups shared by a DAG once, the first time
+    void start_walk() {
+        m_walk_index += 1u;
+    }
+
+    [[nodiscard]] bool walk(SiblingGroup const& group) {
+        if (m_walk_indices[group.first_node_index] == m_walk_index) {
+            return false;
+        }
+        m_walk_indices[group.first_node_index] = m_walk_index;
+        return true;
+    }
+
+    void place_depth_first(SiblingGroup const& group) {
+        if (is_placed(group)) {
+            return;
+        }
+        place(group);
+        for (auto const& child_group : children_groups(group)) {
+            place_depth_first(child_group);
+        }
+    }
+
+    [[nodiscard]] std::vector<Tree64Node> reordered_nodes() const {
+        assert(m_placed_node_count <= std::size(m_nodes));
+        auto nodes = std::vector<Tree64Node>(m_placed_node_count);
+        for (auto node_index = size_t{ 0u }; node_index < std::size(m_nodes); ++node_index) {
+            auto const new_node_index = m_new_node_indices[node_index];
+            if (new_node_index == UNPLACED_NODE_INDEX) {
+                continue; // unreachable, like the nodes freed by the edits
+            }
+            auto node = m_nodes[node_index];
+            if (!node.is_leaf()) {
+                node.set_first_child_node_index(m_new_node_indices[node.first_child_node_index()]);
+            }
+            nodes[new_node_index] = node;
+        }
+        return nodes;
+    }
+
+private:
+    static constexpr auto UNPLACED_NODE_INDEX = ~0u;
+
+    std::span<Tree64Node const> m_nodes;
+    std::vector<uint32_t> m_new_node_indices;
+    std::vector<uint32_t> m_walk_indices; // the last walk which reached the group, by first node index
+    uint32_t m_placed_node_count;
+    uint32_t m_walk_index = 0u;
+};
+
+// The groups level_count levels below group not placed yet, in depth first order. The groups shared by a DAG are walked
+// once, the ones at the bottom already placed having had their own subtrees placed with them.
+void collect_groups_below(SiblingGroupOrder& order, SiblingGroup const& group, uint32_t const level_count,
+    std::vector<SiblingGroup>& groups) {
+    for (auto const& child_group : order.children_groups(group)) {
+        if (!order.walk(child_group)) {
+            continue;
+        }
+        if (level_count > 1u) {
+            collect_groups_below(order, child_group, level_count - 1u, groups);
+        } else if (!order.is_placed(child_group)) {
+            groups.emplace_back(child_group);
+        }
+    }
+}
+
+void place_van_emde_boas(SiblingGroupOrder& order, SiblingGroup const& group, uint32_t const height) {
+    if (order.is_placed(group)) {
+        return;
+    }
+    if (height <= 1u) {
+        order.place(group);
+        return;
+    }
+    auto const top_height = height / 2u;
+    place_van_emde_boas(order, group, top_height);
+    auto bottom_groups = std::vector<SiblingGroup>();
+    order.start_walk();
+    collect_groups_below(order, group, top_height, bottom_groups);
+    for (auto const& bottom_group : bottom_groups) {
+        place_van_emde_boas(order, bottom_group, height - top_height);
+    }
+}
+
+}
+
+std::vector<Tree64Node> reorder_nodes(std::span<Tree64Node const> const nodes, uint8_t const depth, Tree64NodeOrder const order,
+    std::span<uint32_t const> const node_visit_counts) {
+    auto const& root = nodes[0];
+    if (root.is_leaf()) {
+        return std::vector<Tree64Node>(1u, root);
+    }
+    auto sibling_group_order = SiblingGroupOrder(nodes);
+    auto const root_children_group = SiblingGroup{
+        .first_node_index = root.first_child_node_index(),
+        .node_count = static_cast<uint32_t>(std::popcount(root.children_mask)),
+    };
+    switch (order) {
+    case Tree64NodeOrder::DepthFirst:
+        sibling_group_order.place_depth_first(root_children_group);
+        break;
+    case Tree64NodeOrder::BreadthFirstTop: {
+        auto level_groups = std::vector<SiblingGroup>{ root_children_group };
+        for (auto level = 1u; level < BREADTH_FIRST_TOP_LEVEL_COUNT && !std::empty(level_groups); ++level) {
+            auto next_level_groups = std::vector<SiblingGroup>();
+            for (auto const& group : level_groups) {
+                if (!sibling_group_order.is_placed(group)) {
+                    sibling_group_order.place(group);
+                    auto const children_groups = sibling_group_order.children_groups(group);
+                    next_level_groups.insert(std::end(next_level_groups), std::begin(children_groups), std::end(children_groups));
+                }
+            }
+            level_groups = std::move(next_level_groups);
+        }
+        for (auto const& group : level_groups) {
+            sibling_group_order.place_depth_first(group);
+        }
+        break;
+    }
+    case Tree64NodeOrder::VanEmdeBoas:
+        // The levels below the root each hold a level of groups
+        place_van_emde_boas(sibling_group_order, root_children_group, depth - 1u);
+        break;
+    case Tree64NodeOrder::ProfileGuided: {
+        assert(std::size(node_visit_counts) == std::size(nodes));
+        // Sorting the depth first order keeps it between the groups visited the same number of times
+        auto depth_first_order = SiblingGroupOrder(nodes);
+        auto groups = std::vector<SiblingGroup>();
+        auto group_visit_counts = std::vector<uint64_t>();
+        auto const collect_groups = [&](auto const& self, SiblingGroup const& group) -> void {
+            if (depth_first_order.is_placed(group)) {
+                return;
+            }
+            depth_first_order.place(group);
+            groups.emplace_back(group);
+            auto visit_count = 0_u64;
+            for (auto i = 0u; i < group.node_count; ++i) {
+                visit_count += node_visit_counts[group.first_node_index + i];
+            }
+            group_visit_counts.emplace_back(visit_count);
+            for (auto const& child_group : depth_first_order.children_groups(group)) {
+                self(self, child_group);
+            }
+        };
+        collect_groups(collect_groups, root_children_group);
+        auto group_order = std::vector<uint32_t>(std::size(groups));
+        for (auto i = 0u; i < std::size(group_order); ++i) {
+            group_order[i] = i;
+        }
+        std::ranges::stable_sort(group_order, [&](uint32_t const a, uint32_t const b) {
+            return group_visit_counts[a] > group_visit_counts[b];
+        });
+        for (auto const group_index : group_order) {
+            sibling_group_order.place(groups[group_index]);
+        }
+        break;
+    }
+    }
+    return sibling_group_order.reordered_nodes();
+}
+
+}
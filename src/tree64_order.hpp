@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Tree64.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <span>
+
+namespace vp {
+
+// How the sibling groups follow each other in the nodes, the root stays at index 0 and each group stays contiguous
+enum class Tree64NodeOrder : uint8_t {
+    DepthFirst, // the order of build_contiguous_nodes
+    BreadthFirstTop, // the groups of the top levels breadth first, then the subtrees below them depth first
+    VanEmdeBoas, // the top half levels of each subtree clustered before its bottom subtrees, recursively
+    ProfileGuided, // the most visited groups first, the never visited ones keeping the depth first order
+};
+
+constexpr auto TREE64_NODE_ORDER_COUNT = 4u;
+constexpr auto BREADTH_FIRST_TOP_LEVEL_COUNT = 3u;
+
+// The child indices are fixed up, the nodes must use Tree64NodeAddressing::Absolute. DAGs keep their shared groups once.
+// node_visit_counts has a count per node and is only read by Tree64NodeOrder::ProfileGuided.
+[[nodiscard]] std::vector<Tree64Node> reorder_nodes(std::span<Tree64Node const> nodes, uint8_t depth, Tree64NodeOrder order,
+    std::span<uint32_t const> node_visit_counts = {});
+
+}
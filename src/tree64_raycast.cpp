@@ -0,0 +1,358 @@
+#include "tree64_raycast.hpp"
+#include "tree64_addressing.hpp"
+#include "tree64_leaf_masks.hpp"
+#include "tree64_raycast_packet.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <future>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace vp {
+
+static constexpr auto MAX_POSITION = 1.99999988079071044921875f;
+
+// The state of a traversal, in the [1, 2) space mirrored so that the ray moves in the negative direction
+struct Tree64Traversal {
+    glm::vec3 mirrored_position;
+    glm::vec3 direction;
+    glm::vec3 direction_inverse;
+    glm::vec3 current_position;
+    glm::vec3 current_distances;
+    float current_distance;
+    float max_distance;
+    uint32_t mirror_mask;
+};
+
+static glm::uvec3 as_uint(glm::vec3 const& v) {
+    return glm::uvec3(std::bit_cast<uint32_t>(v.x), std::bit_cast<uint32_t>(v.y), std::bit_cast<uint32_t>(v.z));
+}
+
+static glm::vec3 as_float(glm::uvec3 const& v) {
+    return glm::vec3(std::bit_cast<float>(v.x), std::bit_cast<float>(v.y), std::bit_cast<float>(v.z));
+}
+
+static uint32_t child_bit_index_at(glm::vec3 const& position, uint32_t const child_scale_bit_offset, uint32_t const mirror_mask) {
+    auto const child_coords = (as_uint(position) >> child_scale_bit_offset) & 3u;
+    return (child_coords.x + child_coords.z * 4u + child_coords.y * 16u) ^ mirror_mask;
+}
+
+static bool has_child_at_bit_index(Tree64Node const& node, uint32_t const child_bit_index) {
+    return (node.children_mask & (1_u64 << child_bit_index)) != 0_u64;
+}
+
+// Empty when the ray misses the root before max_distance
+static std::optional<Tree64Traversal> start_traversal(uint8_t const depth, Tree64Ray const& ray, float const max_distance) {
+    auto const depth_exp4 = static_cast<float>(1u << (depth * 2u));
+    auto const position = ray.origin / depth_exp4 + 1.f;
+    auto const direction_inverse = 1.f / ray.direction;
+    auto const aabb_min_distances = (glm::vec3(1.f) - position) * direction_inverse;
+    auto const aabb_max_distances = (glm::vec3(2.f) - position) * direction_inverse;
+    auto const current_distances = glm::min(aabb_min_distances, aabb_max_distances);
+    auto const exit_distances = glm::max(aabb_min_distances, aabb_max_distances);
+    auto const enter_distance = glm::max(glm::max(current_distances.x, current_distances.y), current_distances.z);
+    auto const exit_distance = glm::min(glm::min(exit_distances.x, exit_distances.y), exit_distances.z);
+    if (enter_distance > exit_distance || exit_distance < 0.f) {
+        return std::nullopt;
+    }
+    auto traversal = Tree64Traversal{
+        .current_distances = current_distances,
+        .current_distance = glm::max(enter_distance, 0.f),
+        .max_distance = max_distance / depth_exp4,
+    };
+    if (traversal.current_distance >= traversal.max_distance) {
+        return std::nullopt;
+    }
+    // Mirror the ray and coordinates to optimize the traversal, knowing that the ray moves in the negative direction
+    traversal.mirrored_position = glm::mix(3.f - position, position, glm::lessThanEqual(ray.direction, glm::vec3(0.f)));
+    traversal.mirror_mask = static_cast<uint32_t>(ray.direction.x > 0.f) * 0b000011u
+        | static_cast<uint32_t>(ray.direction.z > 0.f) * 0b001100u | static_cast<uint32_t>(ray.direction.y > 0.f) * 0b110000u;
+    traversal.direction = -glm::abs(ray.direction);
+    traversal.direction_inverse = 1.f / traversal.direction;
+    traversal.current_position = glm::clamp(traversal.mirrored_position + traversal.current_distance * traversal.direction,
+        glm::vec3(1.f), glm::vec3(MAX_POSITION));
+    return traversal;
+}
+
+static Tree64Hit hit_of(uint8_t const depth, Tree64Ray const& ray, glm::vec3 const& current_distances, float const current_distance) {
+    auto const world_distance = current_distance * static_cast<float>(1u << (depth * 2u));
+    auto const normal = glm::ivec3(glm::equal(glm::vec3(current_distance), current_distances)) * -glm::ivec3(glm::sign(ray.direction));
+    return Tree64Hit{ .distance = world_distance, .position = ray.origin + world_distance * ray.direction, .normal = normal };
+}
+
+// visit_node is called with the index of each node loaded, but the inlined leaf masks ones. Depth 0 traverses the trees
+// of any depth, the other depths only the trees of that depth, with a stack of that size.
+template <uint8_t Depth, typename VisitNode>
+static std::optional<Tree64Hit> raycast(ContiguousTree64 const& contiguous_tree64, Tree64Ray const& ray,
+    float const max_distance, VisitNode const& visit_node) {
+    auto const depth = Depth != 0u ? Depth : contiguous_tree64.depth;
+    auto const& nodes = contiguous_tree64.nodes;
+    auto const node_at = [&](uint64_t const node_index) {
+        if ((node_index & LEAF_MASK_INDEX_BIT) != 0_u64) {
+            return Tree64Node{ .children_mask = contiguous_tree64.leaf_masks[node_index & ~LEAF_MASK_INDEX_BIT] };
+        }
+        visit_node(node_index);
+        return nodes[node_index];
+    };
+    // As with INLINES_TREE64_LEAF_MASKS in the shader, a leaf only holds inlined leaf masks when the tree has some
+    auto const inlines_leaf_masks = !std::empty(contiguous_tree64.leaf_masks);
+    auto const is_leaf = [&](Tree64Node const& node) {
+        return node.is_leaf() && !(inlines_leaf_masks && has_inlined_leaf_masks(node));
+    };
+    auto const child_node_index = [&](uint64_t const node_index, Tree64Node const& node, uint32_t const child_bit_index) {
+        auto const before_child_mask = (1_u64 << child_bit_index) - 1_u64;
+        auto const child_offset = static_cast<uint64_t>(std::popcount(node.children_mask & before_child_mask));
+        if (node.is_leaf()) {
+            return (node.first_child_node_index() + child_offset) | LEAF_MASK_INDEX_BIT;
+        }
+        return first_child_node_index(contiguous_tree64, node_index) + child_offset;
+    };
+
+    auto traversal = start_traversal(depth, ray, max_distance);
+    if (!traversal.has_value()) {
+        return std::nullopt;
+    }
+    auto const& mirrored_position = traversal->mirrored_position;
+    auto const& direction = traversal->direction;
+    auto const& direction_inverse = traversal->direction_inverse;
+    auto const mirror_mask = traversal->mirror_mask;
+    auto& current_position = traversal->current_position;
+    auto& current_distances = traversal->current_distances;
+    auto& current_distance = traversal->current_distance;
+
+    // Indexed from the root level, the bottom entries stay unused by the trees shallower than the stack
+    constexpr auto STACK_SIZE = Depth != 0u ? uint32_t{ Depth } : uint32_t{ Tree64::MAX_DEPTH };
+    constexpr auto STACK_UNUSED_DEPTH = 11u - STACK_SIZE;
+    auto node_index_stack = std::array<uint64_t, STACK_SIZE>();
+    auto node_index = uint64_t{ 0u };
+    auto child_scale_bit_offset = ROOT_CHILD_SCALE_BIT_OFFSET;
+    while (true) {
+        // Descend to current node
+        auto node = node_at(node_index);
+        auto child_bit_index = child_bit_index_at(current_position, child_scale_bit_offset, mirror_mask);
+        auto has_child_at_child_bit = has_child_at_bit_index(node, child_bit_index);
+        while (has_child_at_child_bit && !is_leaf(node)) {
+            node_index_stack[(child_scale_bit_offset >> 1u) - STACK_UNUSED_DEPTH] = node_index;
+            node_index = child_node_index(node_index, node, child_bit_index);
+            node = node_at(node_index);
+
+            child_scale_bit_offset -= 2u;
+            child_bit_index = child_bit_index_at(current_position, child_scale_bit_offset, mirror_mask);
+            has_child_at_child_bit = has_child_at_bit_index(node, child_bit_index);
+        }
+        // Check if there is no children in the entire octant to maybe skip unnecessary iterations
+        auto const coarse_child_scale_bit_offset = child_scale_bit_offset
+            + static_cast<uint32_t>((node.children_mask & (0b00000000001100110000000000110011_u64 << (child_bit_index & 0b101010u))) == 0_u64);
+
+        auto const child_min = as_float(as_uint(current_position) & (~0u << coarse_child_scale_bit_offset));
+        if (has_child_at_child_bit) {
+            return hit_of(depth, ray, current_distances, current_distance);
+        }
+        // Advance to neighbor
+        current_distances = glm::max((child_min - mirrored_position) * direction_inverse, glm::vec3(current_distance));
+        current_distance = glm::min(glm::min(current_distances.x, current_distances.z), current_distances.y);
+        if (current_distance >= traversal->max_distance) {
+            break;
+        }
+        auto const child_min_as_uint = as_uint(child_min);
+        auto const neighbor_max = as_float(glm::mix(child_min_as_uint | ((1u << coarse_child_scale_bit_offset) - 1u),
+            child_min_as_uint - 1u, glm::equal(current_distances, glm::vec3(current_distance))));
+        current_position = glm::min(mirrored_position + current_distance * direction, neighbor_max);
+
+        // Ascend back to higher non-exited node
+        auto const binary_diff = as_uint(current_position) ^ child_min_as_uint;
+        // check only for odd offsets (quarter of nodes) and for root exit with the leading 1s, ~0u without any bit
+        auto const binary_diff_offset = static_cast<uint32_t>(std::bit_width((binary_diff.x | binary_diff.y | binary_diff.z)
+            & 0b11111111101010101010101010101010u)) - 1u;
+        if (binary_diff_offset > child_scale_bit_offset) {
+            if (binary_diff_offset > ROOT_CHILD_SCALE_BIT_OFFSET) {
+                break; // out of root
+            }
+            child_scale_bit_offset = binary_diff_offset;
+            node_index = node_index_stack[(child_scale_bit_offset >> 1u) - STACK_UNUSED_DEPTH];
+        }
+    }
+    return std::nullopt;
+}
+
+// Calls traverse with a std::integral_constant of the depth of the traversal, 0 for the one of any depth
+template <typename Traverse>
+static void with_traversal_depth(uint8_t const depth, bool const specializes_depth, Traverse const& traverse) {
+    auto const is_specialized = specializes_depth && []<uint8_t... Depths>(uint8_t const tree_depth, Traverse const& traverse_depth,
+        std::integer_sequence<uint8_t, Depths...>) {
+        return ((tree_depth == Depths + 1u && (traverse_depth(std::integral_constant<uint8_t, Depths + 1u>()), true)) || ...);
+    }(depth, traverse, std::make_integer_sequence<uint8_t, Tree64::MAX_DEPTH>());
+    if (!is_specialized) {
+        traverse(std::integral_constant<uint8_t, 0u>());
+    }
+}
+
+std::optional<Tree64Hit> raycast(ContiguousTree64 const& contiguous_tree64, Tree64Ray const& ray,
+    float const max_distance, std::span<uint32_t> const node_visit_counts) {
+    auto hit = std::optional<Tree64Hit>();
+    with_traversal_depth(contiguous_tree64.depth, true, [&](auto const depth) {
+        if (std::empty(node_visit_counts)) {
+            hit = raycast<decltype(depth)::value>(contiguous_tree64, ray, max_distance, [](uint64_t) {});
+            return;
+        }
+        hit = raycast<decltype(depth)::value>(contiguous_tree64, ray, max_distance, [&](uint64_t const node_index) {
+            node_visit_counts[node_index] += 1u;
+        });
+    });
+    return hit;
+}
+
+// Casts up to 8 rays with a packet kernel, the hits are the ones of the scalar traversal
+template <uint8_t Depth>
+static void raycast_packet(ContiguousTree64 const& contiguous_tree64, std::span<Tree64Ray const> const rays,
+    float const max_distance, Tree64RaycastKernel const kernel, std::span<std::optional<Tree64Hit>> const hits) {
+    auto const depth = Depth != 0u ? Depth : contiguous_tree64.depth;
+    auto packet = Tree64RayPacket{ .active_lane_mask = 0u };
+    auto traversals = std::array<Tree64Traversal, TREE64_RAY_PACKET_SIZE>();
+    for (auto lane = 0u; lane < TREE64_RAY_PACKET_SIZE; ++lane) {
+        auto const traversal = lane < std::size(rays) ? start_traversal(depth, rays[lane], max_distance) : std::nullopt;
+        if (traversal.has_value()) {
+            traversals[lane] = traversal.value();
+            packet.active_lane_mask |= 1u << lane;
+        }
+        // The inactive lanes keep finite values
+        auto const& lane_traversal = traversals[lane];
+        for (auto axis = 0u; axis < 3u; ++axis) {
+            packet.mirrored_positions[axis][lane] = lane_traversal.mirrored_position[static_cast<int>(axis)];
+            packet.directions[axis][lane] = lane_traversal.direction[static_cast<int>(axis)];
+            packet.direction_inverses[axis][lane] = lane_traversal.direction_inverse[static_cast<int>(axis)];
+            packet.current_positions[axis][lane] = lane_traversal.current_position[static_cast<int>(axis)];
+            packet.current_distances[axis][lane] = lane_traversal.current_distances[static_cast<int>(axis)];
+        }
+        packet.current_distance[lane] = lane_traversal.current_distance;
+        packet.max_distance[lane] = lane_traversal.max_distance;
+        packet.mirror_masks[lane] = lane_traversal.mirror_mask;
+    }
+    auto const tree = Tree64PacketTree{
+        .nodes = std::data(contiguous_tree64.nodes),
+        .far_offsets = std::data(contiguous_tree64.far_offsets),
+        .leaf_masks = std::data(contiguous_tree64.leaf_masks),
+        .uses_relative_addressing = contiguous_tree64.addressing == Tree64NodeAddressing::Relative,
+        .inlines_leaf_masks = !std::empty(contiguous_tree64.leaf_masks),
+    };
+#ifdef VP_X86
+    if (kernel == Tree64RaycastKernel::Avx2) {
+        raycast_packet_avx2(tree, packet);
+    } else {
+        raycast_packet_sse41(tree, packet);
+    }
+#else
+    static_cast<void>(tree);
+    static_cast<void>(kernel);
+#endif
+    for (auto lane = 0u; lane < std::size(rays); ++lane) {
+        if ((packet.hit_lane_mask & (1u << lane)) == 0u) {
+            hits[lane] = std::nullopt;
+            continue;
+        }
+        auto const current_distances = glm::vec3(packet.current_distances[0][lane], packet.current_distances[1][lane],
+            packet.current_distances[2][lane]);
+        hits[lane] = hit_of(depth, rays[lane], current_distances, packet.current_distance[lane]);
+    }
+}
+
+// The rays are taken by chunks from a shared counter, the neighboring rays of an image cost about the same
+std::vector<std::optional<Tree64Hit>> raycast(ContiguousTree64 const& contiguous_tree64,
+    std::span<Tree64Ray const> const rays, float const max_distance, std::span<uint32_t> const node_visit_counts,
+    Tree64RaycastKernel const kernel, bool const specializes_depth) {
+    constexpr auto CHUNK_RAY_COUNT = size_t{ 256u };
+    auto hits = std::vector<std::optional<Tree64Hit>>(std::size(rays));
+    auto const chunk_count = (std::size(rays) + CHUNK_RAY_COUNT - 1u) / CHUNK_RAY_COUNT;
+    auto next_chunk_index = std::atomic<size_t>(0u);
+    auto const raycast_chunks = [&]() {
+        for (auto i = next_chunk_index++; i < chunk_count; i = next_chunk_index++) {
+            auto const first_ray_index = i * CHUNK_RAY_COUNT;
+            auto const ray_count = std::min(CHUNK_RAY_COUNT, std::size(rays) - first_ray_index);
+            if (std::empty(node_visit_counts)) {
+                raycast_on_calling_thread(contiguous_tree64, rays.subspan(first_ray_index, ray_count), max_distance,
+                    std::span(hits).subspan(first_ray_index, ray_count), kernel, specializes_depth);
+                continue;
+            }
+            with_traversal_depth(contiguous_tree64.depth, specializes_depth, [&](auto const depth) {
+                for (auto ray_index = first_ray_index; ray_index < first_ray_index + ray_count; ++ray_index) {
+                    hits[ray_index] = raycast<decltype(depth)::value>(contiguous_tree64, rays[ray_index], max_distance,
+                        [&](uint64_t const node_index) {
+                        std::atomic_ref(node_visit_counts[node_index]).fetch_add(1u, std::memory_order_relaxed);
+                    });
+                }
+            });
+        }
+    };
+    auto const thread_count = static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 1u));
+    auto workers = std::vector<std::future<void>>();
+    for (auto i = size_t{ 1u }; i < std::min(thread_count, chunk_count); ++i) {
+        workers.emplace_back(std::async(std::launch::async, raycast_chunks));
+    }
+    raycast_chunks();
+    for (auto& worker : workers) {
+        worker.get();
+    }
+    return hits;
+}
+
+void raycast_on_calling_thread(ContiguousTree64 const& contiguous_tree64, std::span<Tree64Ray const> const rays,
+    float const max_distance, std::span<std::optional<Tree64Hit>> const hits, Tree64RaycastKernel const kernel,
+    bool const specializes_depth) {
+    // A kernel the CPU does not support falls back to the fastest one it does
+    auto const supported_kernel = std::min(kernel, fastest_raycast_kernel());
+    with_traversal_depth(contiguous_tree64.depth, specializes_depth, [&](auto const depth) {
+        if (supported_kernel == Tree64RaycastKernel::Scalar) {
+            for (auto ray_index = size_t{ 0u }; ray_index < std::size(rays); ++ray_index) {
+                hits[ray_index] = raycast<decltype(depth)::value>(contiguous_tree64, rays[ray_index], max_distance, [](uint64_t) {});
+            }
+            return;
+        }
+        for (auto ray_index = size_t{ 0u }; ray_index < std::size(rays); ray_index += TREE64_RAY_PACKET_SIZE) {
+            auto const ray_count = std::min(size_t{ TREE64_RAY_PACKET_SIZE }, std::size(rays) - ray_index);
+            raycast_packet<decltype(depth)::value>(contiguous_tree64, rays.subspan(ray_index, ray_count), max_distance,
+                supported_kernel, hits.subspan(ray_index, ray_count));
+        }
+    });
+}
+
+static Tree64RaycastKernel detect_fastest_raycast_kernel() {
+#if defined(VP_X86) && defined(_MSC_VER)
+    auto registers = std::array<int, 4u>();
+    __cpuid(std::data(registers), 0);
+    auto const max_function = registers[0];
+    __cpuid(std::data(registers), 1);
+    auto const has_sse41 = (registers[2] & (1 << 19)) != 0;
+    // AVX needs the OS to save the ymm registers
+    auto const has_os_avx = (registers[2] & (1 << 27)) != 0 && (registers[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0b110u) == 0b110u;
+    auto has_avx2 = false;
+    if (max_function >= 7 && has_os_avx) {
+        __cpuidex(std::data(registers), 7, 0);
+        has_avx2 = (registers[1] & (1 << 5)) != 0;
+    }
+#elif defined(VP_X86)
+    __builtin_cpu_init();
+    auto const has_sse41 = __builtin_cpu_supports("sse4.1") != 0;
+    auto const has_avx2 = __builtin_cpu_supports("avx2") != 0;
+#else
+    auto const has_sse41 = false;
+    auto const has_avx2 = false;
+#endif
+    if (has_avx2) {
+        return Tree64RaycastKernel::Avx2;
+    }
+    return has_sse41 ? Tree64RaycastKernel::Sse41 : Tree64RaycastKernel::Scalar;
+}
+
+Tree64RaycastKernel fastest_raycast_kernel() {
+    static auto const kernel = detect_fastest_raycast_kernel();
+    return kernel;
+}
+
+}
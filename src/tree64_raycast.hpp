@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Tree64.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace vp {
+
+struct Tree64Ray {
+    glm::vec3 origin;
+    glm::vec3 direction; // normalized
+};
+
+struct Tree64Hit {
+    float distance;
+    glm::vec3 position;
+    glm::ivec3 normal; // zero when the ray starts inside a voxel
+};
+
+// Port of Tree64::raycast of the raytracing shader, in the same world space where a voxel is a unit cube.
+// node_visit_counts is empty or has a count per node, incremented on each node load of the traversal but the inlined
+// leaf masks ones.
+[[nodiscard]] std::optional<Tree64Hit> raycast(ContiguousTree64 const& contiguous_tree64, Tree64Ray const& ray,
+    float max_distance, std::span<uint32_t> node_visit_counts = {});
+
+// The batches trace packets of 8 consecutive rays with a SIMD kernel, which pays off when they are coherent
+enum class Tree64RaycastKernel : uint8_t {
+    Scalar,
+    Sse41,
+    Avx2,
+};
+
+// Detected with CPUID
+[[nodiscard]] Tree64RaycastKernel fastest_raycast_kernel();
+
+// Casts the rays on all the cores, the hit of rays[i] is at index i. The visits are counted as above, with atomic
+// increments shared by the threads, and only by the scalar kernel. The hits do not depend on the kernel.
+// The traversal is instantiated for each depth, specializes_depth false takes the one of any depth instead.
+[[nodiscard]] std::vector<std::optional<Tree64Hit>> raycast(ContiguousTree64 const& contiguous_tree64,
+    std::span<Tree64Ray const> rays, float max_distance, std::span<uint32_t> node_visit_counts = {},
+    Tree64RaycastKernel kernel = fastest_raycast_kernel(), bool specializes_depth = true);
+
+// Casts the rays on the calling thread, for the callers which spread their own work on the cores. hits has a hit per ray.
+void raycast_on_calling_thread(ContiguousTree64 const& contiguous_tree64, std::span<Tree64Ray const> rays,
+    float max_distance, std::span<std::optional<Tree64Hit>> hits, Tree64RaycastKernel kernel = fastest_raycast_kernel(),
+    bool specializes_depth = true);
+
+}
@@ -0,0 +1,62 @@
+#include "tree64_raycast_packet.hpp"
+
+#ifdef VP_X86
+
+#include <immintrin.h>
+
+namespace vp {
+
+namespace {
+
+// min and max take their arguments swapped to return the same operand as glm when they are equal or NaN
+struct Avx2Lanes {
+    using Floats = __m256;
+    using Uints = __m256i;
+
+    static Floats load(float const* const values) { return _mm256_loadu_ps(values); }
+    static Uints load(uint32_t const* const values) { return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(values)); }
+    static void store(float* const values, Floats const v) { _mm256_storeu_ps(values, v); }
+    static void store(uint32_t* const values, Uints const v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(values), v); }
+    static Uints set1(uint32_t const value) { return _mm256_set1_epi32(static_cast<int>(value)); }
+
+    static Floats add(Floats const a, Floats const b) { return _mm256_add_ps(a, b); }
+    static Floats sub(Floats const a, Floats const b) { return _mm256_sub_ps(a, b); }
+    static Floats mul(Floats const a, Floats const b) { return _mm256_mul_ps(a, b); }
+    static Floats min(Floats const a, Floats const b) { return _mm256_min_ps(b, a); }
+    static Floats max(Floats const a, Floats const b) { return _mm256_max_ps(b, a); }
+    static Uints equal(Floats const a, Floats const b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_EQ_OQ)); }
+    static uint32_t greater_equal_lane_mask(Floats const a, Floats const b) {
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ)));
+    }
+
+    static Uints sub(Uints const a, Uints const b) { return _mm256_sub_epi32(a, b); }
+    static Uints bit_and(Uints const a, Uints const b) { return _mm256_and_si256(a, b); }
+    static Uints bit_or(Uints const a, Uints const b) { return _mm256_or_si256(a, b); }
+    static Uints bit_xor(Uints const a, Uints const b) { return _mm256_xor_si256(a, b); }
+    static Uints shift_left(Uints const a, Uints const counts) { return _mm256_sllv_epi32(a, counts); }
+    static Uints shift_right(Uints const a, uint32_t const count) { return _mm256_srli_epi32(a, static_cast<int>(count)); }
+
+    static Uints as_uints(Floats const v) { return _mm256_castps_si256(v); }
+    static Floats as_floats(Uints const v) { return _mm256_castsi256_ps(v); }
+    // condition lanes are all ones or all zeros
+    static Floats select(Uints const condition, Floats const a, Floats const b) {
+        return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(condition));
+    }
+    static Uints select(Uints const condition, Uints const a, Uints const b) {
+        return _mm256_blendv_epi8(b, a, condition);
+    }
+    static Uints lane_mask(uint32_t const lane_bits) {
+        auto const lane_bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        return _mm256_cmpeq_epi32(_mm256_and_si256(set1(lane_bits), lane_bit), lane_bit);
+    }
+};
+
+}
+
+void raycast_packet_avx2(Tree64PacketTree const& tree, Tree64RayPacket& packet) {
+    raycast_packet<Avx2Lanes>(tree, packet);
+}
+
+}
+
+#endif
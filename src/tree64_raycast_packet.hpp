@@ -0,0 +1,235 @@
+#pragma once
+
+#include "Tree64.hpp"
+
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VP_X86
+#endif
+
+// The packet kernels live in their own translation units, compiled for their instruction set and only called when the
+// CPU supports it. They only use intrinsics, plain data and the functions below, so that no inline function shared
+// with the other translation units gets emitted with that instruction set.
+
+namespace vp {
+
+// The positions are mapped to [1, 2) where the 23 mantissa bits hold 11 levels, 2 bits each
+static constexpr auto UNUSED_DEPTH = 11u - Tree64::MAX_DEPTH;
+static constexpr auto ROOT_CHILD_SCALE_BIT_OFFSET = 21u;
+static constexpr auto LEAF_MASK_INDEX_BIT = 1_u64 << 63u; // the node indices of the inlined leaf masks have it
+
+static constexpr auto TREE64_RAY_PACKET_SIZE = 8u;
+
+struct Tree64PacketTree {
+    Tree64Node const* nodes;
+    uint64_t const* far_offsets; // only with Tree64NodeAddressing::Relative
+    uint64_t const* leaf_masks;
+    bool uses_relative_addressing;
+    bool inlines_leaf_masks; // the leaves with a non zero first child node index are parents of inlined leaf masks
+};
+
+// The traversal state of each lane, in the mirrored space of the scalar traversal which sets it up.
+// The lanes that hit are left with their state at the hit.
+struct Tree64RayPacket {
+    float mirrored_positions[3][TREE64_RAY_PACKET_SIZE];
+    float directions[3][TREE64_RAY_PACKET_SIZE];
+    float direction_inverses[3][TREE64_RAY_PACKET_SIZE];
+    float current_positions[3][TREE64_RAY_PACKET_SIZE];
+    float current_distances[3][TREE64_RAY_PACKET_SIZE];
+    float current_distance[TREE64_RAY_PACKET_SIZE];
+    float max_distance[TREE64_RAY_PACKET_SIZE];
+    uint32_t mirror_masks[TREE64_RAY_PACKET_SIZE];
+    uint32_t active_lane_mask;
+    uint32_t hit_lane_mask;
+};
+
+// Only defined with VP_X86
+void raycast_packet_sse41(Tree64PacketTree const& tree, Tree64RayPacket& packet);
+void raycast_packet_avx2(Tree64PacketTree const& tree, Tree64RayPacket& packet);
+
+// std::bit_width - 1, ~0u without any bit
+static inline uint32_t highest_bit_index(uint32_t const value) {
+    if (value == 0u) {
+        return ~0u;
+    }
+#ifdef _MSC_VER
+    auto index = 0ul;
+    _BitScanReverse(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return 31u - static_cast<uint32_t>(__builtin_clz(value));
+#endif
+}
+
+static inline uint32_t lowest_bit_index(uint32_t const value) {
+#ifdef _MSC_VER
+    auto index = 0ul;
+    _BitScanForward(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(value));
+#endif
+}
+
+static inline uint32_t bit_count(uint64_t value) {
+#ifdef _MSC_VER
+    // __popcnt64 needs POPCNT, which the SSE4.1 CPUs may lack
+    value -= (value >> 1u) & 0x5555555555555555_u64;
+    value = (value & 0x3333333333333333_u64) + ((value >> 2u) & 0x3333333333333333_u64);
+    value = (value + (value >> 4u)) & 0x0F0F0F0F0F0F0F0F_u64;
+    return static_cast<uint32_t>((value * 0x0101010101010101_u64) >> 56u);
+#else
+    return static_cast<uint32_t>(__builtin_popcountll(value));
+#endif
+}
+
+// The lanes run the scalar traversal in lockstep, one step per iteration: a descent, a hit, or an advance to the
+// neighbor followed by an ascent. The float math of the advances is vectorized, the node fetches and the stacks stay
+// per lane, and a node is fetched once for all the consecutive lanes on it, as the coherent rays mostly are.
+// Lanes provides the 8 lanes float and uint vectors and their operations, with the same semantics as glm. The
+// variable shift counts stay below 31.
+template <typename Lanes>
+static void raycast_packet(Tree64PacketTree const& tree, Tree64RayPacket& packet) {
+    using Floats = typename Lanes::Floats;
+    using Uints = typename Lanes::Uints;
+
+    Floats mirrored_position[3];
+    Floats direction[3];
+    Floats direction_inverse[3];
+    Floats current_position[3];
+    Floats current_distances[3];
+    for (auto axis = 0u; axis < 3u; ++axis) {
+        mirrored_position[axis] = Lanes::load(packet.mirrored_positions[axis]);
+        direction[axis] = Lanes::load(packet.directions[axis]);
+        direction_inverse[axis] = Lanes::load(packet.direction_inverses[axis]);
+        current_position[axis] = Lanes::load(packet.current_positions[axis]);
+        current_distances[axis] = Lanes::load(packet.current_distances[axis]);
+    }
+    auto current_distance = Lanes::load(packet.current_distance);
+    auto const max_distance = Lanes::load(packet.max_distance);
+    auto const mirror_mask = Lanes::load(packet.mirror_masks);
+
+    // Indexed from the root level, the bottom entries stay unused by the trees shallower than MAX_DEPTH
+    uint64_t node_index_stacks[Tree64::MAX_DEPTH][TREE64_RAY_PACKET_SIZE];
+    uint64_t node_indices[TREE64_RAY_PACKET_SIZE] = {};
+    uint32_t child_scale_bit_offsets[TREE64_RAY_PACKET_SIZE];
+    uint32_t coarse_child_scale_bit_offsets[TREE64_RAY_PACKET_SIZE] = {};
+    uint32_t child_bit_indices[TREE64_RAY_PACKET_SIZE];
+    uint32_t binary_diffs[TREE64_RAY_PACKET_SIZE];
+    for (auto lane = 0u; lane < TREE64_RAY_PACKET_SIZE; ++lane) {
+        child_scale_bit_offsets[lane] = ROOT_CHILD_SCALE_BIT_OFFSET;
+    }
+    auto active_lane_mask = packet.active_lane_mask;
+    auto hit_lane_mask = 0u;
+    while (active_lane_mask != 0u) {
+        auto const child_scale_bit_offset = Lanes::load(child_scale_bit_offsets);
+        // The 2 bits at the offset are moved to the top then back down, the variable shifts only go left
+        auto const child_shift = Lanes::sub(Lanes::set1(30u), child_scale_bit_offset);
+        auto const child_x = Lanes::shift_right(Lanes::shift_left(Lanes::as_uints(current_position[0]), child_shift), 30u);
+        auto const child_y = Lanes::shift_right(Lanes::shift_left(Lanes::as_uints(current_position[1]), child_shift), 30u);
+        auto const child_z = Lanes::shift_right(Lanes::shift_left(Lanes::as_uints(current_position[2]), child_shift), 30u);
+        Lanes::store(child_bit_indices, Lanes::bit_xor(Lanes::bit_or(child_x,
+            Lanes::bit_or(Lanes::shift_left(child_z, Lanes::set1(2u)), Lanes::shift_left(child_y, Lanes::set1(4u)))), mirror_mask));
+
+        auto advancing_lane_mask = 0u;
+        auto fetched_node_index = ~0_u64;
+        auto node = Tree64Node();
+        for (auto lanes = active_lane_mask; lanes != 0u; lanes &= lanes - 1u) {
+            auto const lane = lowest_bit_index(lanes);
+            auto const node_index = node_indices[lane];
+            if (node_index != fetched_node_index) {
+                node = (node_index & LEAF_MASK_INDEX_BIT) != 0_u64
+                    ? Tree64Node{ .children_mask = tree.leaf_masks[node_index & ~LEAF_MASK_INDEX_BIT] } : tree.nodes[node_index];
+                fetched_node_index = node_index;
+            }
+            auto const child_bit_index = child_bit_indices[lane];
+            auto const has_child = (node.children_mask & (1_u64 << child_bit_index)) != 0_u64;
+            auto const node_bits = node.is_leaf_and_first_child_node_index;
+            auto const is_leaf = (node_bits & 1u) == 1u && (node_bits == 1u || !tree.inlines_leaf_masks);
+            if (has_child && !is_leaf) {
+                // Descend
+                auto const child_offset = uint64_t{ bit_count(node.children_mask & ((1_u64 << child_bit_index) - 1_u64)) };
+                auto first_child_node_index = uint64_t{ node_bits >> 1u };
+                if ((node_bits & 1u) == 1u) {
+                    first_child_node_index |= LEAF_MASK_INDEX_BIT;
+                } else if (tree.uses_relative_addressing) {
+                    first_child_node_index = node_index + ((first_child_node_index & 1u) == 0u
+                        ? first_child_node_index >> 1u : tree.far_offsets[first_child_node_index >> 1u]);
+                }
+                node_index_stacks[(child_scale_bit_offsets[lane] >> 1u) - UNUSED_DEPTH][lane] = node_index;
+                node_indices[lane] = first_child_node_index + child_offset;
+                child_scale_bit_offsets[lane] -= 2u;
+            } else if (has_child) {
+                hit_lane_mask |= 1u << lane;
+            } else {
+                // Check if there is no children in the entire octant to maybe skip unnecessary iterations
+                coarse_child_scale_bit_offsets[lane] = child_scale_bit_offsets[lane]
+                    + static_cast<uint32_t>((node.children_mask & (0b00000000001100110000000000110011_u64 << (child_bit_index & 0b101010u))) == 0_u64);
+                advancing_lane_mask |= 1u << lane;
+            }
+        }
+        active_lane_mask &= ~hit_lane_mask;
+        if (advancing_lane_mask == 0u) {
+            continue;
+        }
+
+        // Advance to neighbor
+        auto const coarse_child_scale_bit_offset = Lanes::load(coarse_child_scale_bit_offsets);
+        auto const all_ones = Lanes::set1(~0u);
+        auto const one = Lanes::set1(1u);
+        Uints child_min_as_uint[3];
+        Floats next_current_distances[3];
+        for (auto axis = 0u; axis < 3u; ++axis) {
+            child_min_as_uint[axis] = Lanes::bit_and(Lanes::as_uints(current_position[axis]),
+                Lanes::shift_left(all_ones, coarse_child_scale_bit_offset));
+            next_current_distances[axis] = Lanes::max(Lanes::mul(Lanes::sub(Lanes::as_floats(child_min_as_uint[axis]),
+                mirrored_position[axis]), direction_inverse[axis]), current_distance);
+        }
+        auto const next_current_distance = Lanes::min(Lanes::min(next_current_distances[0], next_current_distances[2]),
+            next_current_distances[1]);
+        auto const exiting_lane_mask = advancing_lane_mask & Lanes::greater_equal_lane_mask(next_current_distance, max_distance);
+        auto const neighbor_max_low_bits = Lanes::sub(Lanes::shift_left(one, coarse_child_scale_bit_offset), one);
+        auto binary_diff = Lanes::set1(0u);
+        auto const advancing = Lanes::lane_mask(advancing_lane_mask);
+        for (auto axis = 0u; axis < 3u; ++axis) {
+            auto const neighbor_max = Lanes::as_floats(Lanes::select(Lanes::equal(next_current_distances[axis], next_current_distance),
+                Lanes::sub(child_min_as_uint[axis], one), Lanes::bit_or(child_min_as_uint[axis], neighbor_max_low_bits)));
+            auto const next_current_position = Lanes::min(Lanes::add(mirrored_position[axis],
+                Lanes::mul(next_current_distance, direction[axis])), neighbor_max);
+            binary_diff = Lanes::bit_or(binary_diff, Lanes::bit_xor(Lanes::as_uints(next_current_position), child_min_as_uint[axis]));
+            current_position[axis] = Lanes::select(advancing, next_current_position, current_position[axis]);
+            current_distances[axis] = Lanes::select(advancing, next_current_distances[axis], current_distances[axis]);
+        }
+        current_distance = Lanes::select(advancing, next_current_distance, current_distance);
+        active_lane_mask &= ~exiting_lane_mask;
+
+        // Ascend back to higher non-exited node
+        // check only for odd offsets (quarter of nodes) and for root exit with the leading 1s
+        Lanes::store(binary_diffs, Lanes::bit_and(binary_diff, Lanes::set1(0b11111111101010101010101010101010u)));
+        for (auto lanes = advancing_lane_mask & ~exiting_lane_mask; lanes != 0u; lanes &= lanes - 1u) {
+            auto const lane = lowest_bit_index(lanes);
+            auto const binary_diff_offset = highest_bit_index(binary_diffs[lane]);
+            if (binary_diff_offset > child_scale_bit_offsets[lane]) {
+                if (binary_diff_offset > ROOT_CHILD_SCALE_BIT_OFFSET) {
+                    active_lane_mask &= ~(1u << lane); // out of root
+                    continue;
+                }
+                child_scale_bit_offsets[lane] = binary_diff_offset;
+                node_indices[lane] = node_index_stacks[(binary_diff_offset >> 1u) - UNUSED_DEPTH][lane];
+            }
+        }
+    }
+
+    for (auto axis = 0u; axis < 3u; ++axis) {
+        Lanes::store(packet.current_positions[axis], current_position[axis]);
+        Lanes::store(packet.current_distances[axis], current_distances[axis]);
+    }
+    Lanes::store(packet.current_distance, current_distance);
+    packet.hit_lane_mask = hit_lane_mask;
+}
+
+}
@@ -0,0 +1,94 @@
+#include "tree64_raycast_packet.hpp"
+
+#ifdef VP_X86
+
+#include <smmintrin.h>
+
+namespace vp {
+
+namespace {
+
+// The 8 lanes are two halves of 4.
+// min and max take their arguments swapped to return the same operand as glm when they are equal or NaN.
+struct Sse41Lanes {
+    struct Floats {
+        __m128 low;
+        __m128 high;
+    };
+    struct Uints {
+        __m128i low;
+        __m128i high;
+    };
+
+    static Floats load(float const* const values) { return { _mm_loadu_ps(values), _mm_loadu_ps(values + 4) }; }
+    static Uints load(uint32_t const* const values) {
+        return { _mm_loadu_si128(reinterpret_cast<__m128i const*>(values)), _mm_loadu_si128(reinterpret_cast<__m128i const*>(values + 4)) };
+    }
+    static void store(float* const values, Floats const v) {
+        _mm_storeu_ps(values, v.low);
+        _mm_storeu_ps(values + 4, v.high);
+    }
+    static void store(uint32_t* const values, Uints const v) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values), v.low);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + 4), v.high);
+    }
+    static Uints set1(uint32_t const value) {
+        auto const v = _mm_set1_epi32(static_cast<int>(value));
+        return { v, v };
+    }
+
+    static Floats add(Floats const a, Floats const b) { return { _mm_add_ps(a.low, b.low), _mm_add_ps(a.high, b.high) }; }
+    static Floats sub(Floats const a, Floats const b) { return { _mm_sub_ps(a.low, b.low), _mm_sub_ps(a.high, b.high) }; }
+    static Floats mul(Floats const a, Floats const b) { return { _mm_mul_ps(a.low, b.low), _mm_mul_ps(a.high, b.high) }; }
+    static Floats min(Floats const a, Floats const b) { return { _mm_min_ps(b.low, a.low), _mm_min_ps(b.high, a.high) }; }
+    static Floats max(Floats const a, Floats const b) { return { _mm_max_ps(b.low, a.low), _mm_max_ps(b.high, a.high) }; }
+    static Uints equal(Floats const a, Floats const b) {
+        return { _mm_castps_si128(_mm_cmpeq_ps(a.low, b.low)), _mm_castps_si128(_mm_cmpeq_ps(a.high, b.high)) };
+    }
+    static uint32_t greater_equal_lane_mask(Floats const a, Floats const b) {
+        return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(a.low, b.low)) | (_mm_movemask_ps(_mm_cmpge_ps(a.high, b.high)) << 4));
+    }
+
+    static Uints sub(Uints const a, Uints const b) { return { _mm_sub_epi32(a.low, b.low), _mm_sub_epi32(a.high, b.high) }; }
+    static Uints bit_and(Uints const a, Uints const b) { return { _mm_and_si128(a.low, b.low), _mm_and_si128(a.high, b.high) }; }
+    static Uints bit_or(Uints const a, Uints const b) { return { _mm_or_si128(a.low, b.low), _mm_or_si128(a.high, b.high) }; }
+    static Uints bit_xor(Uints const a, Uints const b) { return { _mm_xor_si128(a.low, b.low), _mm_xor_si128(a.high, b.high) }; }
+    // By multiplying with the powers of 2 built as floats
+    static Uints shift_left(Uints const a, Uints const counts) {
+        auto const powers_of_2 = [](__m128i const c) {
+            return _mm_cvttps_epi32(_mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(c, _mm_set1_epi32(127)), 23)));
+        };
+        return { _mm_mullo_epi32(a.low, powers_of_2(counts.low)), _mm_mullo_epi32(a.high, powers_of_2(counts.high)) };
+    }
+    static Uints shift_right(Uints const a, uint32_t const count) {
+        return { _mm_srli_epi32(a.low, static_cast<int>(count)), _mm_srli_epi32(a.high, static_cast<int>(count)) };
+    }
+
+    static Uints as_uints(Floats const v) { return { _mm_castps_si128(v.low), _mm_castps_si128(v.high) }; }
+    static Floats as_floats(Uints const v) { return { _mm_castsi128_ps(v.low), _mm_castsi128_ps(v.high) }; }
+    // condition lanes are all ones or all zeros
+    static Floats select(Uints const condition, Floats const a, Floats const b) {
+        return { _mm_blendv_ps(b.low, a.low, _mm_castsi128_ps(condition.low)),
+            _mm_blendv_ps(b.high, a.high, _mm_castsi128_ps(condition.high)) };
+    }
+    static Uints select(Uints const condition, Uints const a, Uints const b) {
+        return { _mm_blendv_epi8(b.low, a.low, condition.low), _mm_blendv_epi8(b.high, a.high, condition.high) };
+    }
+    static Uints lane_mask(uint32_t const lane_bits) {
+        auto const bits = _mm_set1_epi32(static_cast<int>(lane_bits));
+        auto const low_lane_bit = _mm_setr_epi32(1, 2, 4, 8);
+        auto const high_lane_bit = _mm_setr_epi32(16, 32, 64, 128);
+        return { _mm_cmpeq_epi32(_mm_and_si128(bits, low_lane_bit), low_lane_bit),
+            _mm_cmpeq_epi32(_mm_and_si128(bits, high_lane_bit), high_lane_bit) };
+    }
+};
+
+}
+
+void raycast_packet_sse41(Tree64PacketTree const& tree, Tree64RayPacket& packet) {
+    raycast_packet<Sse41Lanes>(tree, packet);
+}
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include "tree64_render.hpp"
+#include "BinaryFstream.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace vp {
+
+static constexpr auto HALF_VERTICAL_FOV = glm::radians(75.f / 2.f); // This must match the GPU side!
+static constexpr auto TILE_SIDE = 32u;
+
+static uint8_t srgb_from_linear(float const linear) {
+    auto const clamped = glm::clamp(linear, 0.f, 1.f);
+    auto const srgb = clamped <= 0.0031308f ? clamped * 12.92f : 1.055f * glm::pow(clamped, 1.f / 2.4f) - 0.055f;
+    return static_cast<uint8_t>(srgb * 255.f + 0.5f);
+}
+
+// Shades the pixels of a tile like the fragment shader, the shadow rays are traced together after the primary ones
+static uint64_t render_tile(ContiguousTree64 const& contiguous_tree64, Tree64RenderSettings const& settings,
+    glm::uvec2 const& tile_min, glm::uvec2 const& tile_max, std::span<glm::vec3> const colors) {
+    auto const half_resolution = glm::vec2(settings.resolution) / 2.f;
+    auto const ray_forward = 1.f / glm::tan(HALF_VERTICAL_FOV);
+    auto rays = std::vector<Tree64Ray>();
+    for (auto y = tile_min.y; y < tile_max.y; ++y) {
+        for (auto x = tile_min.x; x < tile_max.x; ++x) {
+            auto const pixel_center = glm::vec2(x, y) + 0.5f;
+            auto const direction = settings.camera_rotation * glm::vec3((pixel_center.x - half_resolution.x) / half_resolution.y,
+                -(pixel_center.y - half_resolution.y) / half_resolution.y, ray_forward);
+            rays.emplace_back(Tree64Ray{ .origin = settings.camera_position, .direction = glm::normalize(direction) });
+        }
+    }
+    auto hits = std::vector<std::optional<Tree64Hit>>(std::size(rays));
+    raycast_on_calling_thread(contiguous_tree64, rays, 1.e6f, hits, settings.kernel);
+
+    auto diffuse_factors = std::vector<float>(std::size(rays));
+    auto shadow_rays = std::vector<Tree64Ray>();
+    auto shadow_ray_pixel_indices = std::vector<size_t>();
+    for (auto i = size_t{ 0u }; i < std::size(rays); ++i) {
+        if (!hits[i].has_value()) {
+            continue;
+        }
+        auto const& hit = hits[i].value();
+        diffuse_factors[i] = glm::dot(glm::vec3(hit.normal), settings.to_sun_direction) * 0.5f + 0.5f;
+        if (diffuse_factors[i] > 0.5f) {
+            auto const voxel_face_center = glm::mix(hit.position + glm::vec3(hit.normal) * 0.005f, glm::floor(hit.position) + 0.5f,
+                glm::equal(hit.normal, glm::ivec3(0)));
+            shadow_rays.emplace_back(Tree64Ray{ .origin = voxel_face_center, .direction = settings.to_sun_direction });
+            shadow_ray_pixel_indices.emplace_back(i);
+        }
+    }
+    auto shadow_hits = std::vector<std::optional<Tree64Hit>>(std::size(shadow_rays));
+    raycast_on_calling_thread(contiguous_tree64, shadow_rays, 1.e6f, shadow_hits, settings.kernel);
+    auto light_multipliers = std::vector<float>(std::size(rays), 0.5f);
+    for (auto i = size_t{ 0u }; i < std::size(shadow_rays); ++i) {
+        light_multipliers[shadow_ray_pixel_indices[i]] = shadow_hits[i].has_value() ? 0.5f : 1.f;
+    }
+
+    auto const tile_width = tile_max.x - tile_min.x;
+    for (auto i = size_t{ 0u }; i < std::size(rays); ++i) {
+        auto const pixel = tile_min + glm::uvec2(static_cast<uint32_t>(i % tile_width), static_cast<uint32_t>(i / tile_width));
+        colors[pixel.y * settings.resolution.x + pixel.x] = hits[i].has_value() ? glm::vec3(light_multipliers[i] * diffuse_factors[i])
+            : sky_color(settings.sky, rays[i].direction, settings.to_sun_direction);
+    }
+    return std::size(rays) + std::size(shadow_rays);
+}
+
+Tree64Image render(ContiguousTree64 const& contiguous_tree64, Tree64RenderSettings const& settings) {
+    auto image = Tree64Image{
+        .resolution = settings.resolution,
+        .colors = std::vector<glm::vec3>(static_cast<size_t>(settings.resolution.x) * settings.resolution.y),
+    };
+    auto const tile_counts = (settings.resolution + (TILE_SIDE - 1u)) / TILE_SIDE;
+    auto const tile_count = static_cast<size_t>(tile_counts.x) * tile_counts.y;
+    auto next_tile_index = std::atomic<size_t>(0u);
+    auto ray_count = std::atomic<uint64_t>(0u);
+    auto const render_tiles = [&]() {
+        auto thread_ray_count = uint64_t{ 0u };
+        for (auto i = next_tile_index++; i < tile_count; i = next_tile_index++) {
+            auto const tile_min = glm::uvec2(static_cast<uint32_t>(i % tile_counts.x), static_cast<uint32_t>(i / tile_counts.x)) * TILE_SIDE;
+            auto const tile_max = glm::min(tile_min + TILE_SIDE, settings.resolution);
+            thread_ray_count += render_tile(contiguous_tree64, settings, tile_min, tile_max, image.colors);
+        }
+        ray_count += thread_ray_count;
+    };
+    auto const thread_count = static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 1u));
+    auto workers = std::vector<std::future<void>>();
+    for (auto i = size_t{ 1u }; i < std::min(thread_count, tile_count); ++i) {
+        workers.emplace_back(std::async(std::launch::async, render_tiles));
+    }
+    render_tiles();
+    for (auto& worker : workers) {
+        worker.get();
+    }
+    image.ray_count = ray_count;
+    return image;
+}
+
+bool save_ppm(std::filesystem::path const& path, Tree64Image const& image) {
+    auto bf = BinaryFstream(path, std::ios::trunc);
+    if (bf.fail()) {
+        return false;
+    }
+    auto const header = "P6\n" + std::to_string(image.resolution.x) + " " + std::to_string(image.resolution.y) + "\n255\n";
+    auto pixels = std::vector<uint8_t>();
+    pixels.reserve(std::size(header) + std::size(image.colors) * 3u);
+    pixels.insert(std::end(pixels), std::begin(header), std::end(header));
+    for (auto const& color : image.colors) {
+        pixels.emplace_back(srgb_from_linear(color.x));
+        pixels.emplace_back(srgb_from_linear(color.y));
+        pixels.emplace_back(srgb_from_linear(color.z));
+    }
+    bf.write(reinterpret_cast<char const*>(std::data(pixels)), static_cast<std::streamsize>(std::size(pixels)));
+    return !bf.fail();
+}
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Tree64.hpp"
+#include "hosek_wilkie_sky.hpp"
+#include "tree64_raycast.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace vp {
+
+struct Tree64RenderSettings {
+    glm::uvec2 resolution;
+    glm::vec3 camera_position;
+    glm::mat3 camera_rotation;
+    glm::vec3 to_sun_direction;
+    HosekWilkieSkyRenderingParameters sky;
+    Tree64RaycastKernel kernel = fastest_raycast_kernel();
+};
+
+struct Tree64Image {
+    glm::uvec2 resolution;
+    std::vector<glm::vec3> colors; // linear, row by row from the top left
+    uint64_t ray_count = 0u; // primary and shadow rays
+};
+
+// Renders the image of the raytracing fragment shader on all the cores, with the same half-Lambertian diffuse, sun
+// shadows and sky, but without the beam optimization. The tiles of the image are taken from a shared counter by the
+// threads, the rays of a tile are coherent and traced in packets.
+[[nodiscard]] Tree64Image render(ContiguousTree64 const& contiguous_tree64, Tree64RenderSettings const& settings);
+
+// Binary PPM, the colors are clamped and encoded to sRGB like the swapchain does
+[[nodiscard]] bool save_ppm(std::filesystem::path const& path, Tree64Image const& image);
+
+}
@@ -0,0 +1,526 @@
+#include "triangle_voxelizer.hpp"
+#include "triangle_voxelizer_kernel.hpp"
+#include "tree64_raycast.hpp"
+#include "MortonTree64Builder.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace vp {
+
+static bool cell_overlaps(TriangleCellTest const& test, float const u, float const v, float const w) {
+    auto const edge_functions_are_positive = [&](TriangleProjection const projection, float const x, float const y) {
+        for (auto edge = 0u; edge < 3u; ++edge) {
+            if (test.edge_a[projection][edge] * x + test.edge_b[projection][edge] * y + test.edge_c[projection][edge] < 0.f) {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto const plane = test.normal[0] * u + test.normal[1] * v + test.normal[2] * w;
+    return plane >= test.min_plane && plane <= test.max_plane && edge_functions_are_positive(UV_TRIANGLE_PROJECTION, u, v)
+        && edge_functions_are_positive(VW_TRIANGLE_PROJECTION, v, w) && edge_functions_are_positive(WU_TRIANGLE_PROJECTION, w, u);
+}
+
+static void triangle_chunk_lane_masks_scalar(TriangleCellTest const& test, int32_t const u, int32_t const v, int32_t const w,
+    uint32_t const layer_count, uint8_t* const lane_masks) {
+    for (auto layer = 0u; layer < layer_count; ++layer) {
+        lane_masks[layer] = 0u;
+        for (auto lane = 0u; lane < TRIANGLE_CHUNK_CELL_COUNT; ++lane) {
+            if (cell_overlaps(test, static_cast<float>(u + static_cast<int32_t>(lane)), static_cast<float>(v),
+                static_cast<float>(w + static_cast<int32_t>(layer)))) {
+                lane_masks[layer] |= static_cast<uint8_t>(1u << lane);
+            }
+        }
+    }
+}
+
+// The separating axes of Schwarz and Seidel, "Fast Parallel Surface and Solid Voxelization on GPUs" : the plane of the
+// triangle, and the edge normals of its 3 projections on the axis planes, the bounding box giving the 3 axes
+static TriangleCellTest triangle_cell_test(std::array<glm::vec3, 3u> const& vertices, glm::vec3 const& normal) {
+    auto test = TriangleCellTest{ .normal = { normal.x, normal.y, normal.z } };
+    auto const critical_point = glm::vec3(glm::greaterThan(normal, glm::vec3(0.f)));
+    auto const plane_offset = glm::dot(normal, critical_point - vertices[0]);
+    auto const opposite_plane_offset = glm::dot(normal, (1.f - critical_point) - vertices[0]);
+    test.min_plane = -glm::max(plane_offset, opposite_plane_offset);
+    test.max_plane = -glm::min(plane_offset, opposite_plane_offset);
+    for (auto projection = 0u; projection < 3u; ++projection) {
+        auto const x = static_cast<int>(projection);
+        auto const y = static_cast<int>((projection + 1u) % 3u);
+        // The projected triangle winds counterclockwise when the normal points to the remaining axis
+        auto const winding = normal[static_cast<int>((projection + 2u) % 3u)] >= 0.f ? 1.f : -1.f;
+        for (auto edge = 0u; edge < 3u; ++edge) {
+            auto const& vertex = vertices[edge];
+            auto const edge_vector = vertices[(edge + 1u) % 3u] - vertex;
+            auto const a = -edge_vector[y] * winding;
+            auto const b = edge_vector[x] * winding;
+            test.edge_a[projection][edge] = a;
+            test.edge_b[projection][edge] = b;
+            test.edge_c[projection][edge] = -(a * vertex[x] + b * vertex[y]) + glm::max(0.f, a) + glm::max(0.f, b);
+        }
+    }
+    return test;
+}
+
+// The bounding box is scanned in rows along u, by chunks of 8 cells tested on the few layers the plane crosses above them,
+// so that the cells tested grow with the area of the triangle
+void voxelize_triangle(glm::vec3 const& a, glm::vec3 const& b, glm::vec3 const& c, glm::uvec3 const& grid_size,
+    std::vector<glm::uvec3>& voxels, TriangleVoxelizerKernel const kernel) {
+    auto const normal = glm::cross(b - a, c - a);
+    if (normal == glm::vec3(0.f)) {
+        return;
+    }
+    auto const abs_normal = glm::abs(normal);
+    auto const w_axis = abs_normal.x >= abs_normal.y ? (abs_normal.x >= abs_normal.z ? 0 : 2) : (abs_normal.y >= abs_normal.z ? 1 : 2);
+    // A cyclic permutation keeps the orientation of the cross products
+    auto const axes = glm::ivec3((w_axis + 1) % 3, (w_axis + 2) % 3, w_axis);
+    auto const permuted = [&](auto const& v) {
+        return std::remove_cvref_t<decltype(v)>(v[axes.x], v[axes.y], v[axes.z]);
+    };
+    auto const last_grid_cell = glm::ivec3(grid_size) - 1;
+    auto const first_cell = glm::clamp(glm::ivec3(glm::floor(glm::min(glm::min(a, b), c))), glm::ivec3(0), last_grid_cell);
+    auto const last_cell = glm::clamp(glm::ivec3(glm::floor(glm::max(glm::max(a, b), c))), glm::ivec3(0), last_grid_cell);
+    auto const origin = glm::vec3(first_cell);
+    auto const vertices = std::array{ permuted(a - origin), permuted(b - origin), permuted(c - origin) };
+    auto const permuted_normal = permuted(normal);
+    auto const last = permuted(last_cell - first_cell);
+    auto const test = triangle_cell_test(vertices, permuted_normal);
+
+    auto const u_slope = -permuted_normal.x / permuted_normal.z;
+    auto const v_slope = -permuted_normal.y / permuted_normal.z;
+    auto lane_masks = std::array<uint8_t, TRIANGLE_CHUNK_MAX_LAYER_COUNT>();
+    for (auto v = 0; v <= last.y; ++v) {
+        // The cells of the row inside the uv projection, widened by a cell against the rounding
+        auto min_u = 0.f;
+        auto max_u = static_cast<float>(last.x);
+        for (auto edge = 0u; edge < 3u; ++edge) {
+            auto const edge_a = test.edge_a[UV_TRIANGLE_PROJECTION][edge];
+            auto const edge_rest = test.edge_b[UV_TRIANGLE_PROJECTION][edge] * static_cast<float>(v)
+                + test.edge_c[UV_TRIANGLE_PROJECTION][edge];
+            if (edge_a > 0.f) {
+                min_u = glm::max(min_u, -edge_rest / edge_a);
+            } else if (edge_a < 0.f) {
+                max_u = glm::min(max_u, -edge_rest / edge_a);
+            } else if (edge_rest < 0.f) {
+                max_u = -2.f; // no cell
+            }
+        }
+        auto const first_u = std::max(static_cast<int>(std::floor(min_u)) - 1, 0);
+        auto const last_u = std::min(static_cast<int>(std::ceil(max_u)) + 1, last.x);
+        for (auto u = first_u; u <= last_u; u += static_cast<int>(TRIANGLE_CHUNK_CELL_COUNT)) {
+            auto const cell_count = std::min(last_u - u + 1, static_cast<int>(TRIANGLE_CHUNK_CELL_COUNT));
+            // The layers where the plane crosses the chunk, widened by a cell against the rounding
+            auto const chunk_w = vertices[0].z + u_slope * (static_cast<float>(u) - vertices[0].x)
+                + v_slope * (static_cast<float>(v) - vertices[0].y);
+            auto const u_extent = u_slope * static_cast<float>(cell_count);
+            auto const min_w = chunk_w + glm::min(u_extent, 0.f) + glm::min(v_slope, 0.f);
+            auto const max_w = chunk_w + glm::max(u_extent, 0.f) + glm::max(v_slope, 0.f);
+            auto const first_w = std::max(static_cast<int>(std::floor(min_w)) - 1, 0);
+            auto const last_w = std::min({ static_cast<int>(std::floor(max_w)) + 1, last.z,
+                first_w + static_cast<int>(TRIANGLE_CHUNK_MAX_LAYER_COUNT) - 1 });
+            if (first_w > last_w) {
+                continue;
+            }
+            auto const layer_count = static_cast<uint32_t>(last_w - first_w + 1);
+#ifdef VP_X86
+            if (kernel == TriangleVoxelizerKernel::Avx2) {
+                triangle_chunk_lane_masks_avx2(test, u, v, first_w, layer_count, std::data(lane_masks));
+            } else {
+                triangle_chunk_lane_masks_scalar(test, u, v, first_w, layer_count, std::data(lane_masks));
+            }
+#else
+            static_cast<void>(kernel);
+            triangle_chunk_lane_masks_scalar(test, u, v, first_w, layer_count, std::data(lane_masks));
+#endif
+            auto const cell_mask = (1u << static_cast<uint32_t>(cell_count)) - 1u;
+            for (auto layer = 0u; layer < layer_count; ++layer) {
+                for (auto mask = lane_masks[layer] & cell_mask; mask != 0u; mask &= mask - 1u) {
+                    auto const cell = glm::ivec3(u + std::countr_zero(mask), v, first_w + static_cast<int>(layer));
+                    auto voxel = glm::uvec3(first_cell);
+                    voxel[axes.x] += static_cast<uint32_t>(cell.x);
+                    voxel[axes.y] += static_cast<uint32_t>(cell.y);
+                    voxel[axes.z] += static_cast<uint32_t>(cell.z);
+                    voxels.emplace_back(voxel);
+                }
+            }
+        }
+    }
+}
+
+// In cells, a batch keeps the workers busy for about a millisecond
+static constexpr auto BATCH_COST = 1u << 16u;
+static constexpr auto MAX_TRIANGLE_COST = BATCH_COST / 4u;
+
+// The cells scanned for a triangle, about its area and its longest edge, and a few more for its setup
+static float voxelization_cost(Triangle const& triangle) {
+    auto const& [a, b, c] = triangle;
+    auto const longest_edge = glm::max(glm::max(glm::length(b - a), glm::length(c - b)), glm::length(a - c));
+    return glm::length(glm::cross(b - a, c - a)) / 2.f + longest_edge + 16.f;
+}
+
+// The triangles too costly for a batch are split in 4 by their midpoints, the pieces overlap the same cells but for
+// rounding on the ones they only touch. The triangles with a non finite cost are dropped, they would be split forever.
+static void append_triangle(std::vector<Triangle>& triangles, Triangle const& triangle) {
+    auto const cost = voxelization_cost(triangle);
+    if (!std::isfinite(cost)) {
+        return;
+    }
+    if (cost <= static_cast<float>(MAX_TRIANGLE_COST)) {
+        triangles.emplace_back(triangle);
+        return;
+    }
+    auto const& [a, b, c] = triangle;
+    auto const ab = (a + b) / 2.f;
+    auto const bc = (b + c) / 2.f;
+    auto const ca = (c + a) / 2.f;
+    append_triangle(triangles, Triangle{ a, ab, ca });
+    append_triangle(triangles, Triangle{ ab, b, bc });
+    append_triangle(triangles, Triangle{ ca, bc, c });
+    append_triangle(triangles, Triangle{ ab, bc, ca });
+}
+
+// The triangles are sorted by the morton code of the region of their centroid, the grid being cut in 16^3 regions, and
+// cut in batches of about the same cost. The workers voxelize the batches into their own buffers, a few batches ahead of
+// the importer at most.
+void voxelize_triangles(std::span<Triangle const> const triangles, glm::uvec3 const& grid_size,
+    std::function<void(std::span<glm::uvec3 const>)> const& voxels_importer) {
+    constexpr auto REGION_DEPTH = uint8_t{ 2u };
+    auto split_triangles = std::vector<Triangle>();
+    split_triangles.reserve(std::size(triangles));
+    for (auto const& triangle : triangles) {
+        append_triangle(split_triangles, triangle);
+    }
+    auto const region_shift = std::max(static_cast<int>(std::bit_width(glm::max(glm::max(grid_size.x, grid_size.y), grid_size.z) - 1u))
+        - REGION_DEPTH * 2, 0);
+    auto const region_of = [&](Triangle const& triangle) {
+        auto const centroid = glm::clamp((triangle[0] + triangle[1] + triangle[2]) / 3.f, glm::vec3(0.f), glm::vec3(grid_size - 1u));
+        return MortonTree64Builder::morton_code(glm::uvec3(centroid) >> static_cast<uint32_t>(region_shift), REGION_DEPTH);
+    };
+    auto region_offsets = std::vector<size_t>((size_t{ 1u } << (REGION_DEPTH * 6u)) + 1u);
+    for (auto const& triangle : split_triangles) {
+        region_offsets[region_of(triangle) + 1u] += 1u;
+    }
+    std::inclusive_scan(std::begin(region_offsets), std::end(region_offsets), std::begin(region_offsets));
+    auto sorted_triangles = std::vector<Triangle>(std::size(split_triangles));
+    for (auto const& triangle : split_triangles) {
+        sorted_triangles[region_offsets[region_of(triangle)]++] = triangle;
+    }
+    split_triangles = std::vector<Triangle>();
+
+    auto batch_offsets = std::vector<size_t>{ 0u };
+    auto batch_cost = 0.f;
+    for (auto i = size_t{ 0u }; i < std::size(sorted_triangles); ++i) {
+        batch_cost += voxelization_cost(sorted_triangles[i]);
+        if (batch_cost >= static_cast<float>(BATCH_COST) || i + 1u == std::size(sorted_triangles)) {
+            batch_offsets.emplace_back(i + 1u);
+            batch_cost = 0.f;
+        }
+    }
+    auto const batch_count = std::size(batch_offsets) - 1u;
+
+    auto const thread_count = static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 1u));
+    auto const max_pending_batch_count = 4u * thread_count;
+    auto mutex = std::mutex();
+    auto batch_condition = std::condition_variable();
+    auto batches_voxels = std::vector<std::vector<glm::uvec3>>(batch_count);
+    auto are_batches_voxelized = std::vector<bool>(batch_count);
+    auto next_batch_index = size_t{ 0u };
+    auto imported_batch_count = size_t{ 0u };
+    auto is_cancelled = false;
+    auto const voxelize_batches = [&]() {
+        auto lock = std::unique_lock(mutex);
+        while (true) {
+            batch_condition.wait(lock, [&]() {
+                return is_cancelled || next_batch_index == batch_count || next_batch_index < imported_batch_count + max_pending_batch_count;
+            });
+            if (is_cancelled || next_batch_index == batch_count) {
+                return;
+            }
+            auto const batch_index = next_batch_index++;
+            lock.unlock();
+            auto voxels = std::vector<glm::uvec3>();
+            try {
+                for (auto i = batch_offsets[batch_index]; i < batch_offsets[batch_index + 1u]; ++i) {
+                    auto const& [a, b, c] = sorted_triangles[i];
+                    voxelize_triangle(a, b, c, grid_size, voxels);
+                }
+            } catch (...) {
+                // The importer would wait for this batch forever, the exception is rethrown by the future
+                lock.lock();
+                is_cancelled = true;
+                batch_condition.notify_all();
+                throw;
+            }
+            lock.lock();
+            batches_voxels[batch_index] = std::move(voxels);
+            are_batches_voxelized[batch_index] = true;
+            batch_condition.notify_all();
+        }
+    };
+    auto workers = std::vector<std::future<void>>();
+    for (auto i = size_t{ 0u }; i < std::min(thread_count, batch_count); ++i) {
+        workers.emplace_back(std::async(std::launch::async, voxelize_batches));
+    }
+    try {
+        for (auto batch_index = size_t{ 0u }; batch_index < batch_count; ++batch_index) {
+            auto lock = std::unique_lock(mutex);
+            batch_condition.wait(lock, [&]() { return is_cancelled || are_batches_voxelized[batch_index]; });
+            if (is_cancelled) {
+                break;
+            }
+            auto const voxels = std::move(batches_voxels[batch_index]);
+            imported_batch_count = batch_index + 1u;
+            batch_condition.notify_all();
+            lock.unlock();
+            voxels_importer(voxels);
+        }
+    } catch (...) {
+        // The workers waiting for the importer would never return
+        {
+            auto const lock = std::lock_guard(mutex);
+            is_cancelled = true;
+        }
+        batch_condition.notify_all();
+        throw;
+    }
+    for (auto& worker : workers) {
+        worker.get();
+    }
+}
+
+// The triangles are split as in voxelize_triangles, the pieces of a large triangle not covering the same voxels as it
+void voxelize_triangles_on_calling_thread(std::span<Triangle const> const triangles, glm::uvec3 const& grid_size,
+    std::vector<glm::uvec3>& voxels) {
+    auto split_triangles = std::vector<Triangle>();
+    for (auto const& triangle : triangles) {
+        split_triangles.clear();
+        append_triangle(split_triangles, triangle);
+        for (auto const& [a, b, c] : split_triangles) {
+            voxelize_triangle(a, b, c, grid_size, voxels);
+        }
+    }
+}
+
+// Twice the signed area of (p, q, r), the edge endpoints being taken in a canonical order so that the two triangles of
+// an edge get exactly opposite values
+static double edge_function(glm::dvec2 p, glm::dvec2 q, glm::dvec2 const& r) {
+    auto const swaps = q.x < p.x || (q.x == p.x && q.y < p.y);
+    if (swaps) {
+        std::swap(p, q);
+    }
+    auto const value = (q.x - p.x) * (r.y - p.y) - (q.y - p.y) * (r.x - p.x);
+    return swaps ? -value : value;
+}
+
+// A column center on an edge belongs to one of its two triangles, the one for which it would be inside once moved by
+// (-e, e^2) with e infinitely small
+static bool owns_column(glm::dvec2 const& p, glm::dvec2 const& q, glm::dvec2 const& column) {
+    auto const value = edge_function(p, q, column);
+    return value > 0. || (value == 0. && (q.y > p.y || (q.y == p.y && q.x > p.x)));
+}
+
+// The solid voxelization of Schwarz and Seidel : each triangle flips the voxels above it in the columns along y whose
+// center it covers. The flips are gathered per 4x4x4 brick, in the layout of the leaf masks, and each stack of bricks
+// is turned into its solid masks by a prefix xor along y on the 16 columns of a brick at once.
+void voxelize_triangles_interior(std::span<Triangle const> const triangles, glm::uvec3 const& grid_size,
+    std::function<void(std::span<VoxelBrickRun const>)> const& brick_runs_importer) {
+    constexpr auto BRICK_RUN_BATCH_SIZE = size_t{ 4096u };
+    constexpr auto BRICK_BIT_COUNT = 19u; // 2^20 voxels per side and the virtual layer above them
+    constexpr auto LAYER_BROADCAST = 0x0001'0001'0001'0001_u64;
+    auto const brick_count = (grid_size + 3u) / 4u;
+
+    // The flips sorted by brick stack, then by brick along y, then by bit
+    auto flips = std::vector<uint64_t>();
+    for (auto const& triangle : triangles) {
+        auto const a = glm::dvec2(triangle[0].x, triangle[0].z);
+        auto b = glm::dvec2(triangle[1].x, triangle[1].z);
+        auto c = glm::dvec2(triangle[2].x, triangle[2].z);
+        auto const area = edge_function(a, b, c);
+        // As in voxelize_triangles, the triangles with a non finite vertex are dropped
+        if (area == 0. || !std::isfinite(area) || !std::isfinite(double{ triangle[0].y } + triangle[1].y + triangle[2].y)) {
+            continue;
+        }
+        if (area < 0.) {
+            std::swap(b, c);
+        }
+        auto const origin = glm::dvec3(triangle[0]);
+        auto const normal = glm::cross(glm::dvec3(triangle[1]) - origin, glm::dvec3(triangle[2]) - origin);
+        auto const min = glm::max(glm::ceil(glm::min(glm::min(a, b), c) - 0.5), glm::dvec2(0.));
+        auto const max = glm::min(glm::floor(glm::max(glm::max(a, b), c) - 0.5), glm::dvec2(grid_size.x, grid_size.z) - 1.);
+        for (auto z = min.y; z <= max.y; z += 1.) {
+            for (auto x = min.x; x <= max.x; x += 1.) {
+                auto const column = glm::dvec2(x + 0.5, z + 0.5);
+                if (!owns_column(a, b, column) || !owns_column(b, c, column) || !owns_column(c, a, column)) {
+                    continue;
+                }
+                auto const y = origin.y - (normal.x * (column.x - origin.x) + normal.z * (column.y - origin.z)) / normal.y;
+                // The first voxel whose center is above the triangle. The triangles on or above the top of the grid flip
+                // the virtual layer above it, which closes their columns without filling any voxel.
+                auto const first_y = std::clamp(std::floor(y - 0.5) + 1., 0., static_cast<double>(grid_size.y));
+                auto const voxel = glm::uvec3(static_cast<uint32_t>(x), static_cast<uint32_t>(first_y), static_cast<uint32_t>(z));
+                auto const stack = uint64_t{ voxel.z / 4u } * brick_count.x + voxel.x / 4u;
+                auto const bit = (voxel.x % 4u) + (voxel.z % 4u) * 4u + (voxel.y % 4u) * 16u;
+                flips.emplace_back((((stack << BRICK_BIT_COUNT) | (voxel.y / 4u)) << 6u) | bit);
+            }
+        }
+    }
+    std::ranges::sort(flips);
+
+    auto brick_runs = std::vector<VoxelBrickRun>();
+    brick_runs.reserve(BRICK_RUN_BATCH_SIZE);
+    auto const add_brick_run = [&](VoxelBrickRun const& brick_run) {
+        brick_runs.emplace_back(brick_run);
+        if (std::size(brick_runs) == BRICK_RUN_BATCH_SIZE) {
+            brick_runs_importer(brick_runs);
+            brick_runs.clear();
+        }
+    };
+    // The voxels of the top brick of the grid under its top, the ones above are in the virtual layer or past it
+    auto const top_brick_y = (grid_size.y - 1u) / 4u;
+    auto const top_brick_mask = ~0_u64 >> (16u * (top_brick_y * 4u + 4u - grid_size.y));
+    auto brick_masks = std::vector<uint64_t>();
+    for (auto begin = size_t{ 0u }; begin < std::size(flips);) {
+        auto const stack = flips[begin] >> (BRICK_BIT_COUNT + 6u);
+        auto end = begin;
+        while (end < std::size(flips) && flips[end] >> (BRICK_BIT_COUNT + 6u) == stack) {
+            end += 1u;
+        }
+        auto const brick_y_of = [&](uint64_t const flip) {
+            return (flip >> 6u) & ((1_u64 << BRICK_BIT_COUNT) - 1u);
+        };
+        auto const first_brick_y = brick_y_of(flips[begin]);
+        brick_masks.assign(brick_y_of(flips[end - 1u]) - first_brick_y + 1u, 0_u64);
+        for (auto i = begin; i < end; ++i) {
+            brick_masks[brick_y_of(flips[i]) - first_brick_y] ^= 1_u64 << (flips[i] & 63u);
+        }
+        begin = end;
+        auto carry = 0_u64;
+        for (auto& brick_mask : brick_masks) {
+            brick_mask ^= brick_mask << 16u;
+            brick_mask ^= brick_mask << 32u;
+            brick_mask ^= carry;
+            carry = (brick_mask >> 48u) * LAYER_BROADCAST;
+        }
+        // The columns still inside at the top are not closed, they would be filled up to the grid end, keep them empty
+        auto const closed_columns_mask = ~carry;
+        auto const brick_x = static_cast<uint32_t>(stack % brick_count.x);
+        auto const brick_z = static_cast<uint32_t>(stack / brick_count.x);
+        auto brick_run = VoxelBrickRun{ .brick_count = 0u };
+        for (auto i = size_t{ 0u }; i < std::size(brick_masks); ++i) {
+            auto const brick_y = static_cast<uint32_t>(first_brick_y + i);
+            if (brick_y > top_brick_y) {
+                break;
+            }
+            auto const mask = brick_masks[i] & closed_columns_mask & (brick_y == top_brick_y ? top_brick_mask : ~0_u64);
+            if (brick_run.brick_count > 0u && mask == brick_run.mask) {
+                brick_run.brick_count += 1u;
+                continue;
+            }
+            if (brick_run.brick_count > 0u) {
+                add_brick_run(brick_run);
+            }
+            brick_run = VoxelBrickRun{ .first_brick = glm::uvec3(brick_x, brick_y, brick_z), .brick_count = mask != 0_u64 ? 1u : 0u,
+                .mask = mask };
+        }
+        if (brick_run.brick_count > 0u) {
+            add_brick_run(brick_run);
+        }
+    }
+    brick_runs_importer(brick_runs);
+}
+
+// The voxels of a brick whose coordinate along the axis is under count, count being at most 4
+static uint64_t brick_layers_mask(glm::length_t const axis, uint32_t const count) {
+    switch (axis) {
+    case 0:
+        return ((1_u64 << count) - 1u) * 0x1111'1111'1111'1111_u64;
+    case 2:
+        return ((1_u64 << (count * 4u)) - 1u) * 0x0001'0001'0001'0001_u64;
+    default:
+        return count == 4u ? ~0_u64 : (1_u64 << (count * 16u)) - 1u;
+    }
+}
+
+// The voxels of the brick mask moved by shift, below 4 voxels, that land in the next brick along the axes where side is 1
+// and in the same brick along the others
+static uint64_t shifted_brick_mask(uint64_t mask, glm::uvec3 const& shift, glm::uvec3 const& side) {
+    constexpr auto AXIS_BIT_STRIDES = std::array{ 1u, 16u, 4u };
+    for (auto axis = 0; axis < 3; ++axis) {
+        auto const stride = AXIS_BIT_STRIDES[static_cast<size_t>(axis)];
+        if (side[axis] == 0u) {
+            mask = (mask & brick_layers_mask(axis, 4u - shift[axis])) << (stride * shift[axis]);
+        } else {
+            mask = shift[axis] == 0u ? 0u : (mask >> (stride * (4u - shift[axis]))) & brick_layers_mask(axis, shift[axis]);
+        }
+    }
+    return mask;
+}
+
+void append_translated_brick_runs(VoxelBrickRun const& brick_run, glm::ivec3 const& offset, glm::uvec3 const& grid_size,
+    std::vector<VoxelBrickRun>& translated_brick_runs) {
+    auto const brick_grid_size = glm::ivec3((grid_size + 3u) / 4u);
+    auto const last_brick_voxel_counts = grid_size - (grid_size - 1u) / 4u * 4u;
+    auto const add_brick_run = [&](glm::ivec3 const& first_brick, int const brick_count, uint64_t const mask) {
+        if (brick_count > 0 && mask != 0u) {
+            translated_brick_runs.emplace_back(VoxelBrickRun{ .first_brick = glm::uvec3(first_brick),
+                .brick_count = static_cast<uint32_t>(brick_count), .mask = mask });
+        }
+    };
+    // Clipped to the grid, the bricks on its far sides keeping their voxels in it
+    auto const add_clipped_brick_run = [&](glm::ivec3 const& first_brick, int const brick_count, uint64_t mask) {
+        if (first_brick.x < 0 || first_brick.z < 0 || first_brick.x >= brick_grid_size.x || first_brick.z >= brick_grid_size.z) {
+            return;
+        }
+        for (auto const axis : { 0, 2 }) {
+            if (first_brick[axis] + 1 == brick_grid_size[axis]) {
+                mask &= brick_layers_mask(axis, last_brick_voxel_counts[axis]);
+            }
+        }
+        auto const first_y = std::max(first_brick.y, 0);
+        auto const end_y = std::min(first_brick.y + brick_count, brick_grid_size.y);
+        if (end_y < brick_grid_size.y || last_brick_voxel_counts.y == 4u) {
+            add_brick_run(glm::ivec3(first_brick.x, first_y, first_brick.z), end_y - first_y, mask);
+            return;
+        }
+        add_brick_run(glm::ivec3(first_brick.x, first_y, first_brick.z), end_y - 1 - first_y, mask);
+        if (end_y - 1 >= first_y) {
+            add_brick_run(glm::ivec3(first_brick.x, end_y - 1, first_brick.z), 1, mask & brick_layers_mask(1, last_brick_voxel_counts.y));
+        }
+    };
+    auto const shift = glm::uvec3(offset & 3);
+    auto const first_brick = glm::ivec3(brick_run.first_brick) + (offset - glm::ivec3(shift)) / 4;
+    auto const brick_count = static_cast<int>(brick_run.brick_count);
+    for (auto side_z = 0u; side_z <= (shift.z == 0u ? 0u : 1u); ++side_z) {
+        for (auto side_x = 0u; side_x <= (shift.x == 0u ? 0u : 1u); ++side_x) {
+            auto const column_first_brick = first_brick + glm::ivec3(side_x, 0u, side_z);
+            auto const lower_mask = shifted_brick_mask(brick_run.mask, shift, glm::uvec3(side_x, 0u, side_z));
+            auto const upper_mask = shifted_brick_mask(brick_run.mask, shift, glm::uvec3(side_x, 1u, side_z));
+            if (upper_mask == 0u) {
+                add_clipped_brick_run(column_first_brick, brick_count, lower_mask);
+                continue;
+            }
+            // Each brick but the first also gets the upper voxels of the brick under it
+            add_clipped_brick_run(column_first_brick, 1, lower_mask);
+            add_clipped_brick_run(column_first_brick + glm::ivec3(0, 1, 0), brick_count - 1, lower_mask | upper_mask);
+            add_clipped_brick_run(column_first_brick + glm::ivec3(0, brick_count, 0), 1, upper_mask);
+        }
+    }
+}
+
+TriangleVoxelizerKernel fastest_triangle_voxelizer_kernel() {
+    // The CPU support of AVX2 is the one detected for the ray packet kernels
+    return fastest_raycast_kernel() == Tree64RaycastKernel::Avx2 ? TriangleVoxelizerKernel::Avx2 : TriangleVoxelizerKernel::Scalar;
+}
+
+}
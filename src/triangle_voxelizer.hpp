@@ -0,0 +1,56 @@
+#pragma once
+
+#include "voxelizer.hpp"
+
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_int3.hpp>
+#include <glm/ext/vector_uint3.hpp>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace vp {
+
+using Triangle = std::array<glm::vec3, 3u>;
+
+enum class TriangleVoxelizerKernel : uint8_t {
+    Scalar,
+    Avx2, // 8 cells at once
+};
+
+[[nodiscard]] TriangleVoxelizerKernel fastest_triangle_voxelizer_kernel();
+
+// Appends the voxels of the grid overlapped by the triangle, the voxel v covering [v, v + 1]. The voxels on a shared edge
+// are added by both triangles, so that the closed meshes give watertight surfaces. The triangles without area add none,
+// their edges are the ones of their neighbors. The voxels do not depend on the kernel.
+void voxelize_triangle(glm::vec3 const& a, glm::vec3 const& b, glm::vec3 const& c, glm::uvec3 const& grid_size,
+    std::vector<glm::uvec3>& voxels, TriangleVoxelizerKernel kernel = fastest_triangle_voxelizer_kernel());
+
+// Voxelizes the triangles on all the cores, by batches of neighbouring triangles. voxels_importer is called on the
+// calling thread with the voxels of each batch, the batches and their order do not depend on the core count. The
+// triangles with a non finite vertex or too large to be voxelized add no voxels.
+void voxelize_triangles(std::span<Triangle const> triangles, glm::uvec3 const& grid_size,
+    std::function<void(std::span<glm::uvec3 const>)> const& voxels_importer);
+
+// Appends the voxels voxelize_triangles imports, in another order, voxelizing on the calling thread for the callers
+// which spread their own work on the cores
+void voxelize_triangles_on_calling_thread(std::span<Triangle const> triangles, glm::uvec3 const& grid_size,
+    std::vector<glm::uvec3>& voxels);
+
+// Imports the voxels whose center is inside the surface of the triangles, by the parity of the triangles below it along
+// y. The columns crossed an odd number of times are not closed and stay empty, the triangles on or above the top of the
+// grid counting, and the interiors of overlapping closed surfaces cancel out. The surface voxels are not all imported,
+// voxelize_triangles gives them. The consecutive bricks of a stack with the same voxels are imported as a single run.
+void voxelize_triangles_interior(std::span<Triangle const> triangles, glm::uvec3 const& grid_size,
+    std::function<void(std::span<VoxelBrickRun const>)> const& brick_runs_importer);
+
+// Appends the voxels of the brick run moved by offset, clipped to the grid, as brick runs. The offset is not aligned on
+// the bricks, each brick is split in the up to 8 bricks it moves into, and the run stays a run in each column it moves
+// into but for its first and last bricks.
+void append_translated_brick_runs(VoxelBrickRun const& brick_run, glm::ivec3 const& offset, glm::uvec3 const& grid_size,
+    std::vector<VoxelBrickRun>& translated_brick_runs);
+
+}
@@ -0,0 +1,59 @@
+#include "triangle_voxelizer_kernel.hpp"
+
+#ifdef VP_X86
+
+#include <immintrin.h>
+
+namespace vp {
+
+void triangle_chunk_lane_masks_avx2(TriangleCellTest const& test, int32_t const u, int32_t const v, int32_t const w,
+    uint32_t const layer_count, uint8_t* const lane_masks) {
+    auto const us = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(u)), _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f));
+    auto const fv = static_cast<float>(v);
+    auto const zero = _mm256_setzero_ps();
+
+    // The uv projection is the same for all the layers, and the vw one for all the lanes
+    auto uv_mask = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (auto edge = 0u; edge < 3u; ++edge) {
+        auto const edge_function = _mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(_mm256_set1_ps(test.edge_a[UV_TRIANGLE_PROJECTION][edge]), us),
+            _mm256_set1_ps(test.edge_b[UV_TRIANGLE_PROJECTION][edge] * fv)), _mm256_set1_ps(test.edge_c[UV_TRIANGLE_PROJECTION][edge]));
+        uv_mask = _mm256_and_ps(uv_mask, _mm256_cmp_ps(edge_function, zero, _CMP_GE_OQ));
+    }
+    if (_mm256_movemask_ps(uv_mask) == 0) {
+        for (auto layer = 0u; layer < layer_count; ++layer) {
+            lane_masks[layer] = 0u;
+        }
+        return;
+    }
+    auto const uv_plane = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(test.normal[0]), us), _mm256_set1_ps(test.normal[1] * fv));
+    auto const min_plane = _mm256_set1_ps(test.min_plane);
+    auto const max_plane = _mm256_set1_ps(test.max_plane);
+    for (auto layer = 0u; layer < layer_count; ++layer) {
+        auto const fw = static_cast<float>(w + static_cast<int32_t>(layer));
+        auto overlaps_vw = true;
+        for (auto edge = 0u; edge < 3u; ++edge) {
+            overlaps_vw = overlaps_vw && test.edge_a[VW_TRIANGLE_PROJECTION][edge] * fv
+                + test.edge_b[VW_TRIANGLE_PROJECTION][edge] * fw + test.edge_c[VW_TRIANGLE_PROJECTION][edge] >= 0.f;
+        }
+        if (!overlaps_vw) {
+            lane_masks[layer] = 0u;
+            continue;
+        }
+        auto const plane = _mm256_add_ps(uv_plane, _mm256_set1_ps(test.normal[2] * fw));
+        auto mask = _mm256_and_ps(uv_mask, _mm256_and_ps(_mm256_cmp_ps(plane, min_plane, _CMP_GE_OQ),
+            _mm256_cmp_ps(plane, max_plane, _CMP_LE_OQ)));
+        for (auto edge = 0u; edge < 3u; ++edge) {
+            auto const edge_function = _mm256_add_ps(_mm256_add_ps(
+                _mm256_set1_ps(test.edge_a[WU_TRIANGLE_PROJECTION][edge] * fw),
+                _mm256_mul_ps(_mm256_set1_ps(test.edge_b[WU_TRIANGLE_PROJECTION][edge]), us)),
+                _mm256_set1_ps(test.edge_c[WU_TRIANGLE_PROJECTION][edge]));
+            mask = _mm256_and_ps(mask, _mm256_cmp_ps(edge_function, zero, _CMP_GE_OQ));
+        }
+        lane_masks[layer] = static_cast<uint8_t>(_mm256_movemask_ps(mask));
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VP_X86
+#endif
+
+// As the ray packet kernels, the AVX2 kernel lives in its own translation unit compiled for AVX2 and only called when the
+// CPU supports it, with only intrinsics and the plain data below.
+
+namespace vp {
+
+static constexpr auto TRIANGLE_CHUNK_CELL_COUNT = 8u;
+static constexpr auto TRIANGLE_CHUNK_MAX_LAYER_COUNT = 16u;
+
+enum TriangleProjection : uint32_t {
+    UV_TRIANGLE_PROJECTION,
+    VW_TRIANGLE_PROJECTION,
+    WU_TRIANGLE_PROJECTION,
+};
+
+// The separating axis test of a triangle against the unit cells, in coordinates permuted so that w is the dominant axis
+// of its normal, relative to the first cell of its bounding box. The cell p overlaps the triangle when
+// min_plane <= normal . p <= max_plane, and when the 3 edge functions of each projection are positive at p.
+// The projections take the coordinates in the order of their name, the edge function of x, y is a x + b y + c.
+struct TriangleCellTest {
+    float normal[3];
+    float min_plane;
+    float max_plane;
+    float edge_a[3][3]; // [projection][edge]
+    float edge_b[3][3];
+    float edge_c[3][3];
+};
+
+// Bit i of lane_masks[layer] is set when the cell (u + i, v, w + layer) overlaps the triangle, they are evaluated as
+// (normal[0] u + normal[1] v) + normal[2] w and (a x + b y) + c to be the same with every kernel. Only defined with VP_X86.
+void triangle_chunk_lane_masks_avx2(TriangleCellTest const& test, int32_t u, int32_t v, int32_t w, uint32_t layer_count,
+    uint8_t* lane_masks);
+
+}
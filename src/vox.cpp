@@ -83,7 +83,7 @@ struct Node {
 
 bool import_vox(std::filesystem::path const& path,
     std::function<bool(glm::uvec3 const&)> const& vox_full_size_importer,
-    std::function<void(glm::uvec3 const&)> const& voxel_importer) {
+    std::function<void(std::span<glm::uvec3 const>)> const& voxels_importer) {
     auto bf = BinaryFstream(path);
     if (bf.fail()) {
         return false;
@@ -214,6 +214,9 @@ bool import_vox(std::filesystem::path const& path,
         model_transform[3][2] -= (model_transform[0][2] + model_transform[1][2] + model_transform[2][2] - 1) / -2;
     }
 
+    constexpr auto VOXEL_BATCH_SIZE = size_t{ 4096u };
+    auto voxels = std::vector<glm::uvec3>();
+    voxels.reserve(VOXEL_BATCH_SIZE);
     auto model_id = int32_t{ 0 };
     for_each_chunks([&](std::string_view const chunk_id) {
         if (chunk_id != "XYZI") {
@@ -236,11 +239,16 @@ bool import_vox(std::filesystem::path const& path,
                     model_transform[0][1] * x + model_transform[1][1] * z + model_transform[2][1] * y,
                     model_transform[0][2] * x + model_transform[1][2] * z + model_transform[2][2] * y
                 );
-                voxel_importer(glm::uvec3(voxel));
+                voxels.emplace_back(voxel);
+                if (std::size(voxels) == VOXEL_BATCH_SIZE) {
+                    voxels_importer(voxels);
+                    voxels.clear();
+                }
             }
         }
         model_id += 1u;
         return true;
     });
+    voxels_importer(voxels);
     return true;
 }
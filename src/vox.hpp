@@ -4,7 +4,8 @@
 
 #include <filesystem>
 #include <functional>
+#include <span>
 
 [[nodiscard]] bool import_vox(std::filesystem::path const& path,
     std::function<bool(glm::uvec3 const&)> const& vox_full_size_importer,
-    std::function<void(glm::uvec3 const&)> const& voxel_importer);
+    std::function<void(std::span<glm::uvec3 const>)> const& voxels_importer);
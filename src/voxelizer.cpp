@@ -1,81 +1,62 @@
 #include "voxelizer.hpp"
-#include "math.hpp"
 #include "filesystem.hpp"
+#include "triangle_voxelizer.hpp"
 
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/config.h>
 #include <assimp/scene.h>
-#include <glm/common.hpp>
-#include <glm/geometric.hpp>
+#include <glm/glm.hpp>
 #include <glm/gtx/component_wise.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <future>
 #include <iostream>
+#include <map>
 #include <span>
+#include <thread>
+#include <utility>
+#include <vector>
 
+// The fractional part of the instance translations is rounded to a quarter voxel, so that the instances placed at
+// arbitrary positions still share a few voxelizations, at the cost of moving them by at most an eighth of a voxel
+static constexpr auto INSTANCE_TRANSLATION_STEP_COUNT = 4.f;
+static constexpr auto STAMPED_VOXEL_BATCH_SIZE = size_t{ 4096u };
+static constexpr auto STAMPED_BRICK_RUN_BATCH_SIZE = size_t{ 4096u };
 
-static void dda(glm::vec3 const& a, glm::vec3 const& b, std::invocable<glm::ivec3 const&> auto const& fn) {
-    auto direction = glm::normalize(b - a);
-    constexpr auto EPSILON = std::numeric_limits<float>::min();
-    // Avoid division by zero
-    direction.x = std::copysign(glm::max(glm::abs(direction.x), EPSILON), direction.x);
-    direction.y = std::copysign(glm::max(glm::abs(direction.y), EPSILON), direction.y);
-    direction.z = std::copysign(glm::max(glm::abs(direction.z), EPSILON), direction.z);
-    auto const coords_steps = glm::ivec3(glm::sign(direction));
-    auto coords = glm::ivec3(a);
-
-    auto const fract = glm::fract(a);
-    auto const straight_distances = glm::mix(fract, 1.f - fract, glm::vec3(coords_steps + 1) / 2.f);
-    auto distances = glm::vec3(
-        glm::length((straight_distances.x / direction.x) * direction),
-        glm::length((straight_distances.y / direction.y) * direction),
-        glm::length((straight_distances.z / direction.z) * direction)
-    );
-    auto distances_steps = glm::vec3(
-        glm::length((1.f / direction.x) * direction),
-        glm::length((1.f / direction.y) * direction),
-        glm::length((1.f / direction.z) * direction)
-    );
-
-    fn(coords);
-    auto const last_coords = glm::ivec3(b);
-    while (coords != last_coords) {
-        if (distances.x < distances.y) {
-            if (distances.z < distances.x) {
-                coords.z += coords_steps.z;
-                distances.z += distances_steps.z;
-            } else {
-                coords.x += coords_steps.x;
-                distances.x += distances_steps.x;
-            }
-        } else {
-            if (distances.z < distances.y) {
-                coords.z += coords_steps.z;
-                distances.z += distances_steps.z;
-            } else {
-                coords.y += coords_steps.y;
-                distances.y += distances_steps.y;
-            }
-        }
-        fn(coords);
-    }
-};
+static constexpr glm::vec3 vec3_from(aiVector3D const& vec3) {
+    return glm::vec3(vec3.x, vec3.y, vec3.z);
+}
 
-bool voxelize_model(std::filesystem::path const& path, uint32_t const side_voxel_count,
-    std::function<void(glm::uvec3 const&)> const& voxel_importer) {
-    auto importer = Assimp::Importer();
-    importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_NORMALS | aiComponent_TANGENTS_AND_BITANGENTS
-        | aiComponent_COLORS | aiComponent_TEXCOORDS | aiComponent_BONEWEIGHTS | aiComponent_ANIMATIONS
-        | aiComponent_TEXTURES | aiComponent_LIGHTS | aiComponent_CAMERAS | aiComponent_MATERIALS);
-    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
-    auto const* const scene = importer.ReadFile(string_from(path).c_str(), aiProcess_JoinIdenticalVertices
-        | aiProcess_MakeLeftHanded | aiProcess_Triangulate | aiProcess_RemoveComponent | aiProcess_PreTransformVertices
-        | aiProcess_SortByPType | aiProcess_DropNormals | static_cast<unsigned int>(aiProcess_GenBoundingBoxes));
-    if (scene == nullptr) {
-        std::cerr << "Model loading error : " << importer.GetErrorString() << std::endl;
-        return false;
+static glm::mat4 mat4_from(aiMatrix4x4 const& matrix) {
+    return glm::transpose(glm::mat4(matrix.a1, matrix.a2, matrix.a3, matrix.a4, matrix.b1, matrix.b2, matrix.b3, matrix.b4,
+        matrix.c1, matrix.c2, matrix.c3, matrix.c4, matrix.d1, matrix.d2, matrix.d3, matrix.d4));
+}
+
+// The vertices are transformed, then min is subtracted before scaling them, which keeps the precision of the models far
+// from the origin, and offset is added in grid space
+static void append_mesh_triangles(aiMesh const& mesh, glm::mat4 const& transform, glm::vec3 const& min, float const scale,
+    glm::vec3 const& offset, std::vector<vp::Triangle>& triangles) {
+    auto const grid_position_of = [&](unsigned int const vertex_index) {
+        return scale * (glm::vec3(transform * glm::vec4(vec3_from(mesh.mVertices[vertex_index]), 1.f)) - min) + offset;
+    };
+    for (auto const& ai_face : std::span(mesh.mFaces, mesh.mNumFaces)) {
+        triangles.emplace_back(vp::Triangle{
+            grid_position_of(ai_face.mIndices[0]),
+            grid_position_of(ai_face.mIndices[1]),
+            grid_position_of(ai_face.mIndices[2]),
+        });
     }
-    auto const& root_node = *scene->mRootNode;
+}
+
+// With aiProcess_PreTransformVertices, the meshes are all in the root node or its direct children
+static void voxelize_pretransformed_meshes(Assimp::Importer& importer, uint32_t const side_voxel_count,
+    std::function<void(std::span<glm::uvec3 const>)> const& voxels_importer,
+    std::function<void(std::span<VoxelBrickRun const>)> const& brick_runs_importer, bool const fills_interiors) {
+    auto const& scene = *importer.GetScene();
+    auto const& root_node = *scene.mRootNode;
     auto const for_each_node = [&](std::invocable<aiNode&> auto const& fn) {
         fn(root_node);
         for (auto const* const child : std::span(root_node.mChildren, root_node.mNumChildren)) {
@@ -85,47 +66,236 @@ bool voxelize_model(std::filesystem::path const& path, uint32_t const side_voxel
     auto const for_each_mesh = [&](std::invocable<aiMesh&> auto const& fn) {
         for_each_node([&](aiNode const& node) {
             for (auto const mesh_index : std::span(node.mMeshes, node.mNumMeshes)) {
-                fn(*scene->mMeshes[mesh_index]);
+                fn(*scene.mMeshes[mesh_index]);
             }
         });
     };
 
     auto min = glm::vec3(std::numeric_limits<float>::max());
     auto max = glm::vec3(std::numeric_limits<float>::lowest());
-    for_each_node([&](aiNode const& node) {
-        for (auto const mesh_index : std::span(node.mMeshes, node.mNumMeshes)) {
-            auto const& mesh = *scene->mMeshes[mesh_index];
-            min = glm::min(min, vec3_from(mesh.mAABB.mMin));
-            max = glm::max(max, vec3_from(mesh.mAABB.mMax));
-        }
+    for_each_mesh([&](aiMesh const& mesh) {
+        min = glm::min(min, vec3_from(mesh.mAABB.mMin));
+        max = glm::max(max, vec3_from(mesh.mAABB.mMax));
     });
     auto const model_size = max - min;
     auto const scale = static_cast<float>(side_voxel_count) / glm::compMax(model_size);
 
-    auto added_voxels = std::vector<glm::ivec3>();
+    auto triangles = std::vector<vp::Triangle>();
     for_each_mesh([&](aiMesh const& mesh) {
-        for (auto const& ai_face : std::span(mesh.mFaces, mesh.mNumFaces)) {
-            auto const a = scale * (vec3_from(mesh.mVertices[ai_face.mIndices[0]]) - min);
-            auto const b = scale * (vec3_from(mesh.mVertices[ai_face.mIndices[1]]) - min);
-            auto const c = scale * (vec3_from(mesh.mVertices[ai_face.mIndices[2]]) - min);
-
-            added_voxels.clear();
-            auto const c_coords = glm::ivec3(c);
-            dda(b, c, [&](glm::ivec3 const& pos) {
-                auto index = 0u;
-                auto const dest = std::empty(added_voxels) ? b : pos == c_coords ? c : glm::vec3(pos) + 0.5f;
-                dda(a, dest, [&](glm::ivec3 const& voxel) {
-                    if (index >= added_voxels.size()) {
-                        added_voxels.emplace_back(-1);
-                    }
-                    if (voxel != added_voxels[index]) {
-                        voxel_importer(glm::uvec3(voxel));
-                        added_voxels[index] = voxel;
-                    }
-                    index += 1u;
-                });
+        append_mesh_triangles(mesh, glm::mat4(1.f), min, scale, glm::vec3(0.f), triangles);
+    });
+    importer.FreeScene();
+    vp::voxelize_triangles(triangles, glm::uvec3(side_voxel_count), voxels_importer);
+    if (fills_interiors) {
+        vp::voxelize_triangles_interior(triangles, glm::uvec3(side_voxel_count), brick_runs_importer);
+    }
+}
+
+// The instances sharing a mesh, a linear part and a rounded fractional translation only differ by a whole voxel
+// translation. Such a mesh is voxelized once around the origin and its voxels are translated to each instance, the
+// meshes instanced once being voxelized together in place.
+static void voxelize_mesh_instances(Assimp::Importer& importer, uint32_t const side_voxel_count,
+    std::function<void(std::span<glm::uvec3 const>)> const& voxels_importer,
+    std::function<void(std::span<VoxelBrickRun const>)> const& brick_runs_importer, bool const fills_interiors) {
+    auto const& scene = *importer.GetScene();
+    auto instances = std::vector<std::pair<unsigned int, glm::mat4>>();
+    auto const add_node_instances = [&](auto const& self, aiNode const& node, glm::mat4 const& parent_transform) -> void {
+        auto const transform = parent_transform * mat4_from(node.mTransformation);
+        for (auto const mesh_index : std::span(node.mMeshes, node.mNumMeshes)) {
+            instances.emplace_back(mesh_index, transform);
+        }
+        for (auto const* const child : std::span(node.mChildren, node.mNumChildren)) {
+            self(self, *child, transform);
+        }
+    };
+    add_node_instances(add_node_instances, *scene.mRootNode, glm::mat4(1.f));
+
+    // The transformed corners of the mesh bounding boxes, looser than the transformed vertices for the rotated instances
+    auto min = glm::vec3(std::numeric_limits<float>::max());
+    auto max = glm::vec3(std::numeric_limits<float>::lowest());
+    for (auto const& [mesh_index, transform] : instances) {
+        auto const& aabb = scene.mMeshes[mesh_index]->mAABB;
+        for (auto corner = 0u; corner < 8u; ++corner) {
+            auto const position = glm::vec3(transform * glm::vec4((corner & 1u) == 0u ? aabb.mMin.x : aabb.mMax.x,
+                (corner & 2u) == 0u ? aabb.mMin.y : aabb.mMax.y, (corner & 4u) == 0u ? aabb.mMin.z : aabb.mMax.z, 1.f));
+            min = glm::min(min, position);
+            max = glm::max(max, position);
+        }
+    }
+    auto const model_size = max - min;
+    auto const scale = static_cast<float>(side_voxel_count) / glm::compMax(model_size);
+
+    // Mesh index, then the linear part and the rounded fractional translation, in grid space
+    using InstanceKey = std::pair<unsigned int, std::array<float, 12u>>;
+    auto instance_transforms = std::map<InstanceKey, std::vector<glm::mat4>>();
+    for (auto const& [mesh_index, transform] : instances) {
+        auto const linear = scale * glm::mat3(transform);
+        auto const translation = scale * (glm::vec3(transform[3]) - min);
+        auto const fractional_translation = glm::round((translation - glm::floor(translation)) * INSTANCE_TRANSLATION_STEP_COUNT)
+            / INSTANCE_TRANSLATION_STEP_COUNT;
+        auto key = InstanceKey{ mesh_index, {} };
+        for (auto i = 0; i < 3; ++i) {
+            for (auto j = 0; j < 3; ++j) {
+                key.second[static_cast<size_t>(i * 3 + j)] = linear[i][j];
+            }
+            key.second[static_cast<size_t>(9 + i)] = fractional_translation[i];
+        }
+        instance_transforms[key].emplace_back(transform);
+    }
+    instances = {};
+
+    // The meshes instanced several times are voxelized around the origin, in their own grid
+    struct InstanceGroup {
+        std::vector<vp::Triangle> triangles;
+        glm::vec3 local_min;
+        glm::uvec3 local_grid_size;
+        std::vector<glm::mat4> const* transforms;
+        std::vector<glm::uvec3> voxels;
+        std::vector<VoxelBrickRun> brick_runs;
+    };
+    auto groups = std::vector<InstanceGroup>();
+    auto group_triangle_count = size_t{ 0u };
+    auto single_instance_triangles = std::vector<vp::Triangle>();
+    for (auto const& [key, transforms] : instance_transforms) {
+        auto const& mesh = *scene.mMeshes[key.first];
+        if (std::size(transforms) == 1u) {
+            append_mesh_triangles(mesh, transforms[0], min, scale, glm::vec3(0.f), single_instance_triangles);
+            continue;
+        }
+        auto const linear_transform = glm::mat4(glm::mat3(transforms[0]));
+        auto& group = groups.emplace_back(InstanceGroup{ .transforms = &transforms });
+        append_mesh_triangles(mesh, linear_transform, glm::vec3(0.f), scale, glm::vec3(key.second[9], key.second[10], key.second[11]),
+            group.triangles);
+        auto local_min = glm::vec3(std::numeric_limits<float>::max());
+        auto local_max = glm::vec3(std::numeric_limits<float>::lowest());
+        for (auto const& triangle : group.triangles) {
+            for (auto const& vertex : triangle) {
+                local_min = glm::min(local_min, vertex);
+                local_max = glm::max(local_max, vertex);
+            }
+        }
+        group.local_min = glm::floor(local_min);
+        for (auto& triangle : group.triangles) {
+            for (auto& vertex : triangle) {
+                vertex -= group.local_min;
+            }
+        }
+        group.local_grid_size = glm::uvec3(local_max - group.local_min) + 1u;
+        group_triangle_count += std::size(group.triangles);
+    }
+
+    // voxelize_triangles gives a single core to the few batches of a small mesh, so the groups are voxelized concurrently,
+    // one per job. A group holding more than a core's share of the triangles is voxelized on all the cores before them.
+    auto const thread_count = static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 1u));
+    auto const is_large = [&](InstanceGroup const& group) {
+        return std::size(group.triangles) > group_triangle_count / thread_count;
+    };
+    auto const voxelize_group = [&](InstanceGroup& group, bool const uses_all_cores) {
+        auto const append_group_voxels = [&](std::span<glm::uvec3 const> const voxels) {
+            group.voxels.insert(std::end(group.voxels), std::begin(voxels), std::end(voxels));
+        };
+        if (uses_all_cores) {
+            vp::voxelize_triangles(group.triangles, group.local_grid_size, append_group_voxels);
+        } else {
+            vp::voxelize_triangles_on_calling_thread(group.triangles, group.local_grid_size, group.voxels);
+        }
+        if (fills_interiors) {
+            vp::voxelize_triangles_interior(group.triangles, group.local_grid_size, [&](std::span<VoxelBrickRun const> const brick_runs) {
+                group.brick_runs.insert(std::end(group.brick_runs), std::begin(brick_runs), std::end(brick_runs));
             });
         }
-    });
+        group.triangles = {};
+    };
+    for (auto& group : groups) {
+        if (is_large(group)) {
+            voxelize_group(group, true);
+        }
+    }
+    auto next_group_index = std::atomic<size_t>(0u);
+    auto const voxelize_small_groups = [&]() {
+        for (auto i = next_group_index++; i < std::size(groups); i = next_group_index++) {
+            if (!std::empty(groups[i].triangles)) {
+                voxelize_group(groups[i], false);
+            }
+        }
+    };
+    auto workers = std::vector<std::future<void>>();
+    for (auto i = size_t{ 1u }; i < std::min(thread_count, std::size(groups)); ++i) {
+        workers.emplace_back(std::async(std::launch::async, voxelize_small_groups));
+    }
+    voxelize_small_groups();
+    for (auto& worker : workers) {
+        worker.get();
+    }
+
+    // voxels_importer is only called on the calling thread, once all the groups are voxelized
+    auto const grid_max = glm::ivec3(static_cast<int>(side_voxel_count));
+    auto stamped_voxels = std::vector<glm::uvec3>();
+    stamped_voxels.reserve(STAMPED_VOXEL_BATCH_SIZE);
+    for (auto& group : groups) {
+        for (auto const& transform : *group.transforms) {
+            auto const translation = scale * (glm::vec3(transform[3]) - min);
+            auto const offset = glm::ivec3(glm::floor(translation)) + glm::ivec3(group.local_min);
+            for (auto const& group_voxel : group.voxels) {
+                auto const voxel = glm::ivec3(group_voxel) + offset;
+                if (glm::any(glm::lessThan(voxel, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(voxel, grid_max))) {
+                    continue;
+                }
+                stamped_voxels.emplace_back(voxel);
+                if (std::size(stamped_voxels) == STAMPED_VOXEL_BATCH_SIZE) {
+                    voxels_importer(stamped_voxels);
+                    stamped_voxels.clear();
+                }
+            }
+        }
+        group.voxels = {};
+    }
+    voxels_importer(stamped_voxels);
+
+    auto stamped_brick_runs = std::vector<VoxelBrickRun>();
+    stamped_brick_runs.reserve(STAMPED_BRICK_RUN_BATCH_SIZE);
+    for (auto const& group : groups) {
+        for (auto const& transform : *group.transforms) {
+            auto const translation = scale * (glm::vec3(transform[3]) - min);
+            auto const offset = glm::ivec3(glm::floor(translation)) + glm::ivec3(group.local_min);
+            for (auto const& brick_run : group.brick_runs) {
+                vp::append_translated_brick_runs(brick_run, offset, glm::uvec3(side_voxel_count), stamped_brick_runs);
+                if (std::size(stamped_brick_runs) >= STAMPED_BRICK_RUN_BATCH_SIZE) {
+                    brick_runs_importer(stamped_brick_runs);
+                    stamped_brick_runs.clear();
+                }
+            }
+        }
+    }
+    brick_runs_importer(stamped_brick_runs);
+    groups = {};
+    importer.FreeScene();
+    vp::voxelize_triangles(single_instance_triangles, glm::uvec3(side_voxel_count), voxels_importer);
+    if (fills_interiors) {
+        vp::voxelize_triangles_interior(single_instance_triangles, glm::uvec3(side_voxel_count), brick_runs_importer);
+    }
+}
+
+bool voxelize_model(std::filesystem::path const& path, uint32_t const side_voxel_count,
+    std::function<void(std::span<glm::uvec3 const>)> const& voxels_importer,
+    std::function<void(std::span<VoxelBrickRun const>)> const& brick_runs_importer, VoxelizationSettings const& settings) {
+    auto importer = Assimp::Importer();
+    importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_NORMALS | aiComponent_TANGENTS_AND_BITANGENTS
+        | aiComponent_COLORS | aiComponent_TEXCOORDS | aiComponent_BONEWEIGHTS | aiComponent_ANIMATIONS
+        | aiComponent_TEXTURES | aiComponent_LIGHTS | aiComponent_CAMERAS | aiComponent_MATERIALS);
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+    auto const pretransforms_vertices = settings.instances_meshes ? 0u : static_cast<unsigned int>(aiProcess_PreTransformVertices);
+    auto const* const scene = importer.ReadFile(string_from(path).c_str(), aiProcess_JoinIdenticalVertices
+        | aiProcess_MakeLeftHanded | aiProcess_Triangulate | aiProcess_RemoveComponent | pretransforms_vertices
+        | aiProcess_SortByPType | aiProcess_DropNormals | static_cast<unsigned int>(aiProcess_GenBoundingBoxes));
+    if (scene == nullptr) {
+        std::cerr << "Model loading error : " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+    if (settings.instances_meshes) {
+        voxelize_mesh_instances(importer, side_voxel_count, voxels_importer, brick_runs_importer, settings.fills_interiors);
+    } else {
+        voxelize_pretransformed_meshes(importer, side_voxel_count, voxels_importer, brick_runs_importer, settings.fills_interiors);
+    }
     return true;
 }
@@ -2,8 +2,31 @@
 
 #include <glm/ext/vector_uint3.hpp>
 
+#include <cstdint>
 #include <filesystem>
 #include <functional>
+#include <span>
 
+struct VoxelizationSettings {
+    // Walks the whole node hierarchy instead of pre-transforming the vertices. Each mesh is voxelized once per
+    // transform, modulo the whole voxel translations, and its voxels are copied to the other instances.
+    bool instances_meshes = false;
+    // Also imports the voxels inside the closed surfaces, which merge into far fewer uniform nodes than the surfaces
+    bool fills_interiors = false;
+};
+
+// brick_count bricks of 4x4x4 voxels stacked along y from first_brick, the brick b covering the voxels from b * 4 to
+// b * 4 + 3. The voxels of each brick are the bits of mask, in the layout of Tree64Node::children_mask.
+struct VoxelBrickRun {
+    glm::uvec3 first_brick;
+    uint32_t brick_count;
+    uint64_t mask;
+};
+
+// The voxels are imported in batches of neighbouring voxels, to amortize the call and let the builders reuse their descent.
+// The filled interiors are imported by runs of bricks instead, one step per brick rather than per voxel, so their time
+// still grows with their volume / 64. The builders merge the full bricks into full nodes, which keeps their memory close
+// to the one of the merged tree. The triangles are voxelized on all the cores, the importers are only called on the calling thread.
 [[nodiscard]] bool voxelize_model(std::filesystem::path const& path, uint32_t const side_voxel_count,
-    std::function<void(glm::uvec3 const&)> const& voxel_importer);
+    std::function<void(std::span<glm::uvec3 const>)> const& voxels_importer,
+    std::function<void(std::span<VoxelBrickRun const>)> const& brick_runs_importer, VoxelizationSettings const& settings = {});
@@ -0,0 +1,1228 @@
+#include "MortonTree64Builder.hpp"
+#include "SparseTree64.hpp"
+#include "StreamingTree64Builder.hpp"
+#include "Tree64.hpp"
+#include "filesystem.hpp"
+#include "t64.hpp"
+#include "tree64_hollow.hpp"
+#include "tree64_leaf_masks.hpp"
+#include "tree64_raycast.hpp"
+#include "triangle_voxelizer.hpp"
+#include "vox.hpp"
+#include "voxelizer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <span>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <array>
+#include <vector>
+#include <map>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <thread>
+#include <cmath>
+#include <cstring>
+#include <bit>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+
+static constexpr auto USAGE = "Usage : VulkanPlaygroundBench [--repetitions <count>] [--warmup <count>]"
+    " [--filter <name substring>] [--output <file.json>] [--validate]";
+
+// Bumped when the fields of the JSON change
+static constexpr auto JSON_FORMAT_VERSION = 1u;
+static constexpr auto SEED = 0x5eed'64u;
+
+static constexpr auto TERRAIN_SIDE_VOXEL_COUNT = 1024u; // depth 5
+static constexpr auto VOX_SIDE_VOXEL_COUNT = 256u; // the largest .vox model
+static constexpr auto VOXELIZED_SIDE_VOXEL_COUNT = 1024u;
+static constexpr auto RAYCAST_RESOLUTION = glm::uvec2(1280u, 720u);
+static constexpr auto SINGLE_THREAD_RAYCAST_RESOLUTION = glm::uvec2(320u, 180u);
+static constexpr auto VALIDATION_SIDE_VOXEL_COUNT = 256u;
+static constexpr auto VALIDATED_RANDOM_TRIANGLE_COUNT = 4096u;
+static constexpr auto VALIDATED_RANDOM_RAY_COUNT = 4096u + 5u; // the last packet is partial
+
+struct BenchmarkResult {
+    std::string name;
+    std::string item_unit;
+    uint64_t item_count; // processed by each repetition
+    std::vector<double> times; // in seconds, one per repetition
+};
+
+struct BenchmarkStatistics {
+    double mean;
+    double stddev;
+    double min;
+    double median;
+    double max;
+};
+
+static BenchmarkStatistics statistics_of(std::vector<double> times) {
+    std::ranges::sort(times);
+    auto const count = static_cast<double>(std::size(times));
+    auto const mean = std::accumulate(std::begin(times), std::end(times), 0.) / count;
+    auto const square_deviation_sum = std::accumulate(std::begin(times), std::end(times), 0., [&](double const sum, double const time) {
+        return sum + (time - mean) * (time - mean);
+    });
+    auto const middle = std::size(times) / 2u;
+    return BenchmarkStatistics{
+        .mean = mean,
+        .stddev = std::size(times) > 1u ? std::sqrt(square_deviation_sum / (count - 1.)) : 0.,
+        .min = times.front(),
+        .median = std::size(times) % 2u == 1u ? times[middle] : (times[middle - 1u] + times[middle]) / 2.,
+        .max = times.back(),
+    };
+}
+
+class BenchmarkRunner {
+public:
+    BenchmarkRunner(uint32_t const repetition_count, uint32_t const warmup_count, std::string filter)
+        : m_repetition_count{ repetition_count }, m_warmup_count{ warmup_count }, m_filter{ std::move(filter) } {
+    }
+
+    [[nodiscard]] bool is_selected(std::string_view const name) const {
+        return name.find(m_filter) != std::string_view::npos;
+    }
+
+    // setup is not timed and runs before each repetition, its result is given to run which returns the item count
+    template<typename Setup, typename Run>
+    void run(std::string name, std::string item_unit, Setup const& setup, Run const& run) {
+        if (!is_selected(name)) {
+            return;
+        }
+        auto result = BenchmarkResult{ .name = std::move(name), .item_unit = std::move(item_unit), .item_count = 0u };
+        for (auto i = 0u; i < m_warmup_count + m_repetition_count; ++i) {
+            auto state = setup();
+            auto const begin_time = std::chrono::steady_clock::now();
+            result.item_count = static_cast<uint64_t>(run(state));
+            auto const time = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_time);
+            if (i >= m_warmup_count) {
+                result.times.emplace_back(time.count());
+            }
+        }
+        auto const statistics = statistics_of(result.times);
+        std::cerr << result.name << " median " << statistics.median * 1.e3 << " ms, stddev " << statistics.stddev * 1.e3
+            << " ms" << std::endl;
+        m_results.emplace_back(std::move(result));
+    }
+
+    template<typename Run>
+    void run(std::string name, std::string item_unit, Run const& run) {
+        this->run(std::move(name), std::move(item_unit), [] { return 0; }, [&](int) { return run(); });
+    }
+
+    [[nodiscard]] std::span<BenchmarkResult const> results() const {
+        return m_results;
+    }
+
+    [[nodiscard]] uint32_t repetition_count() const {
+        return m_repetition_count;
+    }
+
+    [[nodiscard]] uint32_t warmup_count() const {
+        return m_warmup_count;
+    }
+
+private:
+    uint32_t m_repetition_count;
+    uint32_t m_warmup_count;
+    std::string m_filter;
+    std::vector<BenchmarkResult> m_results;
+};
+
+static std::string json_string(std::string_view const string) {
+    auto json = std::string("\"");
+    for (auto const c : string) {
+        if (c == '"' || c == '\\') {
+            json += '\\';
+        }
+        json += static_cast<unsigned char>(c) < 0x20u ? ' ' : c;
+    }
+    return json + '"';
+}
+
+static std::string_view kernel_name(vp::Tree64RaycastKernel const kernel) {
+    constexpr auto KERNEL_NAMES = std::array{ "scalar", "sse4.1", "avx2" };
+    return KERNEL_NAMES[static_cast<size_t>(kernel)];
+}
+
+static std::string_view kernel_name(vp::TriangleVoxelizerKernel const kernel) {
+    constexpr auto KERNEL_NAMES = std::array{ "scalar", "avx2" };
+    return KERNEL_NAMES[static_cast<size_t>(kernel)];
+}
+
+static std::string compiler_name() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    return "MSVC " + std::to_string(_MSC_FULL_VER);
+#elif defined(__VERSION__)
+    return __VERSION__;
+#else
+    return "unknown";
+#endif
+}
+
+// The times are in milliseconds and the throughput is from the median time
+static void write_json(std::ostream& ostream, BenchmarkRunner const& runner) {
+    ostream << std::setprecision(9);
+    ostream << "{\n";
+    ostream << "  \"format_version\": " << JSON_FORMAT_VERSION << ",\n";
+    ostream << "  \"compiler\": " << json_string(compiler_name()) << ",\n";
+#ifdef NDEBUG
+    ostream << "  \"optimized\": true,\n";
+#else
+    ostream << "  \"optimized\": false,\n";
+#endif
+    ostream << "  \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n";
+    ostream << "  \"fastest_raycast_kernel\": " << json_string(kernel_name(vp::fastest_raycast_kernel())) << ",\n";
+    ostream << "  \"seed\": " << SEED << ",\n";
+    ostream << "  \"repetitions\": " << runner.repetition_count() << ",\n";
+    ostream << "  \"warmup_repetitions\": " << runner.warmup_count() << ",\n";
+    ostream << "  \"benchmarks\": [";
+    auto separator = "\n";
+    for (auto const& result : runner.results()) {
+        auto const statistics = statistics_of(result.times);
+        ostream << separator << "    {\n";
+        ostream << "      \"name\": " << json_string(result.name) << ",\n";
+        ostream << "      \"item_unit\": " << json_string(result.item_unit) << ",\n";
+        ostream << "      \"item_count\": " << result.item_count << ",\n";
+        ostream << "      \"times_ms\": [";
+        for (auto i = size_t{ 0u }; i < std::size(result.times); ++i) {
+            ostream << (i == 0u ? "" : ", ") << result.times[i] * 1.e3;
+        }
+        ostream << "],\n";
+        ostream << "      \"mean_ms\": " << statistics.mean * 1.e3 << ",\n";
+        ostream << "      \"stddev_ms\": " << statistics.stddev * 1.e3 << ",\n";
+        ostream << "      \"min_ms\": " << statistics.min * 1.e3 << ",\n";
+        ostream << "      \"median_ms\": " << statistics.median * 1.e3 << ",\n";
+        ostream << "      \"max_ms\": " << statistics.max * 1.e3 << ",\n";
+        ostream << "      \"items_per_second\": " << static_cast<double>(result.item_count) / statistics.median << "\n";
+        ostream << "    }";
+        separator = ",\n";
+    }
+    ostream << "\n  ]\n}" << std::endl;
+}
+
+// The scenes only use the raw outputs of the engine and integers, so they are the same with every standard library
+
+// Two octaves of bilinear value noise on seeded lattices, each column is filled down to its lowest neighbor to be watertight
+static std::vector<glm::uvec3> terrain_voxels(uint32_t const side_voxel_count, std::mt19937& engine) {
+    struct Octave {
+        uint32_t cell_size;
+        uint32_t amplitude;
+    };
+    auto const octaves = std::array{
+        Octave{ .cell_size = side_voxel_count / 8u, .amplitude = side_voxel_count / 3u },
+        Octave{ .cell_size = side_voxel_count / 64u, .amplitude = side_voxel_count / 24u },
+    };
+    auto heights = std::vector<uint32_t>(side_voxel_count * side_voxel_count, side_voxel_count / 8u);
+    for (auto const& octave : octaves) {
+        auto const lattice_side = side_voxel_count / octave.cell_size + 1u;
+        auto lattice = std::vector<uint32_t>(lattice_side * lattice_side);
+        for (auto& height : lattice) {
+            height = static_cast<uint32_t>(engine() % octave.amplitude);
+        }
+        for (auto z = 0u; z < side_voxel_count; ++z) {
+            for (auto x = 0u; x < side_voxel_count; ++x) {
+                auto const cell = glm::uvec2(x, z) / octave.cell_size;
+                auto const f = glm::uvec2(x, z) % octave.cell_size;
+                auto const g = octave.cell_size - f;
+                auto const lattice_at = [&](uint32_t const lattice_x, uint32_t const lattice_z) {
+                    return lattice[lattice_z * lattice_side + lattice_x];
+                };
+                heights[z * side_voxel_count + x] += (lattice_at(cell.x, cell.y) * g.x * g.y
+                    + lattice_at(cell.x + 1u, cell.y) * f.x * g.y + lattice_at(cell.x, cell.y + 1u) * g.x * f.y
+                    + lattice_at(cell.x + 1u, cell.y + 1u) * f.x * f.y) / (octave.cell_size * octave.cell_size);
+            }
+        }
+    }
+    auto const height_at = [&](int32_t const x, int32_t const z) {
+        auto const max_coordinate = static_cast<int32_t>(side_voxel_count) - 1;
+        return heights[static_cast<size_t>(glm::clamp(z, 0, max_coordinate) * (max_coordinate + 1) + glm::clamp(x, 0, max_coordinate))];
+    };
+    auto voxels = std::vector<glm::uvec3>();
+    for (auto x = 0; x < static_cast<int32_t>(side_voxel_count); ++x) {
+        for (auto z = 0; z < static_cast<int32_t>(side_voxel_count); ++z) {
+            auto const height = height_at(x, z);
+            auto const lowest_neighbor_height = glm::min(glm::min(height_at(x - 1, z), height_at(x + 1, z)),
+                glm::min(height_at(x, z - 1), height_at(x, z + 1)));
+            for (auto y = glm::min(lowest_neighbor_height + 1u, height); y <= height; ++y) {
+                voxels.emplace_back(static_cast<uint32_t>(x), y, static_cast<uint32_t>(z));
+            }
+        }
+    }
+    return voxels;
+}
+
+// Fisher-Yates, std::shuffle is implementation defined
+static std::vector<glm::uvec3> shuffled(std::vector<glm::uvec3> voxels, std::mt19937& engine) {
+    for (auto i = std::size(voxels) - 1u; i > 0u; --i) {
+        std::swap(voxels[i], voxels[engine() % (i + 1u)]);
+    }
+    return voxels;
+}
+
+static void append_int32(std::vector<uint8_t>& bytes, int32_t const value) {
+    auto const value_bytes = std::bit_cast<std::array<uint8_t, sizeof(value)>>(value);
+    bytes.insert(std::end(bytes), std::begin(value_bytes), std::end(value_bytes));
+}
+
+static void append_vox_chunk(std::vector<uint8_t>& bytes, std::string_view const id, std::vector<uint8_t> const& content) {
+    bytes.insert(std::end(bytes), std::begin(id), std::end(id));
+    append_int32(bytes, static_cast<int32_t>(std::size(content)));
+    append_int32(bytes, 0); // children chunks size
+    bytes.insert(std::end(bytes), std::begin(content), std::end(content));
+}
+
+// A single model under a transform node, vox uses a x right, z up and y forward coordinates system
+static std::vector<uint8_t> vox_bytes(uint32_t const side_voxel_count, std::span<glm::uvec3 const> const voxels) {
+    auto chunks = std::vector<uint8_t>();
+    auto content = std::vector<uint8_t>();
+    for (auto i = 0u; i < 3u; ++i) {
+        append_int32(content, static_cast<int32_t>(side_voxel_count));
+    }
+    append_vox_chunk(chunks, "SIZE", content);
+    content.clear();
+    append_int32(content, static_cast<int32_t>(std::size(voxels)));
+    for (auto const& voxel : voxels) {
+        content.insert(std::end(content), { static_cast<uint8_t>(voxel.x), static_cast<uint8_t>(voxel.z),
+            static_cast<uint8_t>(voxel.y), uint8_t{ 1u } });
+    }
+    append_vox_chunk(chunks, "XYZI", content);
+    content.clear();
+    for (auto const value : { 0, 0, 1, -1, -1, 1, 0 }) { // node id, attributes, child node id, reserved, layer, a frame
+        append_int32(content, value);
+    }
+    append_vox_chunk(chunks, "nTRN", content);
+    content.clear();
+    for (auto const value : { 1, 0, 1, 0, 0 }) { // node id, attributes, a model of id 0 without attributes
+        append_int32(content, value);
+    }
+    append_vox_chunk(chunks, "nSHP", content);
+
+    auto bytes = std::vector<uint8_t>{ 'V', 'O', 'X', ' ' };
+    append_int32(bytes, 150);
+    append_vox_chunk(bytes, "MAIN", {});
+    // MAIN has all the chunks as children
+    std::ranges::copy(std::bit_cast<std::array<uint8_t, sizeof(int32_t)>>(static_cast<int32_t>(std::size(chunks))),
+        std::end(bytes) - sizeof(int32_t));
+    bytes.insert(std::end(bytes), std::begin(chunks), std::end(chunks));
+    return bytes;
+}
+
+struct Mesh {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+static Mesh icosphere(uint32_t const subdivision_count) {
+    constexpr auto T = 1.61803398874989484820f;
+    auto mesh = Mesh{
+        .positions = {
+            { -1.f, T, 0.f }, { 1.f, T, 0.f }, { -1.f, -T, 0.f }, { 1.f, -T, 0.f },
+            { 0.f, -1.f, T }, { 0.f, 1.f, T }, { 0.f, -1.f, -T }, { 0.f, 1.f, -T },
+            { T, 0.f, -1.f }, { T, 0.f, 1.f }, { -T, 0.f, -1.f }, { -T, 0.f, 1.f },
+        },
+        .indices = {
+            0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+            3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1,
+        },
+    };
+    for (auto& position : mesh.positions) {
+        position = glm::normalize(position);
+    }
+    for (auto i = 0u; i < subdivision_count; ++i) {
+        auto midpoints = std::map<std::pair<uint32_t, uint32_t>, uint32_t>();
+        auto const midpoint = [&](uint32_t const a, uint32_t const b) {
+            auto const [it, inserted] = midpoints.try_emplace(std::minmax(a, b), static_cast<uint32_t>(std::size(mesh.positions)));
+            if (inserted) {
+                mesh.positions.emplace_back(glm::normalize(mesh.positions[a] + mesh.positions[b]));
+            }
+            return it->second;
+        };
+        auto indices = std::vector<uint32_t>();
+        for (auto j = size_t{ 0u }; j < std::size(mesh.indices); j += 3u) {
+            auto const a = mesh.indices[j];
+            auto const b = mesh.indices[j + 1u];
+            auto const c = mesh.indices[j + 2u];
+            auto const ab = midpoint(a, b);
+            auto const bc = midpoint(b, c);
+            auto const ca = midpoint(c, a);
+            indices.insert(std::end(indices), { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca });
+        }
+        mesh.indices = std::move(indices);
+    }
+    return mesh;
+}
+
+// A .gltf and its .bin buffer, glTF being the format of the assimp importer built
+[[nodiscard]] static bool save_gltf(std::filesystem::path const& path, Mesh const& mesh) {
+    auto bin_path = path;
+    bin_path.replace_extension(".bin");
+    auto const positions_size = std::size(mesh.positions) * sizeof(glm::vec3);
+    auto const indices_size = std::size(mesh.indices) * sizeof(uint32_t);
+    auto bytes = std::vector<uint8_t>(positions_size + indices_size);
+    std::memcpy(std::data(bytes), std::data(mesh.positions), positions_size);
+    std::memcpy(std::data(bytes) + positions_size, std::data(mesh.indices), indices_size);
+    if (!write_binary_file(bin_path, bytes)) {
+        return false;
+    }
+    auto min = glm::vec3(std::numeric_limits<float>::max());
+    auto max = glm::vec3(std::numeric_limits<float>::lowest());
+    for (auto const& position : mesh.positions) {
+        min = glm::min(min, position);
+        max = glm::max(max, position);
+    }
+    auto ofstream = std::ofstream(path, std::ios::trunc);
+    ofstream << std::setprecision(9) << R"({"asset":{"version":"2.0"},"scene":0,"scenes":[{"nodes":[0]}],"nodes":[{"mesh":0}],)"
+        << R"("meshes":[{"primitives":[{"attributes":{"POSITION":0},"indices":1}]}],)"
+        << R"("buffers":[{"uri":)" << json_string(string_from(bin_path.filename())) << R"(,"byteLength":)" << std::size(bytes) << "}],"
+        << R"("bufferViews":[{"buffer":0,"byteOffset":0,"byteLength":)" << positions_size << R"(,"target":34962},)"
+        << R"({"buffer":0,"byteOffset":)" << positions_size << R"(,"byteLength":)" << indices_size << R"(,"target":34963}],)"
+        << R"("accessors":[{"bufferView":0,"componentType":5126,"count":)" << std::size(mesh.positions)
+        << R"(,"type":"VEC3","min":[)" << min.x << ',' << min.y << ',' << min.z << R"(],"max":[)" << max.x << ','
+        << max.y << ',' << max.z << "]},"
+        << R"({"bufferView":1,"componentType":5125,"count":)" << std::size(mesh.indices) << R"(,"type":"SCALAR"}]})";
+    return static_cast<bool>(ofstream);
+}
+
+// Primary rays of a camera looking down at the middle of the terrain
+// The triangles of the icosphere scaled into [margin, side_voxel_count - margin]
+static std::vector<vp::Triangle> icosphere_triangles(uint32_t const subdivision_count, uint32_t const side_voxel_count,
+    float const margin) {
+    auto const mesh = icosphere(subdivision_count);
+    auto const scale = static_cast<float>(side_voxel_count) / 2.f - margin;
+    auto const center = glm::vec3(static_cast<float>(side_voxel_count) / 2.f);
+    auto triangles = std::vector<vp::Triangle>();
+    for (auto i = size_t{ 0u }; i < std::size(mesh.indices); i += 3u) {
+        triangles.emplace_back(vp::Triangle{ mesh.positions[mesh.indices[i]] * scale + center,
+            mesh.positions[mesh.indices[i + 1u]] * scale + center, mesh.positions[mesh.indices[i + 2u]] * scale + center });
+    }
+    return triangles;
+}
+
+static std::vector<vp::Tree64Ray> camera_rays(glm::uvec2 const& resolution) {
+    auto const side = static_cast<float>(TERRAIN_SIDE_VOXEL_COUNT);
+    auto const origin = glm::vec3(0.5f, 0.7f, -0.2f) * side;
+    auto const forward = glm::normalize(glm::vec3(0.5f, 0.2f, 0.5f) * side - origin);
+    auto const right = glm::normalize(glm::cross(forward, glm::vec3(0.f, 1.f, 0.f)));
+    auto const up = glm::cross(right, forward);
+    auto const aspect_ratio = static_cast<float>(resolution.x) / static_cast<float>(resolution.y);
+    auto rays = std::vector<vp::Tree64Ray>();
+    rays.reserve(static_cast<size_t>(resolution.x) * resolution.y);
+    for (auto y = 0u; y < resolution.y; ++y) {
+        for (auto x = 0u; x < resolution.x; ++x) {
+            auto const uv = (glm::vec2(glm::uvec2(x, y)) + 0.5f) / glm::vec2(resolution) * 2.f - 1.f;
+            auto const direction = forward + uv.x * aspect_ratio * right - uv.y * up;
+            rays.emplace_back(vp::Tree64Ray{ .origin = origin, .direction = glm::normalize(direction) });
+        }
+    }
+    return rays;
+}
+
+static void run_benchmarks(BenchmarkRunner& runner, std::filesystem::path const& directory) {
+    auto engine = std::mt19937(SEED);
+    auto const terrain_depth = static_cast<uint8_t>(std::bit_width(TERRAIN_SIDE_VOXEL_COUNT - 1u) / 2u);
+    auto const terrain = terrain_voxels(TERRAIN_SIDE_VOXEL_COUNT, engine);
+    auto const shuffled_terrain = shuffled(terrain, engine);
+    auto const voxel_count = std::size(terrain);
+
+    // Building
+    runner.run("tree64_add_voxel", "voxels", [&] {
+        auto tree64 = vp::Tree64(terrain_depth);
+        for (auto const& voxel : terrain) {
+            tree64.add_voxel(voxel);
+        }
+        return voxel_count;
+    });
+    runner.run("tree64_add_voxel_shuffled", "voxels", [&] {
+        auto tree64 = vp::Tree64(terrain_depth);
+        for (auto const& voxel : shuffled_terrain) {
+            tree64.add_voxel(voxel);
+        }
+        return voxel_count;
+    });
+    runner.run("tree64_add_voxels", "voxels", [&] {
+        auto tree64 = vp::Tree64(terrain_depth);
+        tree64.add_voxels(terrain);
+        return voxel_count;
+    });
+    runner.run("tree64_build_contiguous_nodes", "nodes", [&] {
+        auto tree64 = vp::Tree64(terrain_depth);
+        tree64.add_voxels(terrain);
+        return tree64;
+    }, [](vp::Tree64& tree64) {
+        return std::size(tree64.build_contiguous_nodes());
+    });
+    runner.run("morton_tree64_build_contiguous_nodes", "voxels", [&] {
+        static_cast<void>(vp::MortonTree64Builder::build_contiguous_nodes(terrain_depth, terrain));
+        return voxel_count;
+    });
+    // The import of a closed mesh without then with its interior, whose full bricks are merged into full nodes. The peak
+    // building memory is printed since it should follow the merged tree more than the filled volume.
+    auto const icosphere_depth = static_cast<uint8_t>(std::bit_width(VOXELIZED_SIDE_VOXEL_COUNT - 1u) / 2u);
+    auto const icosphere6_triangles = icosphere_triangles(6u, VOXELIZED_SIDE_VOXEL_COUNT, 0.f);
+    for (auto const fills_interiors : { false, true }) {
+        auto const name = std::string("morton_tree64_import_icosphere6") + (fills_interiors ? "_filled" : "");
+        auto peak_building_memory_size = size_t{ 0u };
+        runner.run(name, "nodes", [&] {
+            auto builder = vp::MortonTree64Builder(icosphere_depth);
+            vp::voxelize_triangles(icosphere6_triangles, glm::uvec3(VOXELIZED_SIDE_VOXEL_COUNT),
+                [&](std::span<glm::uvec3 const> const voxels) {
+                builder.add_voxels(voxels);
+            });
+            if (fills_interiors) {
+                vp::voxelize_triangles_interior(icosphere6_triangles, glm::uvec3(VOXELIZED_SIDE_VOXEL_COUNT),
+                    [&](std::span<VoxelBrickRun const> const brick_runs) {
+                    builder.add_brick_runs(brick_runs);
+                });
+            }
+            auto const node_count = std::size(builder.build_contiguous_nodes());
+            peak_building_memory_size = builder.peak_building_memory_size();
+            return node_count;
+        });
+        if (runner.is_selected(name)) {
+            std::cerr << name << " peak building memory " << peak_building_memory_size / 1024u << " KiB" << std::endl;
+        }
+    }
+
+    // Files
+    auto const contiguous_tree64 = vp::ContiguousTree64{
+        .depth = terrain_depth,
+        .nodes = vp::MortonTree64Builder::build_contiguous_nodes(terrain_depth, terrain),
+    };
+    auto const t64_path = directory / "terrain.t64";
+    runner.run("save_t64", "bytes", [&] {
+        if (!vp::save_t64(t64_path, contiguous_tree64)) {
+            throw std::runtime_error("Cannot save " + string_from(t64_path));
+        }
+        return std::filesystem::file_size(t64_path);
+    });
+    if (runner.is_selected("import_t64") && !vp::save_t64(t64_path, contiguous_tree64)) {
+        throw std::runtime_error("Cannot save " + string_from(t64_path));
+    }
+    runner.run("import_t64", "bytes", [&] {
+        if (!vp::import_t64(t64_path).has_value()) {
+            throw std::runtime_error("Cannot import " + string_from(t64_path));
+        }
+        return std::filesystem::file_size(t64_path);
+    });
+
+    auto const vox_path = directory / "terrain.vox";
+    if (runner.is_selected("import_vox")
+        && !write_binary_file(vox_path, vox_bytes(VOX_SIDE_VOXEL_COUNT, terrain_voxels(VOX_SIDE_VOXEL_COUNT, engine)))) {
+        throw std::runtime_error("Cannot write " + string_from(vox_path));
+    }
+    runner.run("import_vox", "voxels", [&] {
+        auto imported_voxel_count = size_t{ 0u };
+        auto const success = ::import_vox(vox_path, [](glm::uvec3 const&) {
+            return true;
+        }, [&](std::span<glm::uvec3 const> const voxels) {
+            imported_voxel_count += std::size(voxels);
+        });
+        if (!success) {
+            throw std::runtime_error("Cannot import " + string_from(vox_path));
+        }
+        return imported_voxel_count;
+    });
+
+    // Voxelization, few long triangles and many small ones
+    for (auto const subdivision_count : { 2u, 6u }) {
+        auto const name = "icosphere" + std::to_string(subdivision_count);
+        auto const gltf_path = directory / (name + ".gltf");
+        auto const voxelize_name = "voxelize_model_" + name;
+        auto const convert_name = "convert_" + name + "_to_t64";
+        auto const filled_convert_name = "convert_" + name + "_filled_to_t64";
+        if ((runner.is_selected(voxelize_name) || runner.is_selected(convert_name) || runner.is_selected(filled_convert_name))
+            && !save_gltf(gltf_path, icosphere(subdivision_count))) {
+            throw std::runtime_error("Cannot write " + string_from(gltf_path));
+        }
+        // The triangles alone, without the model import
+        auto const mesh = icosphere(subdivision_count);
+        for (auto kernel = vp::TriangleVoxelizerKernel::Scalar; kernel <= vp::fastest_triangle_voxelizer_kernel();
+            kernel = static_cast<vp::TriangleVoxelizerKernel>(static_cast<uint8_t>(kernel) + 1u)) {
+            auto voxels = std::vector<glm::uvec3>();
+            runner.run("voxelize_triangles_" + name + "_" + std::string(kernel_name(kernel)), "triangles", [&] {
+                auto const scale = static_cast<float>(VOXELIZED_SIDE_VOXEL_COUNT) / 2.f;
+                for (auto i = size_t{ 0u }; i < std::size(mesh.indices); i += 3u) {
+                    voxels.clear();
+                    vp::voxelize_triangle((mesh.positions[mesh.indices[i]] + 1.f) * scale,
+                        (mesh.positions[mesh.indices[i + 1u]] + 1.f) * scale, (mesh.positions[mesh.indices[i + 2u]] + 1.f) * scale,
+                        glm::uvec3(VOXELIZED_SIDE_VOXEL_COUNT), voxels, kernel);
+                }
+                return std::size(mesh.indices) / 3u;
+            });
+        }
+        runner.run(voxelize_name, "voxels", [&] {
+            auto voxelized_voxel_count = size_t{ 0u };
+            auto const success = ::voxelize_model(gltf_path, VOXELIZED_SIDE_VOXEL_COUNT, [&](std::span<glm::uvec3 const> const voxels) {
+                voxelized_voxel_count += std::size(voxels);
+            }, [&](std::span<VoxelBrickRun const> const brick_runs) {
+                for (auto const& brick_run : brick_runs) {
+                    voxelized_voxel_count += static_cast<size_t>(std::popcount(brick_run.mask)) * brick_run.brick_count;
+                }
+            });
+            if (!success) {
+                throw std::runtime_error("Cannot voxelize " + string_from(gltf_path));
+            }
+            return voxelized_voxel_count;
+        });
+        // The whole import of the application, to a saved .t64, without then with the interior filled. The peak
+        // building memory is printed since the filled interiors are imported by runs of bricks instead of voxels.
+        for (auto const fills_interiors : { false, true }) {
+            auto const& name_to_run = fills_interiors ? filled_convert_name : convert_name;
+            auto peak_building_memory_size = size_t{ 0u };
+            runner.run(name_to_run, "nodes", [&] {
+                auto builder = vp::MortonTree64Builder::voxelize_model(gltf_path, VOXELIZED_SIDE_VOXEL_COUNT,
+                    VoxelizationSettings{ .fills_interiors = fills_interiors });
+                if (!builder.has_value()) {
+                    throw std::runtime_error("Cannot voxelize " + string_from(gltf_path));
+                }
+                auto const converted_tree64 = vp::ContiguousTree64{ .depth = builder->depth(), .nodes = builder->build_contiguous_nodes() };
+                peak_building_memory_size = builder->peak_building_memory_size();
+                if (!vp::save_t64(t64_path, converted_tree64)) {
+                    throw std::runtime_error("Cannot save " + string_from(t64_path));
+                }
+                return std::size(converted_tree64.nodes);
+            });
+            if (runner.is_selected(name_to_run)) {
+                std::cerr << name_to_run << " peak building memory " << peak_building_memory_size / 1024u << " KiB" << std::endl;
+            }
+        }
+    }
+
+    // Traversal, the kernels the CPU does not support are skipped
+    auto const rays = camera_rays(RAYCAST_RESOLUTION);
+    auto const single_thread_rays = camera_rays(SINGLE_THREAD_RAYCAST_RESOLUTION);
+    auto single_thread_hits = std::vector<std::optional<vp::Tree64Hit>>(std::size(single_thread_rays));
+    auto const max_distance = std::numeric_limits<float>::max();
+    for (auto kernel = vp::Tree64RaycastKernel::Scalar; kernel <= vp::fastest_raycast_kernel();
+        kernel = static_cast<vp::Tree64RaycastKernel>(static_cast<uint8_t>(kernel) + 1u)) {
+        runner.run("raycast_" + std::string(kernel_name(kernel)), "rays", [&] {
+            static_cast<void>(vp::raycast(contiguous_tree64, rays, max_distance, {}, kernel));
+            return std::size(rays);
+        });
+        runner.run("raycast_on_calling_thread_" + std::string(kernel_name(kernel)), "rays", [&] {
+            vp::raycast_on_calling_thread(contiguous_tree64, single_thread_rays, max_distance, single_thread_hits, kernel);
+            return std::size(single_thread_rays);
+        });
+    }
+
+    // Traversal specialized on the depth of the tree against the one of any depth, on smaller terrains too
+    for (auto depth = uint8_t{ 3u }; depth <= terrain_depth; ++depth) {
+        auto const name = "raycast_depth" + std::to_string(depth) + "_";
+        auto const side_voxel_count = 1u << (depth * 2u);
+        // Built by the first selected benchmark, with its own seed to not depend on the filter
+        auto depth_tree64 = depth == terrain_depth ? std::optional(contiguous_tree64) : std::nullopt;
+        auto const built_depth_tree64 = [&]() -> vp::ContiguousTree64 const& {
+            if (!depth_tree64.has_value()) {
+                auto depth_engine = std::mt19937(SEED + depth);
+                depth_tree64 = vp::ContiguousTree64{
+                    .depth = depth,
+                    .nodes = vp::MortonTree64Builder::build_contiguous_nodes(depth, terrain_voxels(side_voxel_count, depth_engine)),
+                };
+            }
+            return depth_tree64.value();
+        };
+        // The camera keeps the same view of the smaller terrains
+        auto depth_rays = single_thread_rays;
+        auto const scale = static_cast<float>(side_voxel_count) / static_cast<float>(TERRAIN_SIDE_VOXEL_COUNT);
+        for (auto& ray : depth_rays) {
+            ray.origin *= scale;
+        }
+        for (auto kernel = vp::Tree64RaycastKernel::Scalar; kernel <= vp::fastest_raycast_kernel();
+            kernel = static_cast<vp::Tree64RaycastKernel>(static_cast<uint8_t>(kernel) + 1u)) {
+            for (auto const specializes_depth : { false, true }) {
+                runner.run(name + std::string(kernel_name(kernel)) + (specializes_depth ? "_specialized" : "_runtime"), "rays", [&] {
+                    vp::raycast_on_calling_thread(built_depth_tree64(), depth_rays, max_distance, single_thread_hits, kernel, specializes_depth);
+                    return std::size(depth_rays);
+                });
+            }
+        }
+    }
+}
+
+// Each check prints its first difference and returns whether it passed
+
+// The kernels must give the same voxels in the same order, on the icospheres and on small random triangles, thin ones too
+static bool validate_triangle_voxelizer_kernels(std::mt19937& engine) {
+    if (vp::fastest_triangle_voxelizer_kernel() == vp::TriangleVoxelizerKernel::Scalar) {
+        std::cerr << "validate_triangle_voxelizer_kernels skipped, the CPU only runs the scalar kernel" << std::endl;
+        return true;
+    }
+    auto triangles = icosphere_triangles(2u, VOXELIZED_SIDE_VOXEL_COUNT, 0.f);
+    for (auto const& triangle : icosphere_triangles(6u, VOXELIZED_SIDE_VOXEL_COUNT, 0.f)) {
+        triangles.emplace_back(triangle);
+    }
+    auto const random_position = [&](uint32_t const side_voxel_count) {
+        auto position = glm::vec3();
+        for (auto i = 0; i < 3; ++i) {
+            position[i] = static_cast<float>(engine() % (side_voxel_count * 256u)) / 256.f;
+        }
+        return position;
+    };
+    for (auto i = 0u; i < VALIDATED_RANDOM_TRIANGLE_COUNT; ++i) {
+        auto const a = random_position(VOXELIZED_SIDE_VOXEL_COUNT - 64u);
+        auto const b = a + random_position(64u);
+        auto const c = i % 2u == 0u ? a + random_position(64u) : glm::mix(a, b, 0.5f) + random_position(1u) / 64.f;
+        triangles.emplace_back(vp::Triangle{ a, b, c });
+    }
+    auto const grid_size = glm::uvec3(VOXELIZED_SIDE_VOXEL_COUNT);
+    auto scalar_voxels = std::vector<glm::uvec3>();
+    auto voxels = std::vector<glm::uvec3>();
+    for (auto kernel = static_cast<vp::TriangleVoxelizerKernel>(static_cast<uint8_t>(vp::TriangleVoxelizerKernel::Scalar) + 1u);
+        kernel <= vp::fastest_triangle_voxelizer_kernel();
+        kernel = static_cast<vp::TriangleVoxelizerKernel>(static_cast<uint8_t>(kernel) + 1u)) {
+        for (auto const& [a, b, c] : triangles) {
+            scalar_voxels.clear();
+            voxels.clear();
+            vp::voxelize_triangle(a, b, c, grid_size, scalar_voxels, vp::TriangleVoxelizerKernel::Scalar);
+            vp::voxelize_triangle(a, b, c, grid_size, voxels, kernel);
+            if (voxels != scalar_voxels) {
+                std::cerr << std::setprecision(9) << "validate_triangle_voxelizer_kernels failed, the " << kernel_name(kernel)
+                    << " kernel gives " << std::size(voxels) << " voxels and the scalar one " << std::size(scalar_voxels)
+                    << " for the triangle (" << a.x << ", " << a.y << ", " << a.z << ") (" << b.x << ", " << b.y << ", " << b.z
+                    << ") (" << c.x << ", " << c.y << ", " << c.z << ")" << std::endl;
+                return false;
+            }
+        }
+    }
+    std::cerr << "validate_triangle_voxelizer_kernels passed, " << std::size(triangles) << " triangles" << std::endl;
+    return true;
+}
+
+// The outside of a closed mesh voxelized on all the cores must not reach its inside through the 6 neighbors of a voxel
+static bool validate_watertight_surfaces() {
+    constexpr auto side_voxel_count = VALIDATION_SIDE_VOXEL_COUNT;
+    auto const grid_size = glm::uvec3(side_voxel_count);
+    auto const index_of = [&](glm::uvec3 const& voxel) {
+        return (static_cast<size_t>(voxel.z) * side_voxel_count + voxel.y) * side_voxel_count + voxel.x;
+    };
+    for (auto const subdivision_count : { 3u, 6u }) {
+        // The margin leaves the outside connected around the sphere
+        auto const triangles = icosphere_triangles(subdivision_count, side_voxel_count, 4.25f);
+        auto states = std::vector<uint8_t>(static_cast<size_t>(side_voxel_count) * side_voxel_count * side_voxel_count, 0u);
+        constexpr auto FILLED = uint8_t{ 1u };
+        constexpr auto OUTSIDE = uint8_t{ 2u };
+        auto is_in_grid = true;
+        vp::voxelize_triangles(triangles, grid_size, [&](std::span<glm::uvec3 const> const voxels) {
+            for (auto const& voxel : voxels) {
+                if (glm::any(glm::greaterThanEqual(voxel, grid_size))) {
+                    is_in_grid = false;
+                    continue;
+                }
+                states[index_of(voxel)] = FILLED;
+            }
+        });
+        if (!is_in_grid) {
+            std::cerr << "validate_watertight_surfaces failed, the icosphere" << subdivision_count
+                << " gives voxels out of the grid" << std::endl;
+            return false;
+        }
+        auto stack = std::vector<glm::uvec3>{ glm::uvec3(0u) };
+        states[0] = OUTSIDE;
+        while (!std::empty(stack)) {
+            auto const voxel = stack.back();
+            stack.pop_back();
+            for (auto axis = 0; axis < 3; ++axis) {
+                for (auto const is_forward : { false, true }) {
+                    if ((!is_forward && voxel[axis] == 0u) || (is_forward && voxel[axis] + 1u == side_voxel_count)) {
+                        continue;
+                    }
+                    auto neighbor = voxel;
+                    neighbor[axis] = is_forward ? neighbor[axis] + 1u : neighbor[axis] - 1u;
+                    if (states[index_of(neighbor)] == 0u) {
+                        states[index_of(neighbor)] = OUTSIDE;
+                        stack.emplace_back(neighbor);
+                    }
+                }
+            }
+        }
+        if (states[index_of(grid_size / 2u)] == OUTSIDE) {
+            std::cerr << "validate_watertight_surfaces failed, the surface of the icosphere" << subdivision_count
+                << " has a hole" << std::endl;
+            return false;
+        }
+    }
+    std::cerr << "validate_watertight_surfaces passed" << std::endl;
+    return true;
+}
+
+// The triangles of the faces of the box [0, size]
+static std::vector<vp::Triangle> box_triangles(glm::vec3 const& size) {
+    auto const corner = [&](uint32_t const index) {
+        return glm::vec3((index & 1u) == 0u ? 0.f : size.x, (index & 2u) == 0u ? 0.f : size.y, (index & 4u) == 0u ? 0.f : size.z);
+    };
+    constexpr auto FACES = std::array{
+        std::array{ 0u, 2u, 6u, 4u }, std::array{ 1u, 3u, 7u, 5u }, std::array{ 0u, 1u, 5u, 4u },
+        std::array{ 2u, 3u, 7u, 6u }, std::array{ 0u, 1u, 3u, 2u }, std::array{ 4u, 5u, 7u, 6u },
+    };
+    auto triangles = std::vector<vp::Triangle>();
+    for (auto const& face : FACES) {
+        triangles.emplace_back(vp::Triangle{ corner(face[0]), corner(face[1]), corner(face[2]) });
+        triangles.emplace_back(vp::Triangle{ corner(face[0]), corner(face[2]), corner(face[3]) });
+    }
+    return triangles;
+}
+
+static void append_brick_run_voxels(std::span<VoxelBrickRun const> const brick_runs, std::vector<glm::uvec3>& voxels) {
+    for (auto const& brick_run : brick_runs) {
+        for (auto i = 0u; i < brick_run.brick_count; ++i) {
+            for (auto mask = brick_run.mask; mask != 0u; mask &= mask - 1u) {
+                auto const bit_index = static_cast<uint32_t>(std::countr_zero(mask));
+                voxels.emplace_back((brick_run.first_brick + glm::uvec3(0u, i, 0u)) * 4u
+                    + glm::uvec3(bit_index % 4u, bit_index / 16u, bit_index / 4u % 4u));
+            }
+        }
+    }
+}
+
+// The interior of a box filling the grid, its top face on the top of the grid, must be every voxel of the grid
+static bool validate_filled_interiors() {
+    for (auto const& grid_size : { glm::uvec3(64u), glm::uvec3(64u, 61u, 64u) }) {
+        auto const voxel_count = static_cast<size_t>(grid_size.x) * grid_size.y * grid_size.z;
+        auto is_filled = std::vector<bool>(voxel_count);
+        auto filled_voxel_count = size_t{ 0u };
+        auto is_in_grid = true;
+        auto voxels = std::vector<glm::uvec3>();
+        vp::voxelize_triangles_interior(box_triangles(glm::vec3(grid_size)), grid_size,
+            [&](std::span<VoxelBrickRun const> const brick_runs) {
+            append_brick_run_voxels(brick_runs, voxels);
+        });
+        for (auto const& voxel : voxels) {
+            if (glm::any(glm::greaterThanEqual(voxel, grid_size))) {
+                is_in_grid = false;
+                continue;
+            }
+            auto const index = (static_cast<size_t>(voxel.z) * grid_size.y + voxel.y) * grid_size.x + voxel.x;
+            filled_voxel_count += is_filled[index] ? 0u : 1u;
+            is_filled[index] = true;
+        }
+        if (!is_in_grid || filled_voxel_count != voxel_count) {
+            std::cerr << "validate_filled_interiors failed, the box filling a " << grid_size.x << "x" << grid_size.y << "x"
+                << grid_size.z << " grid fills " << filled_voxel_count << " voxels of it"
+                << (is_in_grid ? "" : " and some out of it") << std::endl;
+            return false;
+        }
+    }
+    std::cerr << "validate_filled_interiors passed" << std::endl;
+    return true;
+}
+
+// The brick runs of a group stamped at an offset must be the voxels of the interior of the triangles moved by it, for
+// every offset & 3, the offsets below 0 and past the end of a grid whose sides are not multiples of 4 clipping them. The
+// vertices are on a 1/8 voxel grid, so that the moved triangles are exact.
+static bool validate_stamped_interiors() {
+    constexpr auto local_side_voxel_count = 22u;
+    auto const local_grid_size = glm::uvec3(local_side_voxel_count);
+    auto const grid_size = glm::uvec3(71u, 66u, 69u);
+    auto const base_offsets = std::array{ -12, 20, static_cast<int>(local_side_voxel_count) + 28 };
+    auto sphere_triangles = icosphere_triangles(2u, local_side_voxel_count, 1.25f);
+    for (auto& triangle : sphere_triangles) {
+        for (auto& vertex : triangle) {
+            vertex = glm::round(vertex * 8.f) / 8.f;
+        }
+    }
+    auto const shapes = std::array{
+        std::pair{ "icosphere2", sphere_triangles },
+        std::pair{ "box", box_triangles(glm::vec3(9.5f, 17.25f, 6.75f)) },
+    };
+    auto const voxel_indices_of = [&](std::span<VoxelBrickRun const> const brick_runs) {
+        auto voxels = std::vector<glm::uvec3>();
+        append_brick_run_voxels(brick_runs, voxels);
+        auto indices = std::vector<size_t>();
+        for (auto const& voxel : voxels) {
+            // The voxels out of the grid are kept as an index past its end
+            indices.emplace_back(glm::any(glm::greaterThanEqual(voxel, grid_size)) ? std::numeric_limits<size_t>::max()
+                : (static_cast<size_t>(voxel.z) * grid_size.y + voxel.y) * grid_size.x + voxel.x);
+        }
+        std::ranges::sort(indices);
+        return indices;
+    };
+    auto stamp_count = 0u;
+    for (auto const& [name, triangles] : shapes) {
+        auto local_brick_runs = std::vector<VoxelBrickRun>();
+        vp::voxelize_triangles_interior(triangles, local_grid_size, [&](std::span<VoxelBrickRun const> const brick_runs) {
+            local_brick_runs.insert(std::end(local_brick_runs), std::begin(brick_runs), std::end(brick_runs));
+        });
+        for (auto base_index = 0u; base_index < std::size(base_offsets); ++base_index) {
+            for (auto shift_index = 0u; shift_index < 64u; ++shift_index) {
+                auto offset = glm::ivec3();
+                for (auto axis = 0u; axis < 3u; ++axis) {
+                    offset[static_cast<glm::length_t>(axis)] = base_offsets[(base_index + axis) % std::size(base_offsets)]
+                        + static_cast<int>((shift_index >> (axis * 2u)) & 3u);
+                }
+                auto stamped_brick_runs = std::vector<VoxelBrickRun>();
+                for (auto const& brick_run : local_brick_runs) {
+                    vp::append_translated_brick_runs(brick_run, offset, grid_size, stamped_brick_runs);
+                }
+                auto translated_triangles = triangles;
+                for (auto& triangle : translated_triangles) {
+                    for (auto& vertex : triangle) {
+                        vertex += glm::vec3(offset);
+                    }
+                }
+                auto brick_runs = std::vector<VoxelBrickRun>();
+                vp::voxelize_triangles_interior(translated_triangles, grid_size,
+                    [&](std::span<VoxelBrickRun const> const voxelized_brick_runs) {
+                    brick_runs.insert(std::end(brick_runs), std::begin(voxelized_brick_runs), std::end(voxelized_brick_runs));
+                });
+                auto const stamped_voxel_indices = voxel_indices_of(stamped_brick_runs);
+                auto const voxel_indices = voxel_indices_of(brick_runs);
+                if (stamped_voxel_indices != voxel_indices) {
+                    std::cerr << "validate_stamped_interiors failed, the " << name << " stamped at " << offset.x << ", "
+                        << offset.y << ", " << offset.z << " gives " << std::size(stamped_voxel_indices)
+                        << " voxels and its moved triangles " << std::size(voxel_indices) << std::endl;
+                    return false;
+                }
+                stamp_count += 1u;
+            }
+        }
+    }
+    std::cerr << "validate_stamped_interiors passed, " << stamp_count << " offsets" << std::endl;
+    return true;
+}
+
+static bool are_equal(std::span<vp::Tree64Node const> const nodes, std::span<vp::Tree64Node const> const other_nodes) {
+    return std::ranges::equal(nodes, other_nodes, [](vp::Tree64Node const& node, vp::Tree64Node const& other_node) {
+        return node.children_mask == other_node.children_mask
+            && node.is_leaf_and_first_child_node_index == other_node.is_leaf_and_first_child_node_index;
+    });
+}
+
+// The builders must give from the surface voxels and the brick runs of a filled icosphere the nodes Tree64 gives from
+// all their voxels. The morton builders merge the full bricks into bigger full nodes, split again by the partitions of
+// the parallel build, and the small memory budget splits the streaming build in regions.
+static bool validate_brick_run_builders() {
+    constexpr auto side_voxel_count = VALIDATION_SIDE_VOXEL_COUNT;
+    auto const depth = static_cast<uint8_t>(std::bit_width(side_voxel_count - 1u) / 2u);
+    auto const grid_size = glm::uvec3(side_voxel_count);
+    auto const triangles = icosphere_triangles(4u, side_voxel_count, 2.5f);
+    auto surface_voxels = std::vector<glm::uvec3>();
+    vp::voxelize_triangles(triangles, grid_size, [&](std::span<glm::uvec3 const> const voxels) {
+        surface_voxels.insert(std::end(surface_voxels), std::begin(voxels), std::end(voxels));
+    });
+    auto brick_runs = std::vector<VoxelBrickRun>();
+    vp::voxelize_triangles_interior(triangles, grid_size, [&](std::span<VoxelBrickRun const> const voxelized_brick_runs) {
+        brick_runs.insert(std::end(brick_runs), std::begin(voxelized_brick_runs), std::end(voxelized_brick_runs));
+    });
+    auto voxels = surface_voxels;
+    append_brick_run_voxels(brick_runs, voxels);
+    auto reference_tree64 = vp::Tree64(depth);
+    reference_tree64.add_voxels(voxels);
+    auto const reference_nodes = reference_tree64.build_contiguous_nodes();
+
+    auto const add_to = [&](auto& builder) {
+        builder.add_voxels(surface_voxels);
+        builder.add_brick_runs(brick_runs);
+    };
+    auto tree64 = vp::Tree64(depth);
+    add_to(tree64);
+    auto sparse_tree64 = vp::SparseTree64(depth);
+    add_to(sparse_tree64);
+    auto morton_builder = vp::MortonTree64Builder(depth);
+    add_to(morton_builder);
+    auto const t64_path = std::filesystem::temp_directory_path() / "VulkanPlaygroundBenchValidation.t64";
+    auto streaming_builder = vp::StreamingTree64Builder(depth, vp::StreamingTree64Builder::MIN_MEMORY_BUDGET);
+    add_to(streaming_builder);
+    auto streamed_tree64 = streaming_builder.save_t64(t64_path) ? vp::import_t64(t64_path) : std::nullopt;
+    std::filesystem::remove(t64_path);
+    auto const builders_nodes = std::array{
+        std::pair{ "Tree64", tree64.build_contiguous_nodes() },
+        std::pair{ "SparseTree64", sparse_tree64.build_contiguous_nodes() },
+        std::pair{ "MortonTree64Builder", morton_builder.build_contiguous_nodes() },
+        std::pair{ "StreamingTree64Builder", streamed_tree64.has_value() ? streamed_tree64->nodes : std::vector<vp::Tree64Node>() },
+    };
+    for (auto const& [name, nodes] : builders_nodes) {
+        if (!are_equal(nodes, reference_nodes)) {
+            std::cerr << "validate_brick_run_builders failed, " << name << " gives " << std::size(nodes)
+                << " nodes from the brick runs and Tree64 " << std::size(reference_nodes) << " from their voxels" << std::endl;
+            return false;
+        }
+    }
+    std::cerr << "validate_brick_run_builders passed, " << std::size(brick_runs) << " brick runs" << std::endl;
+    return true;
+}
+
+// The voxels of the tree, indexed by (z * side + y) * side + x, the full leaf children filling their whole cube
+static std::vector<bool> dense_voxels(vp::ContiguousTree64 const& contiguous_tree64) {
+    auto const side_voxel_count = 1u << (contiguous_tree64.depth * 2u);
+    auto voxels = std::vector<bool>(static_cast<size_t>(side_voxel_count) * side_voxel_count * side_voxel_count);
+    auto const fill = [&](auto const& self, uint32_t const node_index, glm::uvec3 const& node_min, uint32_t const child_side) -> void {
+        auto const& node = contiguous_tree64.nodes[node_index];
+        auto child_index = node.first_child_node_index();
+        for (auto mask = node.children_mask; mask != 0u; mask &= mask - 1u) {
+            auto const bit = static_cast<uint32_t>(std::countr_zero(mask));
+            auto const child_min = node_min + glm::uvec3(bit % 4u, bit / 16u, bit / 4u % 4u) * child_side;
+            if (!node.is_leaf()) {
+                self(self, child_index, child_min, child_side / 4u);
+                child_index += 1u;
+                continue;
+            }
+            for (auto z = child_min.z; z < child_min.z + child_side; ++z) {
+                for (auto y = child_min.y; y < child_min.y + child_side; ++y) {
+                    for (auto x = child_min.x; x < child_min.x + child_side; ++x) {
+                        voxels[(static_cast<size_t>(z) * side_voxel_count + y) * side_voxel_count + x] = true;
+                    }
+                }
+            }
+        }
+    };
+    fill(fill, 0u, glm::uvec3(0u), side_voxel_count / 4u);
+    return voxels;
+}
+
+// Hollowing a filled icosphere and a filled box must keep exactly the filled voxels with an empty or out of the grid
+// neighbor among their 6, found on the dense grid. The voxels of a uniform full node are kept whole unless its 6
+// neighbors of the same size are full too, the test then runs on the largest full cube of the voxel. The node count
+// must not go up.
+static bool validate_hollowed_trees() {
+    constexpr auto depth = uint8_t{ 3u };
+    constexpr auto side_voxel_count = 1u << (depth * 2u);
+    auto const grid_size = glm::uvec3(side_voxel_count);
+    auto sphere_voxels = std::vector<glm::uvec3>();
+    auto const sphere_triangles = icosphere_triangles(3u, side_voxel_count, 1.5f);
+    vp::voxelize_triangles(sphere_triangles, grid_size, [&](std::span<glm::uvec3 const> const voxels) {
+        sphere_voxels.insert(std::end(sphere_voxels), std::begin(voxels), std::end(voxels));
+    });
+    vp::voxelize_triangles_interior(sphere_triangles, grid_size, [&](std::span<VoxelBrickRun const> const brick_runs) {
+        append_brick_run_voxels(brick_runs, sphere_voxels);
+    });
+    auto box_voxels = std::vector<glm::uvec3>();
+    for (auto z = 3u; z < 45u; ++z) {
+        for (auto y = 0u; y < 61u; ++y) {
+            for (auto x = 1u; x < side_voxel_count; ++x) {
+                box_voxels.emplace_back(x, y, z);
+            }
+        }
+    }
+    auto const shapes = std::array{ std::pair{ "filled icosphere3", sphere_voxels }, std::pair{ "filled box", box_voxels } };
+    auto filled_voxel_count = size_t{ 0u };
+    auto kept_voxel_count = size_t{ 0u };
+    for (auto const& [name, voxels] : shapes) {
+        auto contiguous_tree64 = vp::ContiguousTree64{
+            .depth = depth,
+            .nodes = vp::MortonTree64Builder::build_contiguous_nodes(depth, voxels),
+        };
+        auto const node_count = std::size(contiguous_tree64.nodes);
+        // The cubes of side 4^level entirely filled, the level 0 being the voxels
+        auto full_cubes = std::vector<std::vector<bool>>{ dense_voxels(contiguous_tree64) };
+        for (auto level = 1u; level <= depth; ++level) {
+            auto const side = side_voxel_count >> (level * 2u);
+            auto const& lower_full_cubes = full_cubes.back();
+            auto level_full_cubes = std::vector<bool>(static_cast<size_t>(side) * side * side, true);
+            for (auto z = 0u; z < side * 4u; ++z) {
+                for (auto y = 0u; y < side * 4u; ++y) {
+                    for (auto x = 0u; x < side * 4u; ++x) {
+                        if (!lower_full_cubes[(static_cast<size_t>(z) * side * 4u + y) * side * 4u + x]) {
+                            level_full_cubes[(static_cast<size_t>(z / 4u) * side + y / 4u) * side + x / 4u] = false;
+                        }
+                    }
+                }
+            }
+            full_cubes.emplace_back(std::move(level_full_cubes));
+        }
+        auto const is_full = [&](uint32_t const level, glm::ivec3 const& cube) {
+            auto const side = static_cast<int>(side_voxel_count >> (level * 2u));
+            if (glm::any(glm::lessThan(cube, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(cube, glm::ivec3(side)))) {
+                return false;
+            }
+            return static_cast<bool>(full_cubes[level][(static_cast<size_t>(cube.z) * side + cube.y) * side + cube.x]);
+        };
+        if (!vp::hollow_hidden_voxels(contiguous_tree64)) {
+            std::cerr << "validate_hollowed_trees failed, cannot hollow the " << name << std::endl;
+            return false;
+        }
+        auto const hollowed_voxels = dense_voxels(contiguous_tree64);
+        filled_voxel_count += static_cast<size_t>(std::ranges::count(full_cubes[0], true));
+        for (auto z = 0u; z < side_voxel_count; ++z) {
+            for (auto y = 0u; y < side_voxel_count; ++y) {
+                for (auto x = 0u; x < side_voxel_count; ++x) {
+                    auto const voxel = glm::uvec3(x, y, z);
+                    auto is_kept = is_full(0u, glm::ivec3(voxel));
+                    if (is_kept) {
+                        auto level = 0u;
+                        while (level < depth && is_full(level + 1u, glm::ivec3(voxel >> ((level + 1u) * 2u)))) {
+                            level += 1u;
+                        }
+                        auto const cube = glm::ivec3(voxel >> (level * 2u));
+                        auto const is_hidden = is_full(level, cube + glm::ivec3(1, 0, 0)) && is_full(level, cube - glm::ivec3(1, 0, 0))
+                            && is_full(level, cube + glm::ivec3(0, 1, 0)) && is_full(level, cube - glm::ivec3(0, 1, 0))
+                            && is_full(level, cube + glm::ivec3(0, 0, 1)) && is_full(level, cube - glm::ivec3(0, 0, 1));
+                        is_kept = !is_hidden;
+                    }
+                    if (hollowed_voxels[(static_cast<size_t>(z) * side_voxel_count + y) * side_voxel_count + x] != is_kept) {
+                        std::cerr << "validate_hollowed_trees failed, the " << name << (is_kept ? " loses" : " keeps")
+                            << " the voxel " << x << ", " << y << ", " << z << std::endl;
+                        return false;
+                    }
+                    kept_voxel_count += is_kept ? 1u : 0u;
+                }
+            }
+        }
+        if (std::size(contiguous_tree64.nodes) > node_count) {
+            std::cerr << "validate_hollowed_trees failed, the " << name << " goes from " << node_count << " to "
+                << std::size(contiguous_tree64.nodes) << " nodes" << std::endl;
+            return false;
+        }
+    }
+    std::cerr << "validate_hollowed_trees passed, " << kept_voxel_count << " of " << filled_voxel_count << " voxels kept"
+        << std::endl;
+    return true;
+}
+
+static bool are_bitwise_equal(std::optional<vp::Tree64Hit> const& hit, std::optional<vp::Tree64Hit> const& other_hit) {
+    if (!hit.has_value() || !other_hit.has_value()) {
+        return hit.has_value() == other_hit.has_value();
+    }
+    return std::bit_cast<uint32_t>(hit->distance) == std::bit_cast<uint32_t>(other_hit->distance)
+        && std::bit_cast<glm::uvec3>(hit->position) == std::bit_cast<glm::uvec3>(other_hit->position)
+        && hit->normal == other_hit->normal;
+}
+
+// The packets of every kernel must hit what the scalar traversal hits, bit for bit, on the terrain with and without
+// inlined leaf masks. The camera rays are coherent, the random ones diverge in each packet, and the last packet is partial.
+static bool validate_raycast_kernels(std::mt19937& engine) {
+    constexpr auto side_voxel_count = VALIDATION_SIDE_VOXEL_COUNT;
+    auto const depth = static_cast<uint8_t>(std::bit_width(side_voxel_count - 1u) / 2u);
+    auto plain_tree64 = vp::ContiguousTree64{
+        .depth = depth,
+        .nodes = vp::MortonTree64Builder::build_contiguous_nodes(depth, terrain_voxels(side_voxel_count, engine)),
+    };
+    auto inlined_tree64 = plain_tree64;
+    if (!vp::inline_leaf_masks(inlined_tree64)) {
+        std::cerr << "validate_raycast_kernels failed, cannot inline the leaf masks" << std::endl;
+        return false;
+    }
+
+    auto rays = camera_rays(SINGLE_THREAD_RAYCAST_RESOLUTION);
+    auto const scale = static_cast<float>(side_voxel_count) / static_cast<float>(TERRAIN_SIDE_VOXEL_COUNT);
+    for (auto& ray : rays) {
+        ray.origin *= scale;
+    }
+    auto const random_coordinate = [&](uint32_t const range) {
+        return static_cast<float>(engine() % (range * 256u)) / 256.f;
+    };
+    for (auto i = 0u; i < VALIDATED_RANDOM_RAY_COUNT; ++i) {
+        auto ray = vp::Tree64Ray();
+        for (auto axis = 0; axis < 3; ++axis) {
+            ray.origin[axis] = random_coordinate(side_voxel_count);
+        }
+        do {
+            for (auto axis = 0; axis < 3; ++axis) {
+                ray.direction[axis] = random_coordinate(2u) - 1.f;
+            }
+        } while (glm::dot(ray.direction, ray.direction) < 0.01f);
+        ray.direction = glm::normalize(ray.direction);
+        rays.emplace_back(ray);
+    }
+
+    auto const max_distance = std::numeric_limits<float>::max();
+    auto scalar_hits = std::vector<std::optional<vp::Tree64Hit>>(std::size(rays));
+    auto hits = std::vector<std::optional<vp::Tree64Hit>>(std::size(rays));
+    for (auto const* const tree64 : { &plain_tree64, &inlined_tree64 }) {
+        auto const tree_name = tree64 == &plain_tree64 ? "the terrain" : "the terrain with inlined leaf masks";
+        vp::raycast_on_calling_thread(*tree64, rays, max_distance, scalar_hits, vp::Tree64RaycastKernel::Scalar, false);
+        for (auto kernel = vp::Tree64RaycastKernel::Scalar; kernel <= vp::fastest_raycast_kernel();
+            kernel = static_cast<vp::Tree64RaycastKernel>(static_cast<uint8_t>(kernel) + 1u)) {
+            for (auto const specializes_depth : { false, true }) {
+                std::ranges::fill(hits, std::nullopt);
+                vp::raycast_on_calling_thread(*tree64, rays, max_distance, hits, kernel, specializes_depth);
+                auto const mismatch = std::ranges::mismatch(hits, scalar_hits, are_bitwise_equal);
+                if (mismatch.in1 != std::end(hits)) {
+                    std::cerr << "validate_raycast_kernels failed, the " << kernel_name(kernel)
+                        << (specializes_depth ? " kernel specialized on the depth" : " kernel") << " differs on "
+                        << tree_name << " for the ray " << std::distance(std::begin(hits), mismatch.in1) << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    std::cerr << "validate_raycast_kernels passed, " << std::size(rays) << " rays" << std::endl;
+    return true;
+}
+
+static bool run_validations() {
+    auto engine = std::mt19937(SEED);
+    auto passes = true;
+    passes = validate_triangle_voxelizer_kernels(engine) && passes;
+    passes = validate_watertight_surfaces() && passes;
+    passes = validate_filled_interiors() && passes;
+    passes = validate_stamped_interiors() && passes;
+    passes = validate_brick_run_builders() && passes;
+    passes = validate_hollowed_trees() && passes;
+    passes = validate_raycast_kernels(engine) && passes;
+    return passes;
+}
+
+// Runs the benchmarks on seeded synthetic scenes and writes the times of each repetition as JSON, or with --validate
+// compares the outputs of the SIMD kernels to the scalar ones and fails on any difference
+int main(int argc, char* argv[]) {
+    auto const args = std::span(argv, static_cast<size_t>(argc)).subspan(1u);
+    auto repetition_count = 5u;
+    auto warmup_count = 1u;
+    auto filter = std::string();
+    auto output_path = std::optional<std::filesystem::path>();
+    auto validates = false;
+    try {
+        for (auto i = size_t{ 0u }; i < std::size(args); ++i) {
+            auto const option = std::string_view(args[i]);
+            auto const values = args.subspan(i + 1u);
+            if (option == "--repetitions" && std::size(values) >= 1u) {
+                repetition_count = std::max(static_cast<uint32_t>(std::stoul(values[0])), 1u);
+                i += 1u;
+            } else if (option == "--warmup" && std::size(values) >= 1u) {
+                warmup_count = static_cast<uint32_t>(std::stoul(values[0]));
+                i += 1u;
+            } else if (option == "--filter" && std::size(values) >= 1u) {
+                filter = values[0];
+                i += 1u;
+            } else if (option == "--output" && std::size(values) >= 1u) {
+                output_path = path_from(values[0]);
+                i += 1u;
+            } else if (option == "--validate") {
+                validates = true;
+            } else {
+                throw std::invalid_argument("option");
+            }
+        }
+    } catch (std::logic_error const&) {
+        std::cerr << USAGE << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (validates) {
+        return run_validations() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    auto const directory = std::filesystem::temp_directory_path() / "VulkanPlaygroundBench";
+    auto runner = BenchmarkRunner(repetition_count, warmup_count, std::move(filter));
+    try {
+        std::filesystem::create_directories(directory);
+        run_benchmarks(runner, directory);
+    } catch (std::exception const& e) {
+        std::cerr << "Fatal error : " << e.what() << std::endl;
+        std::filesystem::remove_all(directory);
+        return EXIT_FAILURE;
+    }
+    std::filesystem::remove_all(directory);
+
+    if (!output_path.has_value()) {
+        write_json(std::cout, runner);
+        return EXIT_SUCCESS;
+    }
+    auto ofstream = std::ofstream(output_path.value(), std::ios::trunc);
+    write_json(ofstream, runner);
+    if (!ofstream) {
+        std::cerr << "Cannot save " << string_from(output_path.value()) << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
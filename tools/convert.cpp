@@ -0,0 +1,34 @@
+#include "t64_commands.hpp"
+
+#include <iostream>
+#include <span>
+#include <string_view>
+#include <cstdlib>
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+static constexpr auto USAGE = "Usage : VulkanPlaygroundConvert --convert <model> <output.t64> [max side voxel count] [memory budget MiB] [--instance-meshes]"
+    " [--fill-interiors]\n"
+    "        VulkanPlaygroundConvert --reorder <input.t64> <output.t64> <depth-first|breadth-first|van-emde-boas>";
+
+// The conversion modes of the application, for the machines without any window or Vulkan
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
+    SetConsoleOutputCP(CP_UTF8);
+#endif
+    try {
+        auto const args = std::span(argv, static_cast<size_t>(argc));
+        if (std::size(args) > 1u && std::string_view(args[1]) == "--convert") {
+            return vp::convert_model_command("VulkanPlaygroundConvert", args.subspan(2u));
+        }
+        if (std::size(args) > 1u && std::string_view(args[1]) == "--reorder") {
+            return vp::reorder_t64_command("VulkanPlaygroundConvert", args.subspan(2u));
+        }
+    } catch (std::exception const& e) {
+        std::cerr << "Fatal error : " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cerr << USAGE << std::endl;
+    return EXIT_FAILURE;
+}
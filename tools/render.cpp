@@ -0,0 +1,135 @@
+#include "filesystem.hpp"
+#include "hosek_wilkie_sky.hpp"
+#include "math.hpp"
+#include "t64.hpp"
+#include "tree64_addressing.hpp"
+#include "tree64_leaf_masks.hpp"
+#include "tree64_render.hpp"
+
+#include <glm/gtx/euler_angles.hpp>
+
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <array>
+#include <algorithm>
+#include <iterator>
+
+static constexpr auto USAGE = "Usage : VulkanPlaygroundRender <input.t64> <output.ppm> [--size <width> <height>]\n"
+    "    [--camera <x> <y> <z> <pitch degrees> <yaw degrees>] [--sun <elevation degrees> <rotation degrees>]\n"
+    "    [--frames <count>] [--kernel <scalar|sse4.1|avx2>] [--inline-leaf-masks]";
+
+// Renders a .t64 on the CPU like the raytracing shader, without any Vulkan device
+int main(int argc, char* argv[]) {
+    auto const args = std::span(argv, static_cast<size_t>(argc)).subspan(1u);
+    if (std::size(args) < 2u) {
+        std::cerr << USAGE << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto const t64_path = path_from(args[0]);
+    auto const image_path = path_from(args[1]);
+    // Same defaults as the application
+    auto resolution = glm::uvec2(1280u, 720u);
+    auto camera_position = glm::vec3(2000.f, 450.f, 4300.f);
+    auto camera_euler_angles = glm::vec2(0.f, 90.f);
+    auto sun_elevation = 70.f;
+    auto sun_rotation = 0.f;
+    auto frame_count = 1u;
+    auto kernel = vp::fastest_raycast_kernel();
+    auto inlines_leaf_masks = false;
+    try {
+        for (auto i = size_t{ 2u }; i < std::size(args); ++i) {
+            auto const option = std::string_view(args[i]);
+            auto const values = args.subspan(i + 1u);
+            if (option == "--size" && std::size(values) >= 2u) {
+                resolution = glm::uvec2(static_cast<uint32_t>(std::stoul(values[0])), static_cast<uint32_t>(std::stoul(values[1])));
+                i += 2u;
+            } else if (option == "--camera" && std::size(values) >= 5u) {
+                camera_position = glm::vec3(std::stof(values[0]), std::stof(values[1]), std::stof(values[2]));
+                camera_euler_angles = glm::vec2(std::stof(values[3]), std::stof(values[4]));
+                i += 5u;
+            } else if (option == "--sun" && std::size(values) >= 2u) {
+                sun_elevation = std::stof(values[0]);
+                sun_rotation = std::stof(values[1]);
+                i += 2u;
+            } else if (option == "--frames" && std::size(values) >= 1u) {
+                frame_count = std::max(static_cast<uint32_t>(std::stoul(values[0])), 1u);
+                i += 1u;
+            } else if (option == "--kernel" && std::size(values) >= 1u) {
+                auto const kernel_names = std::array{ "scalar", "sse4.1", "avx2" };
+                auto const kernel_name = std::ranges::find(kernel_names, std::string_view(values[0]));
+                if (kernel_name == std::end(kernel_names)) {
+                    throw std::invalid_argument("kernel");
+                }
+                kernel = static_cast<vp::Tree64RaycastKernel>(std::distance(std::begin(kernel_names), kernel_name));
+                i += 1u;
+            } else if (option == "--inline-leaf-masks") {
+                inlines_leaf_masks = true;
+            } else {
+                throw std::invalid_argument("option");
+            }
+        }
+    } catch (std::logic_error const&) {
+        std::cerr << USAGE << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (glm::any(glm::equal(resolution, glm::uvec2(0u)))) {
+        std::cerr << USAGE << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto contiguous_tree64 = vp::import_t64(t64_path);
+    if (!contiguous_tree64.has_value()) {
+        std::cerr << "Cannot import " << string_from(t64_path) << std::endl;
+        return EXIT_FAILURE;
+    }
+    // The VRAM the application would upload, the traversal cost being the one of the frame times below
+    if (inlines_leaf_masks && std::empty(contiguous_tree64->leaf_masks)) {
+        auto const node_count = std::size(contiguous_tree64->nodes);
+        if (!vp::use_absolute_addressing(contiguous_tree64.value()) || !vp::inline_leaf_masks(contiguous_tree64.value())) {
+            std::cerr << "Cannot inline the leaf masks of more than 2^31 nodes" << std::endl;
+            return EXIT_FAILURE;
+        }
+        auto const nodes_size = std::size(contiguous_tree64->nodes) * sizeof(vp::Tree64Node);
+        auto const dictionary = vp::build_leaf_mask_dictionary(contiguous_tree64->leaf_masks);
+        auto const dictionary_size = std::size(dictionary.unique_leaf_masks) * sizeof(uint64_t)
+            + std::size(dictionary.packed_indices) * sizeof(uint32_t);
+        std::cout << "plain nodes " << node_count * sizeof(vp::Tree64Node) / (1u << 10u) << " KiB of VRAM" << std::endl;
+        std::cout << "inlined leaf masks " << (nodes_size + std::size(contiguous_tree64->leaf_masks) * sizeof(uint64_t)) / (1u << 10u)
+            << " KiB of VRAM, " << (nodes_size + dictionary_size) / (1u << 10u) << " KiB with the dictionary of "
+            << std::size(dictionary.unique_leaf_masks) << " unique masks and " << dictionary.index_bit_count << " bits indices"
+            << std::endl;
+    }
+    // Same rotation as Camera
+    auto const pitch = glm::clamp(normalized_angle(glm::radians(camera_euler_angles.x)), -glm::half_pi<float>(), glm::half_pi<float>());
+    auto const yaw = normalized_angle(glm::radians(camera_euler_angles.y));
+    auto const settings = vp::Tree64RenderSettings{
+        .resolution = resolution,
+        .camera_position = camera_position,
+        .camera_rotation = glm::mat3(glm::eulerAngleYX(yaw, pitch)),
+        .to_sun_direction = cartesian_direction_from_spherical(glm::radians(sun_elevation), glm::radians(sun_rotation)),
+        .sky = vp::hosek_wilkie_sky_rendering_parameters(4.f, 0.3f, glm::radians(sun_elevation)),
+        .kernel = kernel,
+    };
+
+    auto image = vp::Tree64Image();
+    auto frame_times = std::vector<std::chrono::duration<float>>();
+    for (auto i = 0u; i < frame_count; ++i) {
+        auto const begin_time = std::chrono::high_resolution_clock::now();
+        image = vp::render(contiguous_tree64.value(), settings);
+        frame_times.emplace_back(std::chrono::high_resolution_clock::now() - begin_time);
+    }
+    std::ranges::sort(frame_times);
+    auto const median_frame_time = frame_times[std::size(frame_times) / 2u];
+    std::cout << "median frame time " << std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(median_frame_time)
+        << " over " << frame_count << " frames" << std::endl;
+    std::cout << static_cast<float>(image.ray_count) / median_frame_time.count() / 1.e6f << " Mrays/s ("
+        << image.ray_count << " rays per frame)" << std::endl;
+    if (!vp::save_ppm(image_path, image)) {
+        std::cerr << "Cannot save " << string_from(image_path) << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}